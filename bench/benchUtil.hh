@@ -0,0 +1,117 @@
+// Scaffolding shared by the comparison benchmarks: the median-of-repetitions
+// timer, argument and image-list handling, mask comparison and the image
+// column of the report tables.
+#ifndef BENCH_UTIL_HH
+#define BENCH_UTIL_HH
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Median wall time in milliseconds of body() over several repetitions, after
+// one warmup run so one-time allocations don't skew the first sample.
+// setup() runs before every call, untimed.
+inline double medianMs(int repetitions, const std::function<void()>& body,
+                       const std::function<void()>& setup = nullptr) {
+    if (setup) {
+        setup();
+    }
+    body();
+    
+    std::vector<double> samples;
+    samples.reserve(repetitions);
+    for (int i = 0; i < repetitions; i++) {
+        if (setup) {
+            setup();
+        }
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Parse a comma-separated list of integers
+inline std::vector<int> parseIntList(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(std::stoi(item));
+        }
+    }
+    return values;
+}
+
+// Take -glob <pattern> or -reps <n> at argv[i]; false for any other argument
+inline bool parseCommonArg(int argc, char* argv[], int& i, std::string& pattern, int& repetitions) {
+    std::string arg = argv[i];
+    if (arg == "-glob" && i + 1 < argc) {
+        pattern = argv[++i];
+    } else if (arg == "-reps" && i + 1 < argc) {
+        repetitions = std::max(1, std::stoi(argv[++i]));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Paths matching pattern; reports an empty match
+inline bool globImages(const std::string& pattern, std::vector<std::string>& paths) {
+    cv::glob(pattern, paths, false);
+    if (paths.empty()) {
+        std::cerr << "No images match " << pattern << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// File name of a path, for the report
+inline std::string imageName(const std::string& path) {
+    return path.substr(path.find_last_of("/\\") + 1);
+}
+
+// Decode every path as BGR and hand it to visit with its file name, skipping
+// unreadable files
+inline void forEachImage(const std::vector<std::string>& paths,
+                         const std::function<void(const std::string&, const cv::Mat&)>& visit) {
+    for (const auto& path : paths) {
+        cv::Mat image = cv::imread(path, cv::IMREAD_COLOR);
+        if (image.empty()) {
+            std::cerr << "Skipping unreadable image " << path << std::endl;
+            continue;
+        }
+        visit(imageName(path), image);
+    }
+}
+
+// First column of a report row, left-aligned; later columns are right-aligned
+inline std::ostream& imageColumn(const std::string& name) {
+    return std::cout << std::left << std::setw(28) << name << std::right;
+}
+
+// Fraction of pixels where two masks differ
+inline double differingFraction(const cv::Mat& a, const cv::Mat& b) {
+    cv::Mat differing = a != b;
+    return static_cast<double>(cv::countNonZero(differing)) / a.total();
+}
+
+// Intersection over union of the foreground of two masks; 1 when both are empty
+inline double foregroundIoU(const cv::Mat& a, const cv::Mat& b) {
+    cv::Mat intersection = a & b;
+    cv::Mat unionMask = a | b;
+    int unionCount = cv::countNonZero(unionMask);
+    return unionCount > 0 ? static_cast<double>(cv::countNonZero(intersection)) / unionCount : 1.0;
+}
+
+#endif // BENCH_UTIL_HH
@@ -0,0 +1,384 @@
+// Times every stage of the pipeline on its own: decode, preprocessing,
+// adaptive threshold, morphology, component labeling, contour tracing, shape
+// filtering, classification, annotation and PNG encode, followed by the whole
+// mask estimation at full resolution and in coarse-to-fine pyramid mode. Runs
+// on the images matching -glob and on synthetic large frames, and prints one
+// CSV or JSON record per image and stage so runs can be diffed between releases.
+#include "binaryMaskEstimator.hh"
+#include "objectCounter.hh"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct BenchImage {
+    std::string name;
+    std::vector<uchar> encoded;  // Compressed bytes, so decode is timed without disk I/O
+    cv::Mat image;
+};
+
+struct StageResult {
+    std::string image;
+    int width;
+    int height;
+    std::string stage;
+    int repetitions;
+    double medianMs;
+    double p99Ms;
+    double minMs;
+    double meanMs;
+};
+
+// Discards everything written to it; used to keep pipeline progress messages
+// out of the timed region
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// Time body() after warmup runs. setup() runs before every call, untimed.
+static StageResult timeStage(const std::string& stage, int warmup, int repetitions,
+                             const std::function<void()>& setup,
+                             const std::function<void()>& body) {
+    for (int i = 0; i < warmup; i++) {
+        setup();
+        body();
+    }
+    
+    std::vector<double> samples;
+    samples.reserve(repetitions);
+    for (int i = 0; i < repetitions; i++) {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    
+    std::sort(samples.begin(), samples.end());
+    size_t p99Index = static_cast<size_t>(std::ceil(0.99 * samples.size())) - 1;
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    
+    StageResult result;
+    result.stage = stage;
+    result.repetitions = repetitions;
+    result.medianMs = samples[samples.size() / 2];
+    result.p99Ms = samples[std::min(p99Index, samples.size() - 1)];
+    result.minMs = samples.front();
+    result.meanMs = sum / samples.size();
+    return result;
+}
+
+// Textured background with scattered coin-sized discs, JPEG encoded like a photo
+static BenchImage makeSyntheticImage(int width, int height, uint64 seed) {
+    cv::RNG rng(seed);
+    cv::Mat image(height, width, CV_8UC3, cv::Scalar(90, 110, 120));
+    
+    cv::Mat noise(height, width, CV_8UC3);
+    rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(8));
+    cv::add(image, noise, image);
+    
+    // Roughly one coin per 250x250 pixel cell
+    int coinCount = std::max(1, (width / 250) * (height / 250));
+    int minRadius = std::max(8, std::min(width, height) / 60);
+    for (int i = 0; i < coinCount; i++) {
+        cv::Point center(rng.uniform(0, width), rng.uniform(0, height));
+        int radius = rng.uniform(minRadius, minRadius * 2);
+        cv::Scalar color(rng.uniform(120, 230), rng.uniform(120, 230), rng.uniform(120, 230));
+        cv::circle(image, center, radius, color, -1, cv::LINE_AA);
+        cv::circle(image, center, radius, cv::Scalar(40, 40, 40), 2, cv::LINE_AA);
+    }
+    
+    BenchImage bench;
+    bench.name = "synthetic_" + std::to_string(width) + "x" + std::to_string(height);
+    cv::imencode(".jpg", image, bench.encoded);
+    bench.image = image;
+    return bench;
+}
+
+// Read a file's compressed bytes and decode them once for the later stages
+static bool loadBenchImage(const std::string& path, BenchImage& bench) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    bench.encoded.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    bench.image = cv::imdecode(bench.encoded, cv::IMREAD_COLOR);
+    bench.name = path.substr(path.find_last_of("/\\") + 1);
+    return !bench.image.empty();
+}
+
+// Parse "WxH"
+static bool parseSize(const std::string& text, cv::Size& size) {
+    size_t x = text.find('x');
+    if (x == std::string::npos) {
+        return false;
+    }
+    try {
+        size.width = std::stoi(text.substr(0, x));
+        size.height = std::stoi(text.substr(x + 1));
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return size.width > 0 && size.height > 0;
+}
+
+static void printCsv(const std::vector<StageResult>& results) {
+    std::cout << "image,width,height,stage,reps,median_ms,p99_ms,min_ms,mean_ms" << std::endl;
+    for (const auto& r : results) {
+        std::cout << r.image << "," << r.width << "," << r.height << "," << r.stage << ","
+                  << r.repetitions << std::fixed << std::setprecision(4)
+                  << "," << r.medianMs << "," << r.p99Ms << "," << r.minMs << "," << r.meanMs
+                  << std::endl;
+    }
+}
+
+static void printJson(const std::vector<StageResult>& results) {
+    std::cout << "[" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const StageResult& r = results[i];
+        std::cout << "  {\"image\": \"" << r.image << "\", \"width\": " << r.width
+                  << ", \"height\": " << r.height << ", \"stage\": \"" << r.stage
+                  << "\", \"reps\": " << r.repetitions << std::fixed << std::setprecision(4)
+                  << ", \"median_ms\": " << r.medianMs << ", \"p99_ms\": " << r.p99Ms
+                  << ", \"min_ms\": " << r.minMs << ", \"mean_ms\": " << r.meanMs << "}"
+                  << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    std::cout << "]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string pattern = "resources/*.jpg";
+    std::vector<cv::Size> syntheticSizes;
+    bool defaultSynthetic = true;
+    int warmup = 2;
+    int repetitions = 20;
+    std::string format = "csv";
+    int blockSize = 11;
+    double C = 2.0;
+    int kernelSize = 2;
+    int iterations = 1;
+    bool fastPreprocessing = false;
+    double pixelsPerMM = 12.0;
+    int pyramidLevels = 2;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        cv::Size size;
+        if (arg == "-glob" && i + 1 < argc) {
+            pattern = argv[++i];
+        } else if (arg == "-synthetic" && i + 1 < argc && parseSize(argv[i + 1], size)) {
+            syntheticSizes.push_back(size);
+            i++;
+        } else if (arg == "-nosynthetic") {
+            defaultSynthetic = false;
+        } else if (arg == "-warmup" && i + 1 < argc) {
+            warmup = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "-reps" && i + 1 < argc) {
+            repetitions = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-format" && i + 1 < argc) {
+            format = argv[++i];
+        } else if (arg == "-b" && i + 1 < argc) {
+            blockSize = std::stoi(argv[++i]);
+        } else if (arg == "-c" && i + 1 < argc) {
+            C = std::stod(argv[++i]);
+        } else if (arg == "-k" && i + 1 < argc) {
+            kernelSize = std::stoi(argv[++i]);
+        } else if (arg == "-iter" && i + 1 < argc) {
+            iterations = std::stoi(argv[++i]);
+        } else if (arg == "-fastpre") {
+            fastPreprocessing = true;
+        } else if (arg == "-ppmm" && i + 1 < argc) {
+            pixelsPerMM = std::stod(argv[++i]);
+        } else if (arg == "-pyramid" && i + 1 < argc) {
+            pyramidLevels = std::max(1, std::stoi(argv[++i]));
+        } else {
+            std::cout << "Usage: " << argv[0] << " [-glob <pattern>] [-synthetic <W>x<H>]... [-nosynthetic]"
+                      << " [-warmup <n>] [-reps <n>] [-format csv|json]"
+                      << " [-b <block>] [-c <C>] [-k <kernel>] [-iter <n>] [-fastpre] [-ppmm <value>]"
+                      << " [-pyramid <levels>]"
+                      << std::endl;
+            return arg == "-help" ? 0 : 1;
+        }
+    }
+    
+    if (format != "csv" && format != "json") {
+        std::cerr << "Unknown format '" << format << "', expected csv or json" << std::endl;
+        return 1;
+    }
+    if (syntheticSizes.empty() && defaultSynthetic) {
+        syntheticSizes.push_back(cv::Size(4096, 3072));
+        syntheticSizes.push_back(cv::Size(8192, 6144));
+    }
+    
+    std::vector<BenchImage> images;
+    std::vector<std::string> paths;
+    if (!pattern.empty()) {
+        cv::glob(pattern, paths, false);
+    }
+    for (const auto& path : paths) {
+        BenchImage bench;
+        if (loadBenchImage(path, bench)) {
+            images.push_back(bench);
+        } else {
+            std::cerr << "Skipping unreadable image " << path << std::endl;
+        }
+    }
+    for (size_t i = 0; i < syntheticSizes.size(); i++) {
+        images.push_back(makeSyntheticImage(syntheticSizes[i].width, syntheticSizes[i].height, 0x5eed + i));
+    }
+    if (images.empty()) {
+        std::cerr << "No images to benchmark" << std::endl;
+        return 1;
+    }
+    
+    BinaryMaskEstimator estimator;
+    estimator.setAdaptiveThresholdParams(blockSize, C);
+    estimator.setMorphologicalParams(kernelSize, iterations);
+    estimator.setFastPreprocessing(fastPreprocessing);
+    
+    BinaryMaskEstimator pyramidEstimator;
+    pyramidEstimator.setAdaptiveThresholdParams(blockSize, C);
+    pyramidEstimator.setMorphologicalParams(kernelSize, iterations);
+    pyramidEstimator.setFastPreprocessing(fastPreprocessing);
+    pyramidEstimator.setPyramidLevels(pyramidLevels);
+    
+    BinaryMaskEstimator rleEstimator;
+    rleEstimator.setAdaptiveThresholdParams(blockSize, C);
+    rleEstimator.setMorphologicalParams(kernelSize, iterations);
+    rleEstimator.setFastPreprocessing(fastPreprocessing);
+    rleEstimator.setRunLengthOutput(true);
+    
+    ObjectCounter counter("coins.cfg");
+    counter.setCoinClassification(true);
+    counter.setPixelsPerMM(pixelsPerMM);
+    
+    // Pipeline chatter would otherwise be timed along with the work
+    NullBuffer nullBuffer;
+    std::streambuf* consoleBuffer = std::cout.rdbuf(&nullBuffer);
+    
+    std::vector<StageResult> results;
+    auto noSetup = []() {};
+    
+    for (const auto& bench : images) {
+        std::cerr << "Benchmarking " << bench.name << " (" << bench.image.cols << "x"
+                  << bench.image.rows << ")" << std::endl;
+        
+        cv::Mat decoded, gray, thresholded, morphed, mask, annotated;
+        std::vector<uchar> png;
+        std::vector<StageResult> imageResults;
+        
+        imageResults.push_back(timeStage("decode", warmup, repetitions, noSetup, [&]() {
+            decoded = cv::imdecode(bench.encoded, cv::IMREAD_COLOR);
+        }));
+        
+        imageResults.push_back(timeStage("preprocess", warmup, repetitions, noSetup, [&]() {
+            estimator.computeLuminance(bench.image, gray);
+        }));
+        
+        imageResults.push_back(timeStage("threshold", warmup, repetitions, noSetup, [&]() {
+            estimator.applyAdaptiveThreshold(gray, thresholded);
+        }));
+        
+        // The in-place stages get a fresh copy of their input before every run
+        imageResults.push_back(timeStage("morphology", warmup, repetitions,
+            [&]() { thresholded.copyTo(morphed); },
+            [&]() { estimator.applyMorphologicalOperations(morphed); }));
+        
+        imageResults.push_back(timeStage("components", warmup, repetitions,
+            [&]() { morphed.copyTo(mask); },
+            [&]() { estimator.removeSmallComponents(mask, 100); }));
+        
+        counter.adoptImage(bench.image);
+        counter.adoptBinaryMask(mask);
+        counter.adoptComponents(estimator.getComponentLabelsRef(), estimator.getComponentStatsRef(),
+                                estimator.getComponentCentroidsRef());
+        
+        imageResults.push_back(timeStage("candidates", warmup, repetitions, noSetup, [&]() {
+            counter.findContours();
+        }));
+        
+        // Shape filtering compacts the detections, so it always starts from the
+        // candidates; it includes tracing the survivors of the cheap filters
+        imageResults.push_back(timeStage("shape_filter", warmup, repetitions, noSetup, [&]() {
+            counter.analyzeObjects();
+        }));
+        
+        // Diameters are cached on the detections, so every run starts from a fresh
+        // filter pass and pays for the contour tracing and enclosing circles again
+        imageResults.push_back(timeStage("classify", warmup, repetitions,
+            [&]() { counter.analyzeObjects(); },
+            [&]() { counter.classifyCoins(); }));
+        
+        imageResults.push_back(timeStage("annotate", warmup, repetitions, noSetup, [&]() {
+            annotated = counter.getAnnotatedImage();
+        }));
+        
+        imageResults.push_back(timeStage("encode_png", warmup, repetitions, noSetup, [&]() {
+            cv::imencode(".png", annotated, png);
+        }));
+        
+        // End to end mask estimation, full resolution against coarse-to-fine
+        // and against run-length output
+        estimator.adoptImage(bench.image);
+        pyramidEstimator.adoptImage(bench.image);
+        rleEstimator.adoptImage(bench.image);
+        
+        imageResults.push_back(timeStage("estimate_full", warmup, repetitions, noSetup, [&]() {
+            estimator.estimateBinaryMaskShared();
+        }));
+        
+        imageResults.push_back(timeStage("estimate_pyramid", warmup, repetitions, noSetup, [&]() {
+            pyramidEstimator.estimateBinaryMaskShared();
+        }));
+        
+        imageResults.push_back(timeStage("estimate_rle", warmup, repetitions, noSetup, [&]() {
+            rleEstimator.estimateBinaryMaskShared();
+        }));
+        
+        counter.loadFromEstimator(estimator);
+        int fullCount = counter.countObjects();
+        counter.loadFromEstimator(pyramidEstimator);
+        int pyramidCount = counter.countObjects();
+        if (fullCount != pyramidCount) {
+            std::cerr << "  Pyramid mode found " << pyramidCount << " objects, full resolution "
+                      << fullCount << std::endl;
+        }
+        
+        // Counting on runs: labels come with the runs, contours are traced per bounding box
+        imageResults.push_back(timeStage("count_rle", warmup, repetitions,
+            [&]() { counter.loadFromEstimator(rleEstimator); },
+            [&]() { counter.countObjects(); }));
+        if (counter.getObjectCount() != fullCount) {
+            std::cerr << "  Run-length mode found " << counter.getObjectCount() << " objects, full resolution "
+                      << fullCount << std::endl;
+        }
+        
+        for (auto& result : imageResults) {
+            result.image = bench.name;
+            result.width = bench.image.cols;
+            result.height = bench.image.rows;
+            results.push_back(result);
+        }
+    }
+    
+    std::cout.rdbuf(consoleBuffer);
+    
+    if (format == "json") {
+        printJson(results);
+    } else {
+        printCsv(results);
+    }
+    
+    return 0;
+}
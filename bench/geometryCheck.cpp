@@ -0,0 +1,239 @@
+// Compares the fast (moment-based) geometry mode of the ObjectCounter with the
+// exact (contour-based) one on the same masks. Per image it reports the time
+// spent filtering and classifying in each mode, the objects only one mode
+// keeps, the objects the two modes classify differently, and the error of the
+// fast diameter and circularity against the exact values. Exits with 2 when
+// the overall disagreement exceeds -tol, so a deployment can check its own
+// image set before switching to -geometry fast.
+#include "binaryMaskEstimator.hh"
+#include "objectCounter.hh"
+#include "logger.hh"
+#include "benchUtil.hh"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Median wall time in milliseconds of the shape filter and classification
+static double timeMeasurement(ObjectCounter& counter, int repetitions) {
+    return medianMs(repetitions, [&] {
+        counter.analyzeObjects();
+        counter.classifyCoins();
+    });
+}
+
+// Differences between the exact and fast detections of one image
+struct Comparison {
+    int exactObjects = 0;
+    int fastObjects = 0;
+    int onlyOneMode = 0;         // Kept by the shape filter in one mode only
+    int classDisagreements = 0;  // Kept by both but classified differently
+    int matched = 0;
+    double sumDiameterError = 0.0;  // Pixels
+    double maxDiameterError = 0.0;
+    double sumRelativeError = 0.0;
+    double sumCircularityError = 0.0;
+    int circularityMatched = 0;  // Matched objects whose circularity both modes measured
+};
+
+// Match the two tables by component label (both come from the same mask)
+static Comparison compare(const ObjectTable& exact, const ObjectTable& fast) {
+    Comparison result;
+    result.exactObjects = static_cast<int>(exact.size());
+    result.fastObjects = static_cast<int>(fast.size());
+    
+    // Circularity is lazy; an unmeasured column holds zeros, which would
+    // read as perfect agreement
+    const unsigned int circularityBit = ObjectTable::FEATURE_CIRCULARITY;
+    const bool circularity = (exact.computedFeatures & circularityBit) && (fast.computedFeatures & circularityBit);
+    
+    std::map<int, size_t> fastIndex;
+    for (size_t i = 0; i < fast.size(); i++) {
+        fastIndex[fast.label[i]] = i;
+    }
+    
+    for (size_t i = 0; i < exact.size(); i++) {
+        auto found = fastIndex.find(exact.label[i]);
+        if (found == fastIndex.end()) {
+            result.onlyOneMode++;
+            continue;
+        }
+        size_t j = found->second;
+        result.matched++;
+        
+        if (exact.coinType[i] != fast.coinType[j]) {
+            result.classDisagreements++;
+        }
+        
+        double error = std::abs(fast.diameterPixels[j] - exact.diameterPixels[i]);
+        result.sumDiameterError += error;
+        result.maxDiameterError = std::max(result.maxDiameterError, error);
+        if (exact.diameterPixels[i] > 0.0) {
+            result.sumRelativeError += error / exact.diameterPixels[i];
+        }
+        if (circularity) {
+            result.sumCircularityError += std::abs(fast.circularity[j] - exact.circularity[i]);
+            result.circularityMatched++;
+        }
+    }
+    result.onlyOneMode += result.fastObjects - result.matched;
+    
+    return result;
+}
+
+// Mean circularity error, or "n/a" when no matched object had it measured
+static std::string circularityText(const Comparison& result) {
+    if (result.circularityMatched == 0) {
+        return "n/a";
+    }
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(4) << result.sumCircularityError / result.circularityMatched;
+    return text.str();
+}
+
+int main(int argc, char* argv[]) {
+    std::string pattern = "resources/*.jpg";
+    std::string configPath = "coins.cfg";
+    double pixelsPerMM = 12.0;
+    bool shapeFilter = false;
+    double minCircularity = 0.3;
+    double maxAspectRatio = 3.0;
+    bool runLength = false;
+    int repetitions = 5;
+    double tolerance = 0.02;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (parseCommonArg(argc, argv, i, pattern, repetitions)) {
+            continue;
+        } else if (arg == "-config" && i + 1 < argc) {
+            configPath = argv[++i];
+        } else if (arg == "-ppmm" && i + 1 < argc) {
+            pixelsPerMM = std::stod(argv[++i]);
+        } else if (arg == "-shape") {
+            shapeFilter = true;
+        } else if (arg == "-mincirc" && i + 1 < argc) {
+            minCircularity = std::stod(argv[++i]);
+        } else if (arg == "-maxaspect" && i + 1 < argc) {
+            maxAspectRatio = std::stod(argv[++i]);
+        } else if (arg == "-rle") {
+            runLength = true;
+        } else if (arg == "-tol" && i + 1 < argc) {
+            tolerance = std::stod(argv[++i]);
+        } else {
+            std::cout << "Usage: " << argv[0] << " [-glob <pattern>] [-config <path>] [-ppmm <value>]"
+                      << " [-shape] [-mincirc <value>] [-maxaspect <value>] [-rle] [-reps <n>] [-tol <fraction>]"
+                      << std::endl;
+            return arg == "-help" ? 0 : 1;
+        }
+    }
+    
+    if (pixelsPerMM <= 0.0) {
+        std::cerr << "-ppmm must be positive to classify coins" << std::endl;
+        return 1;
+    }
+    
+    std::vector<std::string> paths;
+    if (!globImages(pattern, paths)) {
+        return 1;
+    }
+    
+    // Keep the counters' progress messages out of the report
+    Logger::setLevel(LogLevel::QUIET);
+    
+    BinaryMaskEstimator estimator;
+    estimator.setRunLengthOutput(runLength);
+    
+    ObjectCounter exact(configPath);
+    ObjectCounter fast(configPath);
+    fast.setGeometryMode(GeometryMode::FAST);
+    for (ObjectCounter* counter : {&exact, &fast}) {
+        counter->setShapeFilter(minCircularity, maxAspectRatio);
+        counter->enableShapeFiltering(shapeFilter);
+        counter->setCoinClassification(true);
+        counter->setPixelsPerMM(pixelsPerMM);
+    }
+    
+    imageColumn("image") << std::setw(7) << "exact"
+                         << std::setw(7) << "fast" << std::setw(10) << "exact_ms" << std::setw(9) << "fast_ms"
+                         << std::setw(9) << "speedup" << std::setw(8) << "filter" << std::setw(8) << "class"
+                         << std::setw(11) << "diam_mean" << std::setw(10) << "diam_max" << std::setw(10) << "diam_rel"
+                         << std::setw(10) << "circ_err" << std::endl;
+    
+    Comparison total;
+    double totalExactMs = 0.0;
+    double totalFastMs = 0.0;
+    
+    for (const auto& path : paths) {
+        if (!estimator.loadImage(path)) {
+            std::cerr << "Skipping unreadable image " << path << std::endl;
+            continue;
+        }
+        estimator.estimateBinaryMaskShared();
+        if (!estimator.hasMask() || !exact.loadFromEstimator(estimator) || !fast.loadFromEstimator(estimator)) {
+            std::cerr << "Skipping " << path << ": no mask" << std::endl;
+            continue;
+        }
+        
+        if (exact.countObjects() < 0 || fast.countObjects() < 0) {
+            std::cerr << "Skipping " << path << ": counting failed" << std::endl;
+            continue;
+        }
+        double exactMs = timeMeasurement(exact, repetitions);
+        double fastMs = timeMeasurement(fast, repetitions);
+        
+        // getObjectTable measures every lazy feature, so circularity is
+        // compared also when the shape filter didn't need it
+        Comparison result = compare(exact.getObjectTable(), fast.getObjectTable());
+        int matched = std::max(result.matched, 1);
+        
+        imageColumn(imageName(path)) << std::setw(7) << result.exactObjects << std::setw(7) << result.fastObjects << std::fixed
+                                     << std::setw(10) << std::setprecision(3) << exactMs
+                                     << std::setw(9) << std::setprecision(3) << fastMs
+                                     << std::setw(8) << std::setprecision(2) << exactMs / std::max(fastMs, 1e-9) << "x"
+                                     << std::setw(8) << result.onlyOneMode << std::setw(8) << result.classDisagreements
+                                     << std::setw(11) << std::setprecision(2) << result.sumDiameterError / matched
+                                     << std::setw(10) << std::setprecision(2) << result.maxDiameterError
+                                     << std::setw(9) << std::setprecision(2) << 100.0 * result.sumRelativeError / matched << "%"
+                                     << std::setw(10) << circularityText(result) << std::endl;
+        
+        total.exactObjects += result.exactObjects;
+        total.fastObjects += result.fastObjects;
+        total.onlyOneMode += result.onlyOneMode;
+        total.classDisagreements += result.classDisagreements;
+        total.matched += result.matched;
+        total.sumDiameterError += result.sumDiameterError;
+        total.maxDiameterError = std::max(total.maxDiameterError, result.maxDiameterError);
+        total.sumRelativeError += result.sumRelativeError;
+        total.sumCircularityError += result.sumCircularityError;
+        total.circularityMatched += result.circularityMatched;
+        totalExactMs += exactMs;
+        totalFastMs += fastMs;
+    }
+    
+    // Share of the objects either mode detected on which the modes disagree
+    int objects = total.matched + total.onlyOneMode;
+    double disagreement = objects > 0
+        ? static_cast<double>(total.onlyOneMode + total.classDisagreements) / objects : 0.0;
+    int matched = std::max(total.matched, 1);
+    
+    std::cout << std::endl << std::fixed
+              << "Objects: " << total.exactObjects << " exact, " << total.fastObjects << " fast, "
+              << total.onlyOneMode << " kept by one mode only, "
+              << total.classDisagreements << " classified differently" << std::endl
+              << "Disagreement: " << std::setprecision(2) << 100.0 * disagreement << "% (tolerance "
+              << 100.0 * tolerance << "%)" << std::endl
+              << "Diameter error: mean " << std::setprecision(2) << total.sumDiameterError / matched
+              << " px (" << 100.0 * total.sumRelativeError / matched << "%), max "
+              << total.maxDiameterError << " px" << std::endl
+              << "Circularity error: mean " << circularityText(total) << std::endl
+              << "Filter and classify time: " << std::setprecision(2) << totalExactMs << " ms exact, "
+              << totalFastMs << " ms fast (" << totalExactMs / std::max(totalFastMs, 1e-9) << "x)" << std::endl;
+    
+    return disagreement <= tolerance ? 0 : 2;
+}
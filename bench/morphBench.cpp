@@ -0,0 +1,112 @@
+// Compares the morphology elements of the mask cleanup: the iterated ellipse
+// against one square or octagon of the combined radius. Reports cleanup time
+// per kernel size and iteration count, how far the octagon mask is from the
+// ellipse one, and checks the square matches cv::dilate / cv::erode with a
+// rectangular kernel exactly. The square is centred, so its reference kernel
+// has side 2*(k/2)+1; an even -k is compared against the next odd square.
+#include "binaryMaskEstimator.hh"
+#include "benchUtil.hh"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Median time of the close/open cleanup; every run starts from source
+static double timeMorphology(BinaryMaskEstimator& estimator, const cv::Mat& source, cv::Mat& mask,
+                             int repetitions) {
+    return medianMs(repetitions, [&] { estimator.applyMorphologicalOperations(mask); },
+                    [&] { source.copyTo(mask); });
+}
+
+int main(int argc, char* argv[]) {
+    std::string pattern = "resources/*.jpg";
+    std::vector<int> kernelSizes = {3, 7, 15};
+    std::vector<int> iterationCounts = {1, 3, 6};
+    int repetitions = 5;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (parseCommonArg(argc, argv, i, pattern, repetitions)) {
+            continue;
+        } else if (arg == "-kernels" && i + 1 < argc) {
+            kernelSizes = parseIntList(argv[++i]);
+        } else if (arg == "-iters" && i + 1 < argc) {
+            iterationCounts = parseIntList(argv[++i]);
+        } else {
+            std::cout << "Usage: " << argv[0] << " [-glob <pattern>] [-kernels <k1,k2,...>]"
+                      << " [-iters <n1,n2,...>] [-reps <n>]" << std::endl;
+            return arg == "-help" ? 0 : 1;
+        }
+    }
+    
+    std::vector<std::string> paths;
+    if (!globImages(pattern, paths)) {
+        return 1;
+    }
+    if (kernelSizes.empty() || iterationCounts.empty()) {
+        std::cerr << "No kernel sizes or iteration counts given" << std::endl;
+        return 1;
+    }
+    
+    BinaryMaskEstimator ellipse;
+    BinaryMaskEstimator rect;
+    BinaryMaskEstimator octagon;
+    rect.setMorphShape(MorphShape::RECT);
+    octagon.setMorphShape(MorphShape::OCTAGON);
+    
+    imageColumn("image") << std::setw(7) << "kernel"
+                         << std::setw(6) << "iter" << std::setw(13) << "ellipse_ms" << std::setw(10) << "rect_ms"
+                         << std::setw(12) << "octagon_ms" << std::setw(10) << "speedup"
+                         << std::setw(12) << "oct_diff" << std::setw(12) << "rect_diff" << std::endl;
+    
+    int mismatches = 0;
+    
+    forEachImage(paths, [&](const std::string& name, const cv::Mat& image) {
+        cv::Mat gray, thresholded;
+        ellipse.computeLuminance(image, gray);
+        ellipse.applyAdaptiveThreshold(gray, thresholded);
+        
+        for (int kernelSize : kernelSizes) {
+            for (int iterations : iterationCounts) {
+                ellipse.setMorphologicalParams(kernelSize, iterations);
+                rect.setMorphologicalParams(kernelSize, iterations);
+                octagon.setMorphologicalParams(kernelSize, iterations);
+                
+                cv::Mat ellipseMask, rectMask, octagonMask;
+                double ellipseMs = timeMorphology(ellipse, thresholded, ellipseMask, repetitions);
+                double rectMs = timeMorphology(rect, thresholded, rectMask, repetitions);
+                double octagonMs = timeMorphology(octagon, thresholded, octagonMask, repetitions);
+                
+                // The square path must match OpenCV iterating a centred square
+                // kernel; even sizes round up like the decomposed element does
+                int side = 2 * (kernelSize / 2) + 1;
+                cv::Mat rectKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(side, side));
+                cv::Mat reference;
+                cv::dilate(thresholded, reference, rectKernel, cv::Point(-1, -1), iterations);
+                cv::erode(reference, reference, rectKernel, cv::Point(-1, -1), iterations);
+                cv::erode(reference, reference, rectKernel, cv::Point(-1, -1), iterations);
+                cv::dilate(reference, reference, rectKernel, cv::Point(-1, -1), iterations);
+                double rectDiff = differingFraction(reference, rectMask);
+                if (rectDiff > 0.0) {
+                    mismatches++;
+                }
+                
+                imageColumn(name) << std::setw(7) << kernelSize
+                                  << std::setw(6) << iterations << std::fixed
+                                  << std::setw(13) << std::setprecision(2) << ellipseMs
+                                  << std::setw(10) << std::setprecision(2) << rectMs
+                                  << std::setw(12) << std::setprecision(2) << octagonMs
+                                  << std::setw(9) << std::setprecision(2) << ellipseMs / std::max(octagonMs, 1e-9) << "x"
+                                  << std::setw(12) << std::setprecision(4) << differingFraction(ellipseMask, octagonMask)
+                                  << std::setw(12) << std::setprecision(6) << rectDiff << std::endl;
+            }
+        }
+    });
+    
+    std::cout << std::endl << "Settings where the square differs from the rectangular-kernel reference: "
+              << mismatches << std::endl;
+    
+    return mismatches == 0 ? 0 : 2;
+}
@@ -0,0 +1,98 @@
+// Compares the legacy preprocessing chain (blur BGR, Lab round trip with CLAHE,
+// BGR->Gray) with the fused single-plane path: luminance time per image and
+// agreement of the final binary masks.
+#include "binaryMaskEstimator.hh"
+#include "benchUtil.hh"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    std::string pattern = "resources/*.jpg";
+    int repetitions = 5;
+    double tolerance = 0.02;  // Maximum fraction of differing mask pixels
+    int blockSize = 11;
+    double C = 2.0;
+    int kernelSize = 2;
+    int iterations = 1;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (parseCommonArg(argc, argv, i, pattern, repetitions)) {
+            continue;
+        } else if (arg == "-tol" && i + 1 < argc) {
+            tolerance = std::stod(argv[++i]);
+        } else if (arg == "-b" && i + 1 < argc) {
+            blockSize = std::stoi(argv[++i]);
+        } else if (arg == "-c" && i + 1 < argc) {
+            C = std::stod(argv[++i]);
+        } else if (arg == "-k" && i + 1 < argc) {
+            kernelSize = std::stoi(argv[++i]);
+        } else if (arg == "-iter" && i + 1 < argc) {
+            iterations = std::stoi(argv[++i]);
+        } else {
+            std::cout << "Usage: " << argv[0] << " [-glob <pattern>] [-reps <n>] [-tol <fraction>]"
+                      << " [-b <block>] [-c <C>] [-k <kernel>] [-iter <n>]" << std::endl;
+            return arg == "-help" ? 0 : 1;
+        }
+    }
+    
+    std::vector<std::string> paths;
+    if (!globImages(pattern, paths)) {
+        return 1;
+    }
+    
+    BinaryMaskEstimator legacy;
+    BinaryMaskEstimator fused;
+    legacy.setAdaptiveThresholdParams(blockSize, C);
+    legacy.setMorphologicalParams(kernelSize, iterations);
+    fused.setAdaptiveThresholdParams(blockSize, C);
+    fused.setMorphologicalParams(kernelSize, iterations);
+    fused.setFastPreprocessing(true);
+    
+    imageColumn("image") << std::setw(12) << "legacy_ms" << std::setw(12) << "fused_ms"
+                         << std::setw(10) << "speedup" << std::setw(12) << "mask_diff"
+                         << std::setw(10) << "fg_iou" << std::setw(8) << "ok" << std::endl;
+    
+    double legacyTotal = 0.0;
+    double fusedTotal = 0.0;
+    int failures = 0;
+    
+    forEachImage(paths, [&](const std::string& name, const cv::Mat& image) {
+        cv::Mat gray;
+        double legacyMs = medianMs(repetitions, [&] { legacy.computeLuminance(image, gray); });
+        double fusedMs = medianMs(repetitions, [&] { fused.computeLuminance(image, gray); });
+        legacyTotal += legacyMs;
+        fusedTotal += fusedMs;
+        
+        // Compare the final masks the two paths produce
+        legacy.adoptImage(image);
+        fused.adoptImage(image);
+        cv::Mat legacyMask = legacy.estimateBinaryMaskShared();
+        cv::Mat fusedMask = fused.estimateBinaryMaskShared();
+        
+        double diffFraction = differingFraction(legacyMask, fusedMask);
+        bool ok = diffFraction <= tolerance;
+        if (!ok) {
+            failures++;
+        }
+        
+        imageColumn(name) << std::fixed
+                          << std::setw(12) << std::setprecision(2) << legacyMs
+                          << std::setw(12) << std::setprecision(2) << fusedMs
+                          << std::setw(9) << std::setprecision(2) << legacyMs / std::max(fusedMs, 1e-9) << "x"
+                          << std::setw(12) << std::setprecision(4) << diffFraction
+                          << std::setw(10) << std::setprecision(4) << foregroundIoU(legacyMask, fusedMask)
+                          << std::setw(8) << (ok ? "yes" : "NO") << std::endl;
+    });
+    
+    std::cout << std::endl << "Total luminance time: legacy " << std::fixed << std::setprecision(1)
+              << legacyTotal << " ms, fused " << fusedTotal << " ms ("
+              << std::setprecision(2) << legacyTotal / std::max(fusedTotal, 1e-9) << "x)" << std::endl;
+    std::cout << "Images outside tolerance (" << tolerance << "): " << failures << std::endl;
+    
+    return failures == 0 ? 0 : 2;
+}
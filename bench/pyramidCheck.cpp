@@ -0,0 +1,87 @@
+// Regression check for coarse-to-fine mask estimation. Runs the pyramid path
+// with plane and with run-length output on synthetic coin images of changing
+// size, reusing one estimator per mode the way batch workers do, and checks
+// that both modes find the same objects. A buffer kept at the previous
+// image's size shows up as a crash, a run mask of the wrong size or the two
+// modes disagreeing. Exits with 1 on a failure, so it runs as a test (ctest).
+#include "binaryMaskEstimator.hh"
+#include "logger.hh"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Light background with a grid of dark disks
+static cv::Mat drawCoins(const cv::Size& size, int radius, int& drawn) {
+    cv::Mat image(size, CV_8UC3, cv::Scalar(220, 220, 220));
+    const int pitch = radius * 5;
+    drawn = 0;
+    for (int y = pitch / 2; y + radius < size.height; y += pitch) {
+        for (int x = pitch / 2; x + radius < size.width; x += pitch) {
+            cv::circle(image, cv::Point(x, y), radius, cv::Scalar(60, 70, 80), cv::FILLED);
+            drawn++;
+        }
+    }
+    return image;
+}
+
+// Foreground components of the last estimate (row 0 of the stats is the background)
+static int componentCount(const BinaryMaskEstimator& estimator) {
+    return std::max(0, estimator.getComponentStatsRef().rows - 1);
+}
+
+int main(int argc, char* argv[]) {
+    int levels = 2;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-pyramid" && i + 1 < argc) {
+            levels = std::max(1, std::stoi(argv[++i]));
+        } else {
+            std::cout << "Usage: " << argv[0] << " [-pyramid <levels>]" << std::endl;
+            return arg == "-help" ? 0 : 1;
+        }
+    }
+    
+    Logger::setLevel(LogLevel::QUIET);
+    
+    BinaryMaskEstimator plane;
+    BinaryMaskEstimator runs;
+    for (BinaryMaskEstimator* estimator : {&plane, &runs}) {
+        estimator->setAdaptiveThresholdParams(51, 10.0);
+        estimator->setMorphologicalParams(3, 1);
+        estimator->setPyramidLevels(levels);
+    }
+    runs.setRunLengthOutput(true);
+    
+    // Growing, shrinking and non-proportional sizes, so the reused buffers are
+    // always the wrong size for the next image
+    const std::vector<cv::Size> sizes = {
+        cv::Size(640, 480), cv::Size(1600, 1200), cv::Size(800, 600), cv::Size(1200, 1600)
+    };
+    
+    int failures = 0;
+    for (const cv::Size& size : sizes) {
+        int drawn = 0;
+        cv::Mat image = drawCoins(size, 24, drawn);
+        
+        plane.adoptImage(image);
+        plane.estimateBinaryMaskShared();
+        int planeCount = plane.hasMask() ? componentCount(plane) : -1;
+        
+        runs.adoptImage(image);
+        runs.estimateBinaryMaskShared();
+        int runCount = runs.hasMask() ? componentCount(runs) : -1;
+        bool runsSized = runs.getRunMaskRef().rows() == size.height && runs.getRunMaskRef().cols() == size.width;
+        
+        bool ok = planeCount > 0 && runCount == planeCount && runsSized;
+        std::cout << size.width << "x" << size.height << ": " << drawn << " disks, plane " << planeCount
+                  << ", runs " << runCount << (runsSized ? "" : " (run mask has the wrong size)")
+                  << (ok ? "  ok" : "  FAILED") << std::endl;
+        if (!ok) {
+            failures++;
+        }
+    }
+    
+    return failures == 0 ? 0 : 1;
+}
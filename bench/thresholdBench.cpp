@@ -0,0 +1,91 @@
+// Compares the Gaussian adaptive threshold with the integral (running box sum)
+// backend: threshold time per image and block size, agreement of the integral
+// mask with the Gaussian one, and a check that the integral backend matches
+// cv::adaptiveThreshold with a box mean exactly.
+#include "binaryMaskEstimator.hh"
+#include "benchUtil.hh"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    std::string pattern = "resources/*.jpg";
+    std::vector<int> blockSizes = {11, 21, 51, 101};
+    int repetitions = 5;
+    double C = 2.0;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (parseCommonArg(argc, argv, i, pattern, repetitions)) {
+            continue;
+        } else if (arg == "-blocks" && i + 1 < argc) {
+            blockSizes = parseIntList(argv[++i]);
+        } else if (arg == "-c" && i + 1 < argc) {
+            C = std::stod(argv[++i]);
+        } else {
+            std::cout << "Usage: " << argv[0] << " [-glob <pattern>] [-blocks <b1,b2,...>] [-reps <n>]"
+                      << " [-c <C>]" << std::endl;
+            return arg == "-help" ? 0 : 1;
+        }
+    }
+    
+    std::vector<std::string> paths;
+    if (!globImages(pattern, paths)) {
+        return 1;
+    }
+    if (blockSizes.empty()) {
+        std::cerr << "No block sizes given" << std::endl;
+        return 1;
+    }
+    
+    BinaryMaskEstimator gaussian;
+    BinaryMaskEstimator integral;
+    integral.setThresholdMethod(ThresholdMethod::INTEGRAL);
+    
+    imageColumn("image") << std::setw(7) << "block"
+                         << std::setw(12) << "gauss_ms" << std::setw(13) << "integral_ms"
+                         << std::setw(10) << "speedup" << std::setw(12) << "mask_diff"
+                         << std::setw(10) << "fg_iou" << std::setw(12) << "box_diff" << std::endl;
+    
+    int mismatches = 0;
+    
+    forEachImage(paths, [&](const std::string& name, const cv::Mat& image) {
+        cv::Mat gray;
+        gaussian.computeLuminance(image, gray);
+        
+        for (int blockSize : blockSizes) {
+            gaussian.setAdaptiveThresholdParams(blockSize, C);
+            integral.setAdaptiveThresholdParams(blockSize, C);
+            
+            cv::Mat gaussianMask, integralMask;
+            double gaussianMs = medianMs(repetitions, [&] { gaussian.applyAdaptiveThreshold(gray, gaussianMask); });
+            double integralMs = medianMs(repetitions, [&] { integral.applyAdaptiveThreshold(gray, integralMask); });
+            
+            // The integral backend computes a box mean; OpenCV's box-mean threshold is the reference
+            int oddBlock = (blockSize % 2 == 0) ? blockSize + 1 : blockSize;
+            cv::Mat boxMask;
+            cv::adaptiveThreshold(gray, boxMask, 255, cv::ADAPTIVE_THRESH_MEAN_C,
+                                  cv::THRESH_BINARY_INV, oddBlock, C);
+            double boxDiff = differingFraction(boxMask, integralMask);
+            if (boxDiff > 0.0) {
+                mismatches++;
+            }
+            
+            imageColumn(name) << std::setw(7) << oddBlock << std::fixed
+                              << std::setw(12) << std::setprecision(2) << gaussianMs
+                              << std::setw(13) << std::setprecision(2) << integralMs
+                              << std::setw(9) << std::setprecision(2) << gaussianMs / std::max(integralMs, 1e-9) << "x"
+                              << std::setw(12) << std::setprecision(4) << differingFraction(gaussianMask, integralMask)
+                              << std::setw(10) << std::setprecision(4) << foregroundIoU(gaussianMask, integralMask)
+                              << std::setw(12) << std::setprecision(6) << boxDiff << std::endl;
+        }
+    });
+    
+    std::cout << std::endl << "Block sizes where the integral mask differs from the box-mean reference: "
+              << mismatches << std::endl;
+    
+    return mismatches == 0 ? 0 : 2;
+}
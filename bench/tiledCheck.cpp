@@ -0,0 +1,118 @@
+// Regression check for tiled mask estimation. Runs the full-frame and the
+// tiled path on synthetic images of odd sizes, with tiles small enough that
+// every halo (blur, threshold block, morphology) crosses tile edges, for both
+// preprocessing paths, both threshold methods and the iterated and decomposed
+// morphology elements, and checks that the two masks are identical. Exits with
+// 1 on a failure, so it runs as a test (ctest).
+#include "binaryMaskEstimator.hh"
+#include "benchUtil.hh"
+#include "logger.hh"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Noisy background with a brightness gradient and scattered discs, so the
+// adaptive threshold has real work near every tile edge
+static cv::Mat drawScene(const cv::Size& size, bool color, uint64 seed) {
+    cv::RNG rng(seed);
+    cv::Mat image(size, CV_8UC3);
+    for (int y = 0; y < size.height; y++) {
+        cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+        for (int x = 0; x < size.width; x++) {
+            uchar level = cv::saturate_cast<uchar>(140 + 60 * x / size.width - 40 * y / size.height);
+            row[x] = cv::Vec3b(level, static_cast<uchar>(level * 9 / 10), static_cast<uchar>(level * 8 / 10));
+        }
+    }
+    
+    cv::Mat noise(size, CV_8UC3);
+    rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(10));
+    cv::add(image, noise, image);
+    
+    int discs = std::max(4, size.area() / (120 * 120));
+    for (int i = 0; i < discs; i++) {
+        cv::Point center(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        int radius = rng.uniform(6, 40);
+        cv::Scalar fill(rng.uniform(20, 100), rng.uniform(20, 100), rng.uniform(20, 100));
+        cv::circle(image, center, radius, fill, cv::FILLED, cv::LINE_AA);
+    }
+    
+    if (!color) {
+        cv::Mat gray;
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+        return gray;
+    }
+    return image;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<int> tileSizes = {37, 64};
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-tiles" && i + 1 < argc) {
+            tileSizes = parseIntList(argv[++i]);
+        } else {
+            std::cout << "Usage: " << argv[0] << " [-tiles <t1,t2,...>]" << std::endl;
+            return arg == "-help" ? 0 : 1;
+        }
+    }
+    
+    Logger::setLevel(LogLevel::QUIET);
+    
+    // Odd sizes, so the last tile row and column are partial
+    const std::vector<cv::Size> sizes = {cv::Size(517, 389), cv::Size(301, 643), cv::Size(1023, 769)};
+    const ThresholdMethod methods[] = {ThresholdMethod::GAUSSIAN, ThresholdMethod::INTEGRAL};
+    const MorphShape shapes[] = {MorphShape::ELLIPSE, MorphShape::OCTAGON};
+    
+    BinaryMaskEstimator full;
+    BinaryMaskEstimator tiled;
+    for (BinaryMaskEstimator* estimator : {&full, &tiled}) {
+        estimator->setAdaptiveThresholdParams(31, 5.0);
+        estimator->setMorphologicalParams(5, 2);
+    }
+    
+    int failures = 0;
+    int runs = 0;
+    uint64 seed = 1;
+    for (const cv::Size& size : sizes) {
+        for (bool color : {true, false}) {
+            cv::Mat image = drawScene(size, color, seed++);
+            
+            for (bool fast : {false, true}) {
+                for (ThresholdMethod method : methods) {
+                    for (MorphShape shape : shapes) {
+                        for (BinaryMaskEstimator* estimator : {&full, &tiled}) {
+                            estimator->setFastPreprocessing(fast);
+                            estimator->setThresholdMethod(method);
+                            estimator->setMorphShape(shape);
+                        }
+                        full.adoptImage(image);
+                        cv::Mat fullMask = full.estimateBinaryMaskShared();
+                        
+                        for (int tileSize : tileSizes) {
+                            tiled.setTiledExecution(true, tileSize);
+                            tiled.adoptImage(image);
+                            cv::Mat tiledMask = tiled.estimateBinaryMaskShared();
+                            
+                            bool ok = !fullMask.empty() && tiledMask.size() == fullMask.size() &&
+                                      differingFraction(fullMask, tiledMask) == 0.0;
+                            runs++;
+                            if (!ok) {
+                                failures++;
+                                std::cout << size.width << "x" << size.height << (color ? " color" : " gray")
+                                          << (fast ? ", fused" : ", legacy") << " preprocessing, "
+                                          << BinaryMaskEstimator::thresholdMethodName(method) << " mean, "
+                                          << BinaryMaskEstimator::morphShapeName(shape) << " element, tile "
+                                          << tileSize << ": tiled mask differs  FAILED" << std::endl;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    std::cout << runs - failures << "/" << runs << " tiled masks identical to the full-frame mask" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
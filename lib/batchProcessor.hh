@@ -0,0 +1,90 @@
+#ifndef BATCH_PROCESSOR_HH
+#define BATCH_PROCESSOR_HH
+
+#include "coinWorker.hh"
+#include "boundedQueue.hh"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+// Queue between two stages of a pipelined run
+struct StageQueueReport {
+    std::string name;  // e.g. "decode -> compute"
+    BoundedQueueStats stats;
+};
+
+// Aggregate results of a batch run
+struct BatchSummary {
+    int imagesProcessed = 0;
+    int imagesFailed = 0;
+    int totalObjects = 0;
+    std::map<std::string, int> coinCounts;          // By coin key, see ImageResult
+    std::map<std::string, std::string> coinNames;   // Name of the last image that saw the key
+    std::map<std::string, double> totalByCurrency;
+    double elapsedSeconds = 0.0;
+    std::vector<ImageResult> results;  // In input order
+    std::vector<StageQueueReport> queues;  // Pipelined runs only
+};
+
+// Runs a fixed-size pool of worker threads over a list of images. Each thread
+// owns one CoinWorker, so coins.cfg parsing and estimator/counter setup happen
+// once per thread instead of once per image.
+//
+// In pipelined mode decoding and writing get threads of their own, linked to
+// the compute workers by bounded queues:
+//   decoders (imdecode) -> queue -> compute workers (mask, count) -> queue -> writers (PNG encode, write)
+// so the compute workers neither wait for the disk nor spend time encoding.
+// The queues' occupancy shows which stage is the bottleneck: a full queue in
+// front of the compute workers means decode keeps up, an empty one means
+// the run is I/O bound.
+class BatchProcessor {
+private:
+    ProcessingOptions options;
+    int workerCount;
+    std::string outputDirectory;
+    std::shared_ptr<CoinDatabase> coinDatabase;
+    
+    // Pipelined mode (decoderCount > 0)
+    int decoderCount;
+    int writerCount;
+    size_t queueDepth;
+    
+    static std::string outputStemFor(const ImageSource& source);
+    std::vector<std::string> outputBasesFor(const std::vector<ImageSource>& sources) const;
+    BatchSummary runPipelined(const std::vector<ImageSource>& sources);
+    void logProgress(int done, size_t total, const std::string& path, const ImageResult& result) const;
+    static void aggregate(BatchSummary& summary);
+
+public:
+    BatchProcessor(const ProcessingOptions& options, int workerCount);
+    
+    // Write annotated images and masks into this directory (empty = don't save)
+    void setOutputDirectory(const std::string& directory);
+    
+    // Share one coin catalogue between the workers instead of parsing the
+    // config once per thread; a watched database is picked up between images
+    void setCoinDatabase(std::shared_ptr<CoinDatabase> database);
+    
+    // Run pipelined with this many decoder and writer threads next to the
+    // workerCount compute threads, and at most queueDepth images waiting
+    // between two stages. decoders = 0 switches back to the plain pool.
+    void setPipeline(int decoders, int writers, size_t queueDepth);
+    
+    BatchSummary run(const std::vector<std::string>& imagePaths);
+    BatchSummary run(const std::vector<ImageSource>& sources);
+    
+    // Input collection helpers
+    static std::vector<std::string> collectFromDirectory(const std::string& directory);
+    static std::vector<std::string> collectFromGlob(const std::string& pattern);
+    static std::vector<std::string> collectFromManifest(const std::string& manifestPath);
+    static bool isImageFile(const std::string& path);
+    
+    // Image members of an uncompressed tar archive, decoded in place from one
+    // mapping of the archive instead of being extracted first
+    static std::vector<ImageSource> collectFromTar(const std::string& tarPath);
+    
+    static void printSummary(const BatchSummary& summary, bool showPerImage);
+};
+
+#endif // BATCH_PROCESSOR_HH
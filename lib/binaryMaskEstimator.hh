@@ -1,25 +1,85 @@
 #ifndef BINARY_MASK_ESTIMATOR_H
 #define BINARY_MASK_ESTIMATOR_H
 
+#include "processingContext.hh"
+#include "runLengthMask.hh"
+#include "imageSource.hh"
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <vector>
+
+// Local mean the adaptive threshold compares against
+enum class ThresholdMethod {
+    GAUSSIAN,  // Gaussian-weighted mean (cv::adaptiveThreshold); cost grows with the block size
+    INTEGRAL   // Box mean from running sums (BoxThreshold); constant cost per pixel
+};
+
+// Structuring element of the close/open cleanup
+enum class MorphShape {
+    ELLIPSE,  // morphKernelSize ellipse applied morphIterations times (BitMorphology)
+    RECT,     // One square of the combined radius (DecomposedMorphology); side 2*(k/2)+1, so even k round up
+    OCTAGON   // One octagon of the combined radius approximating a disk (DecomposedMorphology)
+};
 
 class BinaryMaskEstimator {
 private:
     cv::Mat inputImage;
     cv::Mat binaryMask;
     
+    // Components of the final mask (ComponentLabeler layout), kept so the
+    // object counter doesn't have to label the mask a second time
+    cv::Mat componentLabels;
+    cv::Mat componentStats;
+    cv::Mat componentCentroids;
+    
+    // Run-length output: the clean mask as runs and the label of each run.
+    // binaryMask and componentLabels stay empty in this mode.
+    bool runLengthOutput;
+    RunLengthMask runMask;
+    std::vector<int> runLabels;
+    
     // Parameters for mask estimation
     int blockSize;
     double C;
+    ThresholdMethod thresholdMethod;
     int morphKernelSize;
     int morphIterations;
+    MorphShape morphShape;
+    bool fastPreprocessing;
+    
+    // Tiled execution
+    bool tiledExecution;
+    int tileSize;  // Core tile edge in pixels, 0 = size tiles to fit the L2 budget
+    
+    // Coarse-to-fine execution
+    int pyramidLevels;  // Each level halves the resolution, 0 = off
+    
+    int minComponentArea;  // Smaller components are dropped from the mask
+    
+    // CLAHE, structuring element and buffers reused from one image to the next
+    ProcessingContext context;
     
     // Helper methods
-    void preprocessImage(cv::Mat& image);
-    void applyAdaptiveThreshold(const cv::Mat& grayImage, cv::Mat& mask);
-    void applyMorphologicalOperations(cv::Mat& mask);
-    void removeSmallComponents(cv::Mat& mask, int minArea);
+    void preprocessImage(const cv::Mat& source, cv::Mat& image, const cv::Size& claheGrid);
+    void preprocessLuminance(const cv::Mat& source, cv::Mat& luminance, const cv::Size& claheGrid);
+    void applyMorphologicalOperations(cv::Mat& mask, BitMask& bits, BitMask& scratch,
+                                      BitMorphology& morphology, DecomposedMorphology& decomposed);
+    void applyMorphologicalOperations(BitMask& bits, BitMask& scratch,
+                                      BitMorphology& morphology, DecomposedMorphology& decomposed);
+    void estimateRunLength();
+    
+    // Tiled pipeline
+    void estimateTiled(cv::Mat& mask);
+    int thresholdMorphologyHalo() const;
+    int chooseTileSize(int halo, int bytesPerPixel) const;
+    static std::vector<cv::Rect> makeTiles(const cv::Size& imageSize, int coreSize);
+    
+    // Pyramid pipeline
+    int effectivePyramidLevels() const;
+    void estimatePyramid(cv::Mat& mask, int levels);
+    void detectCoarse(int levels);
+    void refineWindow(const cv::Rect& region, int coarseLabel, cv::Mat& mask,
+                      std::vector<int>& statsData, std::vector<double>& centroidData);
 
 public:
     // Constructor
@@ -29,23 +89,118 @@ public:
     ~BinaryMaskEstimator();
     
     // Main functionality
-    bool loadImage(const std::string& imagePath);
+    bool loadImage(const std::string& imagePath, int decodeScale = 1);
+    bool loadImage(const ImageSource& source, int decodeScale = 1);
     bool loadImage(const cv::Mat& image);
     cv::Mat estimateBinaryMask();
     
+    // imread/imdecode flags decoding at 1/decodeScale of the full size
+    // (1, 2, 4 or 8). JPEGs are then scaled down inside the decoder, which
+    // skips most of the work of a full-size decode.
+    static int decodeFlags(int decodeScale);
+    
+    // Zero-copy variants: the estimator shares the caller's buffer instead of
+    // cloning it, and hands back its own mask. The mask comes from a small ring
+    // of pooled buffers (ProcessingContext::acquireMask); a buffer is only
+    // written again once its reference count shows that nothing outside the
+    // ring holds it. A caller that keeps its own cv::Mat copy of the mask (as
+    // an ObjectCounter does) therefore keeps it valid and unchanged after the
+    // estimator moves on; the returned reference itself is only good until the
+    // next estimate.
+    bool adoptImage(const cv::Mat& image);
+    const cv::Mat& estimateBinaryMaskShared();
+    
+    // Whether the last estimate produced a mask, as a plane or as runs
+    bool hasMask() const;
+    
+    // Steps 1-2 of the pipeline: the denoised, contrast-enhanced grayscale plane
+    // that gets thresholded. claheGrid is the CLAHE tile grid over source.
+    void computeLuminance(const cv::Mat& source, cv::Mat& gray,
+                          const cv::Size& claheGrid = cv::Size(8, 8));
+    
+    // Steps 3-5, in the order estimateBinaryMask runs them. Exposed so the
+    // stages can be timed on their own.
+    void applyAdaptiveThreshold(const cv::Mat& grayImage, cv::Mat& mask);
+    void applyMorphologicalOperations(cv::Mat& mask);
+    void removeSmallComponents(cv::Mat& mask, int minArea);
+    
     // Parameter setters
     void setAdaptiveThresholdParams(int blockSize, double C);
+    void setThresholdMethod(ThresholdMethod method);
+    ThresholdMethod getThresholdMethod() const;
     void setMorphologicalParams(int kernelSize, int iterations);
     
+    // RECT and OCTAGON run each dilation/erosion as a single element of radius
+    // iterations * (kernelSize / 2), at a cost per pixel that does not grow with it.
+    // The element is centred, so an even kernelSize acts as the next odd size:
+    // RECT matches iterating a (2*(k/2)+1)-pixel square, not OpenCV's off-centre
+    // even square.
+    void setMorphShape(MorphShape shape);
+    MorphShape getMorphShape() const;
+    
+    // Fast path: convert to gray first, then blur and equalize that one plane,
+    // instead of blurring all channels and round-tripping through Lab
+    void setFastPreprocessing(bool enable);
+    bool isFastPreprocessing() const;
+    
+    // Split the image into tiles with halos wide enough for the blur, adaptive
+    // threshold and morphology, run them in parallel and stitch the result.
+    // The mask is identical to the untiled one; tileSize 0 picks a size whose
+    // working set fits in L2.
+    void setTiledExecution(bool enable, int tileSize = 0);
+    bool isTiledExecution() const;
+    
+    // Coarse-to-fine mode: find candidate blobs on an image downscaled by
+    // 2^levels, then segment each candidate again at full resolution inside a
+    // window around it. Mask, labels and statistics stay in full-resolution
+    // pixels, so the object counter and its calibration work unchanged. Meant
+    // for large photos whose objects are still well over 2^levels * 10 pixels
+    // across; takes precedence over tiled execution. 0 turns it off.
+    void setPyramidLevels(int levels);
+    int getPyramidLevels() const;
+    
+    // Emit the mask as runs instead of a 0/255 plane: morphology results are
+    // encoded straight from bits and components are labeled and filtered on
+    // the runs, so neither the clean mask nor the 32-bit label image is ever
+    // allocated at full resolution. Read the result with getRunMaskRef() and
+    // getRunLabelsRef(); the statistics getters work as usual.
+    void setRunLengthOutput(bool enable);
+    bool isRunLengthOutput() const;
+    
+    // Smallest filled area, in pixels of the loaded image, a component needs
+    // to stay in the mask (default 100). Scale it with the image when that was
+    // decoded at reduced size.
+    void setMinComponentArea(int area);
+    int getMinComponentArea() const;
+    
     // Utility methods
     void saveImage(const std::string& outputPath, const cv::Mat& image);
     void displayImages(const std::string& windowName = "Binary Mask Estimation");
     cv::Mat getInputImage() const;
     cv::Mat getBinaryMask() const;
+    const cv::Mat& getInputImageRef() const;
+    const cv::Mat& getBinaryMaskRef() const;
+    const cv::Mat& getComponentLabelsRef() const;
+    const cv::Mat& getComponentStatsRef() const;
+    const cv::Mat& getComponentCentroidsRef() const;
+    const RunLengthMask& getRunMaskRef() const;
+    const std::vector<int>& getRunLabelsRef() const;
     
     // Static utility methods
     static cv::Mat combineImages(const cv::Mat& img1, const cv::Mat& img2);
     static void showImageInfo(const cv::Mat& image, const std::string& imageName);
+    
+    // "gaussian" or "integral"; returns false for anything else
+    static bool parseThresholdMethod(const std::string& name, ThresholdMethod& method);
+    static const char* thresholdMethodName(ThresholdMethod method);
+    
+    // Block sizes the adaptive threshold accepts, for either method: 3 to
+    // BoxThreshold::kMaxBlockSize (even sizes are rounded up to odd)
+    static bool isValidBlockSize(int blockSize);
+    
+    // "ellipse", "rect" or "octagon"; returns false for anything else
+    static bool parseMorphShape(const std::string& name, MorphShape& shape);
+    static const char* morphShapeName(MorphShape shape);
 };
 
 #endif // BINARY_MASK_ESTIMATOR_H
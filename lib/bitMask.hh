@@ -0,0 +1,80 @@
+#ifndef BIT_MASK_HH
+#define BIT_MASK_HH
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+
+// Binary mask stored as one bit per pixel, 64 pixels to a word.
+//
+// Bit i of word j in a row is pixel 64 * j + i. Rows start on a word boundary
+// and the bits past the last column are always zero. An 8x smaller footprint
+// than a 0/255 CV_8UC1 plane, and erosion/dilation work on whole words.
+class BitMask {
+public:
+    BitMask();
+    
+    // Reuses the storage when the size matches; contents are undefined
+    void create(int rows, int cols);
+    
+    int rows() const;
+    int cols() const;
+    int wordsPerRow() const;
+    bool empty() const;
+    
+    uint64_t* row(int y);
+    const uint64_t* row(int y) const;
+    
+    // Mask of the valid bits in a row's last word
+    uint64_t lastWordMask() const;
+    
+    // Conversion from and to CV_8UC1: any non-zero pixel is set, set bits become 255
+    void pack(const cv::Mat& mask);
+    void unpack(cv::Mat& mask) const;
+
+private:
+    int rowCount;
+    int colCount;
+    int words;
+    std::vector<uint64_t> data;
+};
+
+// Erosion and dilation of BitMasks with an arbitrary structuring element, with
+// the same results and border handling as cv::erode / cv::dilate.
+//
+// Every kernel row is one horizontal span of offsets (true for the ellipses,
+// crosses and rectangles getStructuringElement builds). A horizontal pass ORs
+// or ANDs shifted copies of each image row once per distinct span, then a
+// vertical pass combines one such row per kernel row, so the cost per word is
+// about kernel width + kernel height word operations for 64 pixels.
+class BitMorphology {
+public:
+    // Anchor at the kernel center, as cv::Point(-1, -1) gives
+    void setKernel(const cv::Mat& kernel);
+    
+    void dilate(const BitMask& src, BitMask& dst, int iterations = 1);
+    void erode(const BitMask& src, BitMask& dst, int iterations = 1);
+
+private:
+    struct Span {
+        int left;   // Offset of the first column relative to the anchor
+        int right;  // Offset of the last column
+    };
+    
+    struct KernelRow {
+        int dy;    // Row offset relative to the anchor
+        int span;  // Index into spans
+    };
+    
+    void apply(const BitMask& src, BitMask& dst, int iterations, bool erode);
+    void applyOnce(const BitMask& src, BitMask& dst, bool erode);
+    
+    std::vector<Span> spans;           // Distinct spans, narrowest first
+    std::vector<KernelRow> kernelRows;
+    
+    // One horizontal pass per distinct span, reused across calls. Everything
+    // the vertical pass needs is in here, so src and dst may be the same mask.
+    std::vector<BitMask> horizontal;
+};
+
+#endif // BIT_MASK_HH
@@ -0,0 +1,139 @@
+#ifndef BOUNDED_QUEUE_HH
+#define BOUNDED_QUEUE_HH
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Occupancy and waiting of a BoundedQueue since it was created
+struct BoundedQueueStats {
+    size_t capacity = 0;
+    size_t highWater = 0;      // Deepest the queue got
+    double meanDepth = 0.0;    // Average depth right after a push
+    long long pushes = 0;
+    double pushWaitMs = 0.0;   // Producers blocked on a full queue
+    double popWaitMs = 0.0;    // Consumers blocked on an empty queue
+};
+
+// Fixed-capacity multi-producer/multi-consumer FIFO. Producers either wait
+// for room (push) or are turned away at once (tryPush), which is how a server
+// applies backpressure instead of queueing without limit. close() wakes every
+// waiter; consumers still drain what was queued before it. stats() tells
+// which side of the queue is waiting on the other.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : limit(capacity > 0 ? capacity : 1), closed(false), highWater(0), pushes(0), depthSum(0),
+          pushWait(0), popWait(0) {}
+    
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+    
+    // Wait for room; false if the queue was closed first
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!closed && items.size() >= limit) {
+            auto start = std::chrono::steady_clock::now();
+            notFull.wait(lock, [this]() { return closed || items.size() < limit; });
+            pushWait += std::chrono::steady_clock::now() - start;
+        }
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        recordPush();
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+    
+    // Enqueue only if there is room right now
+    bool tryPush(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (closed || items.size() >= limit) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        recordPush();
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+    
+    // Wait for an item; false once the queue is closed and empty
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!closed && items.empty()) {
+            auto start = std::chrono::steady_clock::now();
+            notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+            popWait += std::chrono::steady_clock::now() - start;
+        }
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+    
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+    
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+    
+    size_t capacity() const {
+        return limit;
+    }
+    
+    BoundedQueueStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        BoundedQueueStats result;
+        result.capacity = limit;
+        result.highWater = highWater;
+        result.pushes = pushes;
+        result.meanDepth = pushes > 0 ? static_cast<double>(depthSum) / pushes : 0.0;
+        result.pushWaitMs = std::chrono::duration<double, std::milli>(pushWait).count();
+        result.popWaitMs = std::chrono::duration<double, std::milli>(popWait).count();
+        return result;
+    }
+
+private:
+    // Called with the lock held
+    void recordPush() {
+        pushes++;
+        depthSum += items.size();
+        if (items.size() > highWater) {
+            highWater = items.size();
+        }
+    }
+    
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    const size_t limit;
+    bool closed;
+    
+    size_t highWater;
+    long long pushes;
+    long long depthSum;
+    std::chrono::steady_clock::duration pushWait;
+    std::chrono::steady_clock::duration popWait;
+};
+
+#endif // BOUNDED_QUEUE_HH
@@ -0,0 +1,26 @@
+#ifndef BOX_THRESHOLD_HH
+#define BOX_THRESHOLD_HH
+
+#include <opencv2/opencv.hpp>
+
+// Adaptive threshold against the mean of a blockSize x blockSize box, with a
+// cost per pixel that does not depend on blockSize.
+//
+// Box sums are kept as running column sums (one add and one subtract per
+// pixel as the window moves down) and a running sum along the row, instead of
+// a full integral image whose 32-bit sums would overflow on large frames. The
+// per-pixel loops work on contiguous int arrays without branches so the
+// compiler vectorizes them. The result matches cv::adaptiveThreshold with
+// ADAPTIVE_THRESH_MEAN_C and THRESH_BINARY_INV (replicated border).
+class BoxThreshold {
+public:
+    // Largest block whose box sum (255 * blockSize^2) still fits in 32 bits
+    static const int kMaxBlockSize = 4095;
+    
+    // dst = 255 where src <= boxMean - C, else 0. blockSize must be odd, > 1
+    // and at most 4095.
+    // Row stripes are processed in parallel.
+    static void applyInverse(const cv::Mat& src, cv::Mat& dst, int blockSize, double C);
+};
+
+#endif // BOX_THRESHOLD_HH
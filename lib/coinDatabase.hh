@@ -0,0 +1,72 @@
+#ifndef COIN_DATABASE_HH
+#define COIN_DATABASE_HH
+
+#include "coinRegistry.hh"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Hot-reloadable coin catalogue shared by many ObjectCounters.
+//
+// The catalogue is an immutable CoinRegistry snapshot behind a shared_ptr.
+// A reload builds and validates a complete new registry off to the side and
+// publishes it with one atomic pointer swap, so a reader sees either the old
+// or the new catalogue, never a half-loaded one. Readers grab the current
+// snapshot once per image (one std::atomic_load) and classify against it
+// without further synchronization; a snapshot stays alive for as long as
+// someone still holds it.
+//
+// Coin ids follow the order of the config lines, so they stay the same across
+// reloads as long as existing lines keep their order.
+class CoinDatabase {
+public:
+    // configPaths may list several files separated by commas
+    explicit CoinDatabase(const std::string& configPaths);
+    ~CoinDatabase();
+    
+    CoinDatabase(const CoinDatabase&) = delete;
+    CoinDatabase& operator=(const CoinDatabase&) = delete;
+    
+    // Current catalogue; never null
+    std::shared_ptr<const CoinRegistry> snapshot() const;
+    
+    // Reread the config files and publish them if they pass validation. On
+    // failure the current catalogue stays (the built-in defaults if nothing
+    // was ever loaded) and false is returned.
+    bool reload();
+    
+    // Incremented on every successful reload
+    uint64_t getVersion() const;
+    const std::string& getConfigPaths() const;
+    
+    // Poll the config files' modification time and size every intervalMs and
+    // reload once a change has been stable for one interval, so a file that is
+    // still being written is not picked up halfway
+    void startWatching(int intervalMs);
+    void stopWatching();
+    
+    // Check that a catalogue can be used for classification
+    static bool validate(const CoinRegistry& registry, std::string& error);
+
+private:
+    std::vector<std::string> fileSignatures() const;
+    void watchLoop(int intervalMs);
+    
+    std::string configPaths;
+    std::vector<std::string> files;  // configPaths split at the commas
+    std::shared_ptr<const CoinRegistry> current;  // Accessed with std::atomic_load/atomic_store only
+    std::atomic<uint64_t> version;
+    std::mutex reloadMutex;  // Serializes writers; readers never take it
+    
+    std::thread watcher;
+    std::mutex watchMutex;
+    std::condition_variable watchWakeup;
+    bool watching;
+};
+
+#endif // COIN_DATABASE_HH
@@ -0,0 +1,57 @@
+#ifndef COIN_REGISTRY_HH
+#define COIN_REGISTRY_HH
+
+#include "coinTypes.hh"
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <map>
+
+// Catalogue of coin denominations loaded from coins.cfg-style files.
+//
+// Each denomination gets a CoinType id in load order. A diameter index sorted
+// ascending is rebuilt after every load so nearest-size lookup is a binary
+// search and does not slow down as the catalogue grows.
+class CoinRegistry {
+private:
+    std::vector<CoinInfo> coins;                 // Indexed by CoinType, slot 0 is UNKNOWN_COIN
+    std::map<std::string, CoinType> keyIndex;    // Lower-cased key -> id
+    std::map<std::string, CoinType> nameIndex;   // Lower-cased name -> id of the first coin with it
+    std::vector<double> sortedDiameters;         // Ascending
+    std::vector<CoinType> sortedTypes;           // Id for each entry of sortedDiameters
+    
+    CoinType insert(const CoinInfo& info);
+    void rebuildIndex();
+    void rebuildNameIndex();
+    bool parseLine(const std::string& line, CoinInfo& info, std::string& error) const;
+    
+    static std::string toLower(const std::string& str);
+    static std::string trim(const std::string& str);
+
+public:
+    CoinRegistry();
+    
+    // Loading. Files are appended to the catalogue; a key that is already
+    // present is replaced in place and keeps its id.
+    bool loadFromFile(const std::string& configPath, bool verbose = true);
+    bool loadFromConfigList(const std::string& configPaths, bool verbose = true);
+    void loadDefaults(bool verbose = true);
+    CoinType add(const CoinInfo& info);
+    void clear();
+    
+    // Lookup
+    bool empty() const;
+    size_t size() const;
+    const CoinInfo* find(CoinType type) const;
+    CoinType findByKey(const std::string& keyOrName) const;  // Keys take precedence over names
+    CoinType nearestByDiameter(double diameter_mm, double& difference) const;
+    double smallestDiameter() const;  // 0 when empty
+    const std::vector<CoinInfo>& getCoins() const;
+    std::vector<std::string> getCurrencies() const;
+    
+    static cv::Scalar parseColor(const std::string& colorStr);
+    static std::string formatValue(double value, const std::string& currency);
+    static std::string formatTotals(const std::map<std::string, double>& totals);  // Per currency
+};
+
+#endif // COIN_REGISTRY_HH
@@ -0,0 +1,85 @@
+#ifndef COIN_SERVER_HH
+#define COIN_SERVER_HH
+
+#include "coinWorker.hh"
+#include "boundedQueue.hh"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Long-running server on a Unix domain socket. Like batch mode it keeps one
+// warm CoinWorker per worker thread, so process start, OpenCV initialization
+// and coin config parsing are paid once instead of once per image.
+//
+// One request per connection:
+//   request:  a header line of space-separated key=value pairs, then exactly
+//             <size> bytes of an encoded image (JPEG, PNG, ...)
+//               size=<bytes> [block=<n>] [c=<value>] [ppmm=<value>] [preset=<name>] [name=<label>]
+//   response: one line of JSON, after which the server closes the connection
+//               {"ok":true,"name":"a.jpg","objects":3,"total_value":{"USD":0.35},"coins":{"Dime":1,"Quarter":1},"ms":8.1}
+//               {"ok":false,"error":"..."}
+// Accepted connections wait in a bounded queue for a free worker; when the
+// queue is full a new connection is answered with {"ok":false,"error":"busy"}
+// right away, so overload shows up at the client instead of as growing latency.
+class CoinServer {
+public:
+    CoinServer(const ProcessingOptions& options, int workerCount, size_t queueCapacity);
+    ~CoinServer();
+    
+    // Calibration presets the preset= parameter can name (pixels per mm)
+    void setPresets(const std::map<std::string, double>& presets);
+    
+    // Coin catalogue shared by the workers; with a watched database edits to
+    // the config apply from the next request on
+    void setCoinDatabase(std::shared_ptr<CoinDatabase> database);
+    
+    // Bind and listen on socketPath (an existing socket file is replaced) and
+    // start the workers
+    bool start(const std::string& socketPath);
+    
+    // Accept connections until stop(), then drain the queue and join the workers
+    void run();
+    
+    // Ask run() to return. Only sets a flag, so it may be called from a signal handler.
+    void stop();
+
+private:
+    struct Request {
+        ProcessingOptions options;
+        std::string name;
+        size_t size;
+    };
+    
+    void workerLoop(int workerIndex);
+    void handleConnection(int connection, CoinWorker& worker);
+    bool parseHeader(const std::string& header, Request& request, std::string& error) const;
+    std::string resultToJson(const ImageResult& result, CoinWorker& worker, double milliseconds) const;
+    void shutdown();
+    
+    static bool readLine(int connection, std::string& line, std::string& rest);
+    static bool readExactly(int connection, char* buffer, size_t size);
+    static bool writeAll(int connection, const std::string& text);
+    static std::string errorJson(const std::string& error);
+    static std::string escapeJson(const std::string& text);
+    
+    ProcessingOptions options;
+    int workerCount;
+    std::map<std::string, double> presets;
+    std::shared_ptr<CoinDatabase> coinDatabase;
+    
+    std::string socketPath;
+    int listenSocket;
+    BoundedQueue<int> connections;
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopping;
+    int previousCvThreads;
+    
+    std::atomic<long> served;
+    std::atomic<long> failed;
+    std::atomic<long> rejected;
+};
+
+#endif // COIN_SERVER_HH
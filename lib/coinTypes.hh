@@ -0,0 +1,23 @@
+#ifndef COIN_TYPES_HH
+#define COIN_TYPES_HH
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+// Coin types are ids handed out by CoinRegistry as denominations are loaded,
+// so catalogues of any size and currency can be described in config files.
+// Id 0 is reserved for objects that did not match any coin.
+typedef int CoinType;
+const CoinType UNKNOWN_COIN = 0;
+
+struct CoinInfo {
+    CoinType type = UNKNOWN_COIN;
+    std::string key;          // Config identifier, e.g. PENNY or EUR_2
+    std::string name;         // Display name
+    double diameter_mm = 0.0;
+    cv::Scalar color;         // BGR color for visualization
+    double value = 0.0;       // Face value in units of currency
+    std::string currency;     // ISO code, e.g. USD
+};
+
+#endif // COIN_TYPES_HH
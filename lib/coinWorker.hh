@@ -0,0 +1,125 @@
+#ifndef COIN_WORKER_HH
+#define COIN_WORKER_HH
+
+#include "binaryMaskEstimator.hh"
+#include "objectCounter.hh"
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Settings shared by every image of a run (filled in from the command line)
+struct ProcessingOptions {
+    std::string configPath = "coins.cfg";
+    
+    // Object detection parameters
+    double minArea = 200.0;
+    double maxArea = 50000.0;
+    double minCircularity = 0.3;
+    double maxAspectRatio = 2.0;
+    bool enableAreaFilter = true;
+    bool enableShapeFilter = true;
+    GeometryMode geometryMode = GeometryMode::EXACT;
+    
+    // Mask estimation parameters
+    int blockSize = 11;
+    double C = 2.0;
+    ThresholdMethod thresholdMethod = ThresholdMethod::GAUSSIAN;
+    int kernelSize = 2;
+    int iterations = 1;
+    MorphShape morphShape = MorphShape::ELLIPSE;
+    bool fastPreprocessing = false;
+    bool tiledExecution = false;
+    int tileSize = 0;  // 0 = automatic
+    int pyramidLevels = 0;  // 0 = full resolution only
+    bool runLengthMask = false;
+    int minComponentArea = 100;  // Mask speckle removal, full-resolution pixels
+    double reduceMinCoinPixels = 0.0;  // Reduced decode floor for the smallest coin; 0 = full size
+    
+    // Coin detection parameters
+    bool enableCoins = false;
+    double pixelsPerMM = 12.0;
+    bool doCalibration = false;
+    cv::Point calibrationPoint;
+    std::string calibrationCoin;  // Coin config key or name
+};
+
+// Outcome of processing a single image
+struct ImageResult {
+    std::string imagePath;
+    bool success = false;
+    std::string error;
+    int objectCount = 0;
+    // Keyed by the coin's config key ("" for unknown coins), resolved against
+    // the catalogue that classified this image: CoinType ids are only stable
+    // within one catalogue snapshot and change when a watched config reloads
+    std::map<std::string, int> coinCounts;
+    std::map<std::string, std::string> coinNames;   // Key -> display name
+    std::map<std::string, double> totalByCurrency;  // Face value per currency code
+};
+
+// Images a pipelined run still has to encode and write for one input
+struct RenderedOutput {
+    std::string annotatedPath;
+    std::string maskPath;
+    cv::Mat annotated;
+    cv::Mat mask;
+};
+
+// One BinaryMaskEstimator/ObjectCounter pair configured once and reused for
+// many images. Instances are not thread-safe; batch mode gives every worker
+// thread its own CoinWorker.
+class CoinWorker {
+private:
+    ProcessingOptions options;
+    ProcessingOptions applied;  // options for the current decode scale
+    int decodeScale;
+    BinaryMaskEstimator maskEstimator;
+    ObjectCounter counter;
+    
+    void configure();
+    void useDecodeScale(int scale);
+    ImageResult processLoaded(ImageResult result, const std::string& outputBase);
+
+public:
+    // With a database the coin catalogue is shared and follows its reloads
+    explicit CoinWorker(const ProcessingOptions& options, std::shared_ptr<CoinDatabase> database = nullptr);
+    
+    // Run mask estimation, counting and (optional) classification on one image.
+    // When outputBase is non-empty the annotated image and mask are saved there.
+    ImageResult process(const std::string& imagePath, const std::string& outputBase = "");
+    ImageResult process(const ImageSource& source, const std::string& outputBase = "");
+    
+    // Same for an image held in memory as encoded file bytes (JPEG, PNG, ...);
+    // name only labels the result
+    ImageResult processEncoded(const std::vector<uchar>& bytes, const std::string& name);
+    
+    // Same for an image decoded elsewhere, e.g. by a prefetch thread. The
+    // image is shared, not copied. decodeScale is the reduction it was decoded
+    // with (see chooseDecodeScale).
+    ImageResult processDecoded(const cv::Mat& image, const std::string& imagePath, int decodeScale = 1);
+    
+    // Draw the annotated image of the last processed image and grab its mask,
+    // leaving encoding and writing to the caller. The output owns its buffers.
+    void renderOutputs(const std::string& outputBase, RenderedOutput& output);
+    
+    // Reconfigure for later images, e.g. per-request parameters in server mode
+    void setOptions(const ProcessingOptions& options);
+    
+    const ProcessingOptions& getOptions() const;
+    std::string getCoinName(CoinType type) const;
+    
+    // Reduced decode. With options.reduceMinCoinPixels set and a calibration,
+    // the largest of 2, 4 or 8 that keeps the smallest coin of the catalogue at
+    // least that many pixels across; 1 otherwise.
+    static int chooseDecodeScale(const ProcessingOptions& options, double smallestCoinMM);
+    
+    // Options for an image decoded at 1/decodeScale size: the area filters,
+    // calibration, calibration point, threshold block and morphology kernel are
+    // all given at full size and shrink with the image, so counts and
+    // millimetre diameters come out the same. The kernel stops shrinking at 3.
+    static ProcessingOptions scaledOptions(const ProcessingOptions& options, int decodeScale);
+};
+
+#endif // COIN_WORKER_HH
@@ -0,0 +1,62 @@
+#ifndef COMPONENT_LABELING_HH
+#define COMPONENT_LABELING_HH
+
+#include "runLengthMask.hh"
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Intermediate buffers of ComponentLabeler::labelFilled. Passing the same
+// scratch for every image lets the labeling reuse them instead of allocating.
+struct LabelingScratch {
+    cv::Mat background;
+    cv::Mat fgStats, fgCentroids;
+    cv::Mat bgLabels, bgStats, bgCentroids;
+    std::vector<int> holeParent, parentHole, root, newLabel, fgMap, bgMap;
+    std::vector<double> area, sumX, sumY;
+};
+
+// Intermediate buffers of ComponentLabeler::labelRuns
+struct RunLabelingScratch {
+    std::vector<MaskRun> gaps;  // Background runs, row by row
+    std::vector<int> gapOffsets, gapLeftRun, runGapAfter;
+    std::vector<int> runParent, gapParent, newLabel;
+    std::vector<unsigned char> gapOnBorder;
+    std::vector<long long> area;
+};
+
+// Connected-component labeling of binary masks with holes filled.
+//
+// Components are labeled the way "fill every external contour" sees them:
+// 8-connected foreground, where enclosed background (holes) and anything
+// nested inside a hole belong to the surrounding component. Area, bounding
+// box and centroid therefore describe the filled outline, as contourArea and
+// fillPoly would.
+class ComponentLabeler {
+private:
+    static bool touchesBorder(const cv::Mat& stats, int label, const cv::Size& size);
+    static int firstColumn(const cv::Mat& labels, const cv::Mat& stats, int label);
+
+public:
+    // Label a CV_8UC1 mask. Components whose filled area is below minArea are
+    // dropped; the rest are numbered 1..n-1 in raster order of their first
+    // pixel. Outputs use the cv::connectedComponentsWithStats layout: labels is
+    // CV_32S, stats is n x 5 CV_32S (CC_STAT_*), centroids is n x 2 CV_64F,
+    // row 0 is the background. When cleanMask is given it receives the filled
+    // 0/255 mask of the kept components. Returns n (background included).
+    // labels is written in place when it already has the mask's size and type.
+    static int labelFilled(const cv::Mat& mask, int minArea,
+                           cv::Mat& labels, cv::Mat& stats, cv::Mat& centroids,
+                           cv::Mat* cleanMask = nullptr, LabelingScratch* scratch = nullptr);
+    
+    // The same labeling on a run-length mask, without expanding it. Runs are
+    // united across rows (8-connected for the foreground, 4-connected for the
+    // gaps between them), and every enclosed gap joins the runs on either side
+    // of it. cleanMask receives the kept components with holes filled and must
+    // not be mask itself; runLabels gets the label of each of its runs. stats
+    // and centroids are laid out as above. Returns n (background included).
+    static int labelRuns(const RunLengthMask& mask, int minArea, RunLengthMask& cleanMask,
+                         std::vector<int>& runLabels, cv::Mat& stats, cv::Mat& centroids,
+                         RunLabelingScratch* scratch = nullptr);
+};
+
+#endif // COMPONENT_LABELING_HH
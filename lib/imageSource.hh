@@ -0,0 +1,73 @@
+#ifndef IMAGE_SOURCE_HH
+#define IMAGE_SOURCE_HH
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Read-only memory mapping of a whole file. The pages are shared with the
+// page cache, so reading the file costs no copy into a user buffer.
+class MappedFile {
+public:
+    // nullptr (and a message on stderr) if the file can't be opened or mapped
+    static std::shared_ptr<const MappedFile> open(const std::string& path);
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const uchar* data() const;
+    size_t size() const;
+    const std::string& getPath() const;
+    
+    // Ask the kernel to start reading a range we are about to decode
+    void willNeed(size_t offset, size_t length) const;
+
+private:
+    MappedFile(const std::string& path, void* address, size_t length);
+    
+    std::string path;
+    void* address;
+    size_t length;
+};
+
+// Encoded bytes of one image: a whole file, or a member of an uncompressed
+// tar archive addressed by its offset and size. Decoding hands the bytes to
+// cv::imdecode straight from the mapping, so a member of an archive is never
+// extracted or copied. All members of an archive share one mapping, which
+// stays alive as long as any of them does.
+class ImageSource {
+public:
+    ImageSource();
+    
+    // A file on disk; it is mapped when decoded and unmapped afterwards
+    static ImageSource fromFile(const std::string& path);
+    static std::vector<ImageSource> fromFiles(const std::vector<std::string>& paths);
+    
+    // The regular files of a ustar/GNU/pax tar archive, in archive order,
+    // named "<archive>:<member path>". Returns false (with a message on
+    // stderr) if the archive can't be mapped, is compressed or is corrupt.
+    static bool listTar(const std::string& tarPath, std::vector<ImageSource>& members);
+    
+    // Decode with imread-style flags; an empty Mat on failure
+    cv::Mat decode(int flags = cv::IMREAD_COLOR) const;
+    
+    // "<path>" or "<archive>:<member path>"
+    const std::string& getName() const;
+    
+    // Path inside the archive; empty for a plain file
+    const std::string& getMemberPath() const;
+    bool isArchiveMember() const;
+
+private:
+    std::string name;
+    std::string path;                           // File to map when mapping is empty
+    std::string memberPath;                     // Path inside the archive
+    std::shared_ptr<const MappedFile> mapping;  // Archive the bytes live in
+    size_t offset;
+    size_t size;
+};
+
+#endif // IMAGE_SOURCE_HH
@@ -0,0 +1,62 @@
+#ifndef LOGGER_HH
+#define LOGGER_HH
+
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <string>
+
+// Progress messages are leveled: QUIET prints none, INFO the run-level
+// progress, DEBUG everything including per-image details. Errors and
+// warnings still go straight to std::cerr.
+enum class LogLevel {
+    QUIET = 0,
+    INFO = 1,
+    DEBUG = 2
+};
+
+class Logger {
+public:
+    static void setLevel(LogLevel level);
+    static LogLevel getLevel();
+    static bool isEnabled(LogLevel level) {
+        return static_cast<int>(level) <= currentLevel.load(std::memory_order_relaxed);
+    }
+    
+    // Parse "quiet", "info" or "debug"
+    static bool parseLevel(const std::string& name, LogLevel& level);
+    
+    // Push buffered console output out, e.g. before waiting for a key press
+    static void flush();
+    
+private:
+    static std::atomic<int> currentLevel;
+};
+
+// One log line. Text is formatted into a buffer owned by the calling thread
+// and handed to std::cout as a single write when the line ends, without
+// flushing, so threads never interleave within a line or contend while
+// formatting.
+class LogMessage {
+public:
+    LogMessage();
+    ~LogMessage();
+    
+    std::ostream& stream() { return *out; }
+    
+    LogMessage(const LogMessage&) = delete;
+    LogMessage& operator=(const LogMessage&) = delete;
+    
+private:
+    std::ostringstream* out;
+    std::unique_ptr<std::ostringstream> nested;  // Only when a message is built inside another
+};
+
+// Use as LOG_INFO << "text" << value; The level is checked before anything
+// is formatted, so suppressed messages cost one relaxed load.
+#define LOG_INFO \
+    if (!Logger::isEnabled(LogLevel::INFO)) {} else LogMessage().stream()
+#define LOG_DEBUG \
+    if (!Logger::isEnabled(LogLevel::DEBUG)) {} else LogMessage().stream()
+
+#endif // LOGGER_HH
@@ -1,49 +1,60 @@
 #ifndef OBJECT_COUNTER_HH
 #define OBJECT_COUNTER_HH
 
+#include "coinTypes.hh"
+#include "coinRegistry.hh"
+#include "coinDatabase.hh"
+#include "objectTable.hh"
+#include "bitMask.hh"
+#include "runLengthMask.hh"
+#include "imageSource.hh"
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 
-enum class CoinType {
-    UNKNOWN = 0,
-    PENNY = 1,
-    NICKEL = 2,
-    DIME = 3,
-    QUARTER = 4,
-    HALF_DOLLAR = 5,
-    DOLLAR = 6
-};
-
-struct CoinInfo {
-    CoinType type;
-    std::string name;
-    double diameter_mm;
-    cv::Scalar color;  // BGR color for visualization
-};
+class BinaryMaskEstimator;
 
-struct ObjectInfo {
-    int id;
-    double area;
-    cv::Point2f center;
-    cv::Rect boundingBox;
-    std::vector<cv::Point> contour;
-    double circularity;
-    double aspectRatio;
-    
-    // New coin-specific fields
-    CoinType coinType;
-    double diameter_pixels;
-    double estimated_diameter_mm;
-    double confidence;  // 0.0 to 1.0
+// How circularity and diameter are measured
+enum class GeometryMode {
+    EXACT,  // On the traced contour: arcLength perimeter, minEnclosingCircle diameter
+    FAST    // From the component's second-order moments, without tracing
 };
 
 class ObjectCounter {
 private:
     cv::Mat inputImage;
     cv::Mat binaryMask;
-    std::vector<ObjectInfo> detectedObjects;
+    ObjectTable candidateObjects;  // Objects passing the area filter
+    
+    // Candidates passing the shape filter. Contours and the features measured
+    // on them are filled in when first needed, also from const accessors, so
+    // the table and the tracing scratch are mutable.
+    mutable ObjectTable detectedObjects;
+    
+    // Tracing state of one parallel stripe of findContours
+    struct TraceScratch {
+        cv::Mat objectMask;  // Grows to the largest component bounding box
+        std::vector<std::vector<cv::Point>> contours;
+    };
+    
+    // Scratch buffers reused across images
+    std::vector<unsigned char> keepFlags;
+    mutable std::vector<std::vector<cv::Point>> tracedContours;  // One per detected object
+    mutable std::vector<TraceScratch> traceScratch;              // One per stripe
+    
+    // Connected components of the mask (ComponentLabeler layout). Either
+    // handed over with the mask or computed on demand by findContours.
+    // componentLabels stays empty when the mask is held as runs.
+    cv::Mat componentLabels;
+    cv::Mat componentStats;
+    cv::Mat componentCentroids;
+    
+    // Run-length alternative to binaryMask (only one of the two is set), and
+    // the component label of each run
+    RunLengthMask runMask;
+    std::vector<int> runLabels;
     
     // Parameters for object detection
     double minObjectArea;
@@ -52,72 +63,154 @@ private:
     double maxAspectRatio;
     bool useAreaFiltering;
     bool useShapeFiltering;
+    GeometryMode geometryMode;
     
     bool enableCoinClassification;
     double pixelsPerMM;  // Calibration factor for size-based classification
-    std::map<CoinType, CoinInfo> coinDatabase;
+    int reportScale;     // Decode reduction undone in reported geometry
+    
+    // Coin catalogue in use: an immutable snapshot, either private to this
+    // counter or taken from coinDatabase at the start of every image
+    std::shared_ptr<const CoinRegistry> coinRegistry;
+    std::shared_ptr<CoinDatabase> coinDatabase;
     std::string configFilePath;
-
+    
+    // Inputs changed since the last countObjects(), as DirtyInput bits
+    enum DirtyInput {
+        DIRTY_MASK = 1 << 0,
+        DIRTY_AREA_FILTER = 1 << 1,
+        DIRTY_SHAPE_FILTER = 1 << 2,
+        DIRTY_CLASSIFICATION = 1 << 3,  // Calibration, coin database or enable flag
+        DIRTY_ALL = 0xF
+    };
+    unsigned int dirtyInputs;
+    
+    void markDirty(unsigned int inputs);
+    void refreshCoinSnapshot();
+    bool isDirty(unsigned int inputs) const;
+    void invalidateMask();
+    void clearClassification();
+    bool hasMask() const;
+    cv::Size maskSize() const;
+    cv::Mat materializedMask() const;
+    void paintComponent(int label, const cv::Rect& boundingBox, cv::Mat& objectMask) const;
+    void ensureFeatures(unsigned int features) const;
+    void traceComponent(int label, const cv::Rect& boundingBox, TraceScratch& scratch,
+                        std::vector<cv::Point>& contour) const;
+    static int featureStripes(int objectCount);
+    cv::Moments componentMoments(int label, const cv::Rect& boundingBox) const;
+    
     // Internal methods
-    void findContours();
-    void analyzeObjects();
-    double calculateCircularity(const std::vector<cv::Point>& contour, double area);
-    double calculateAspectRatio(const cv::Rect& boundingBox);
-    bool isValidObject(const ObjectInfo& obj);
+    static double calculateCircularity(cv::InputArray contour, double area);
+    static double calculateAspectRatio(const cv::Rect& boundingBox);
     void drawObjectAnnotations(cv::Mat& image);
-   
+    cv::Rect scaleRect(const cv::Rect& rect) const;
+    
     //coin config loading 
     void initializeCoinDatabase();
     bool loadCoinConfigFromFile(const std::string& configPath);
     void loadDefaultCoinConfig();
-    void classifyCoins();
     CoinType classifyBySize(double diameter_mm, double& confidence);
-    double calculateDiameter(const std::vector<cv::Point>& contour);
+    static double calculateDiameter(cv::InputArray contour);
+    static void measureMoments(const cv::Moments& moments, double& circularity, double& diameter);
     std::string coinTypeToString(CoinType type) const;
     cv::Scalar getCoinColor(CoinType type) const;
-    CoinType stringToCoinType(const std::string& coinStr) const;
-    cv::Scalar parseColor(const std::string& colorStr) const;
     
-
-
+    
+    
     // Static helper methods
     static void showImageInfo(const cv::Mat& image, const std::string& imageName);
-    
+
 public:
-    // Constructor and Destructor
-    ObjectCounter(std::string configPath);
+    // Constructor and Destructor. With a database the catalogue comes from it
+    // and configPath is only informational.
+    ObjectCounter(std::string configPath, std::shared_ptr<CoinDatabase> database = nullptr);
     ~ObjectCounter();
     
     // Image loading methods
     bool loadImage(const std::string& imagePath);
+    bool loadImage(const ImageSource& source);
     bool loadImage(const cv::Mat& image);
     
     // Binary mask loading method
     bool loadBinaryMask(const cv::Mat& mask);
+    bool loadBinaryMask(const BitMask& mask);
+    
+    // Run-length mask: components are labeled on the runs and only painted
+    // into a bounding-box sized buffer to trace their contours. The runs are
+    // copied; they are small.
+    bool loadRunLengthMask(const RunLengthMask& mask);
     
-    // Main processing method
+    // Zero-copy handoff: share the caller's buffers instead of cloning them.
+    // adoptBinaryMask expects a single-channel 0/255 mask such as the one
+    // BinaryMaskEstimator produces; anything else goes through loadBinaryMask.
+    bool adoptImage(const cv::Mat& image);
+    bool adoptBinaryMask(const cv::Mat& mask);
+    bool adoptComponents(const cv::Mat& labels, const cv::Mat& stats, const cv::Mat& centroids);
+    bool adoptRunComponents(const std::vector<int>& labels, const cv::Mat& stats, const cv::Mat& centroids);
+    bool loadFromEstimator(const BinaryMaskEstimator& estimator);
+    
+    // Main processing method. Incremental: only stages whose inputs (mask,
+    // filters, calibration, coin database) changed since the last call are rerun.
     int countObjects();
-
-    // Configuration methods for coin size and type
+    
+    // Rerun only coin classification on the existing detections
+    int reclassify();
+    
+    // The individual stages of countObjects, in order. They skip the dirty
+    // tracking, so use countObjects() for normal processing; these exist so
+    // the stages can be timed on their own.
+    void findContours();
+    void analyzeObjects();
+    void classifyCoins();
+    
+    // Configuration methods for coin size and type. configPath may list
+    // several files separated by commas, e.g. "coins.cfg,coins_eur.cfg".
+    // loadCoinConfig gives the counter a private catalogue again, detaching
+    // it from a shared database; reloadCoinConfig rereads whichever is in use.
     bool loadCoinConfig(const std::string& configPath);
     void reloadCoinConfig();
     std::string getConfigPath() const;
-
+    
+    // Follow a shared, hot-reloadable catalogue. Each countObjects() or
+    // reclassify() classifies against the snapshot current when it starts.
+    void setCoinDatabase(std::shared_ptr<CoinDatabase> database);
+    
     // Parameter setting methods
     void setAreaFilter(double minArea, double maxArea);
     void setShapeFilter(double minCircularity, double maxAspectRatio);
     void enableAreaFiltering(bool enable);
     void enableShapeFiltering(bool enable);
     
+    // FAST skips contour tracing for the shape filter and classification;
+    // contours are then only traced for annotation. See measureMoments for
+    // what the estimates are.
+    void setGeometryMode(GeometryMode mode);
+    GeometryMode getGeometryMode() const;
+    static bool parseGeometryMode(const std::string& name, GeometryMode& mode);
+    static const char* geometryModeName(GeometryMode mode);
+    
     // New coin classification methods
     void setCoinClassification(bool enable);
     void setPixelsPerMM(double pixelsPerMM);
     void calibrateWithKnownCoin(const cv::Point& coinCenter, CoinType knownType);
+    void calibrateWithKnownCoin(const cv::Point& coinCenter, const std::string& knownCoin);
     std::map<CoinType, int> getCoinCounts() const;
-    double getTotalValue() const;
+    std::map<std::string, double> getTotalValueByCurrency() const;
+    std::string getCoinName(CoinType type) const;
+    CoinType findCoinType(const std::string& keyOrName) const;
+    const CoinRegistry& getCoinRegistry() const;
+    double getSmallestCoinDiameter() const;  // mm, from the current catalogue
+    
+    // For an image decoded at 1/scale size: areas, centres, boxes, contours,
+    // the annotated image and the saved mask are reported at full size.
+    // Detection itself and getObjectTable() stay in decoded pixels.
+    void setReportScale(int scale);
+    int getReportScale() const;
     
     // Results and display methods
     std::vector<ObjectInfo> getObjectInfo() const;
+    const ObjectTable& getObjectTable() const;
     void printObjectSummary() const;
     void printCoinSummary() const;
     void displayResults(const std::string& windowName = "Object Detection Results");
@@ -127,16 +220,21 @@ public:
     void saveAnnotatedImage(const std::string& outputPath);
     void saveBinaryMask(const std::string& outputPath);
     void saveResults(const std::string& basePath);
+    static void resultPaths(const std::string& basePath, std::string& annotatedPath, std::string& maskPath);
     
     // Getter methods
     cv::Mat getInputImage() const;
     cv::Mat getBinaryMask() const;
+    const cv::Mat& getInputImageRef() const;
+    const cv::Mat& getBinaryMaskRef() const;  // Empty when the mask was loaded as runs
+    const RunLengthMask& getRunMaskRef() const;
     int getObjectCount() const;
+    cv::Mat getReportMask() const;  // Mask at the reported (full) size
     
     // Static utility methods
     static cv::Mat combineImages(const cv::Mat& img1, const cv::Mat& img2, const cv::Mat& img3);
     static std::string generateSummaryText(int objectCount, const std::string& imageName = "");
-    static std::string generateCoinSummaryText(const std::map<CoinType, int>& coinCounts, double totalValue);
+    static std::string generateCoinSummaryText(int coinCount, const std::map<std::string, double>& totals);
 };
 
 #endif // OBJECT_COUNTER_HH
@@ -0,0 +1,86 @@
+#ifndef OBJECT_TABLE_HH
+#define OBJECT_TABLE_HH
+
+#include "coinTypes.hh"
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+struct ObjectInfo {
+    int id;
+    double area;
+    cv::Point2f center;
+    cv::Rect boundingBox;
+    std::vector<cv::Point> contour;
+    double circularity;
+    double aspectRatio;
+    
+    // New coin-specific fields
+    CoinType coinType;
+    double diameter_pixels;
+    double estimated_diameter_mm;
+    double confidence;  // 0.0 to 1.0
+};
+
+// Structure-of-arrays store for detected objects. Each feature lives in its
+// own array indexed by object, and all contour points share one flat buffer
+// addressed through contourOffset (object i owns points
+// [contourOffset[i], contourOffset[i + 1])). The object id is its index.
+//
+// Buffers keep their capacity across clear(), so an ObjectCounter reused for
+// many images settles at a fixed set of allocations.
+//
+// Area, center, bounding box and aspect ratio are always set. The contour and
+// the features measured on it are filled in on demand; computedFeatures says
+// which of them are valid.
+struct ObjectTable {
+    enum LazyFeature {
+        FEATURE_CONTOUR = 1 << 0,
+        FEATURE_CIRCULARITY = 1 << 1,  // Needs the contour
+        FEATURE_DIAMETER = 1 << 2,     // Needs the contour
+        FEATURE_ALL = 0x7
+    };
+    
+    std::vector<int> label;  // Component label in the mask the object came from
+    std::vector<double> area;
+    std::vector<cv::Point2f> center;
+    std::vector<cv::Rect> boundingBox;
+    std::vector<double> circularity;
+    std::vector<double> aspectRatio;
+    std::vector<double> diameterPixels;
+    std::vector<double> diameterMM;
+    std::vector<double> confidence;
+    std::vector<CoinType> coinType;
+    
+    std::vector<int> contourOffset;
+    std::vector<cv::Point> contourPoints;
+    
+    unsigned int computedFeatures;  // LazyFeature bits
+    
+    ObjectTable();
+    
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    void reserve(size_t objects, size_t points);
+    
+    // Append an object without a contour; features default to zero/UNKNOWN.
+    // Returns the new object's index.
+    size_t add(int label, double area, const cv::Point2f& center, const cv::Rect& boundingBox);
+    
+    // Replace every object's contour, one per object in order
+    void setContours(const std::vector<std::vector<cv::Point>>& contours);
+    
+    // Contour of object i as a point pointer/count pair, or as a Mat header
+    // over the shared buffer (no copy) for OpenCV geometry functions
+    const cv::Point* contourData(size_t i) const;
+    int contourSize(size_t i) const;
+    cv::Mat contourMat(size_t i) const;
+    
+    // Keep only the objects whose flag is non-zero, preserving order. Works in
+    // place, including the contour buffer.
+    void compact(const std::vector<unsigned char>& keep);
+    
+    ObjectInfo toObjectInfo(size_t i) const;
+};
+
+#endif // OBJECT_TABLE_HH
@@ -0,0 +1,70 @@
+#ifndef PROCESSING_CONTEXT_HH
+#define PROCESSING_CONTEXT_HH
+
+#include "componentLabeling.hh"
+#include "bitMask.hh"
+#include "decomposedMorphology.hh"
+#include "runLengthMask.hh"
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Long-lived state of one mask estimator, and so of one worker: the CLAHE
+// object, the structuring element and every scratch buffer of the pipeline.
+// OpenCV writes into an output Mat in place when its size and type already
+// match, so keeping these alive across images makes steady-state processing
+// of same-resolution frames free of allocations on our side.
+//
+// Not thread-safe; each worker owns its own context.
+class ProcessingContext {
+public:
+    ProcessingContext();
+    
+    // Created on first use, then reused; the tile grid is only reset when it changes
+    cv::Ptr<cv::CLAHE>& clahe(const cv::Size& tileGrid = cv::Size(8, 8));
+    
+    // Elliptical kernel, rebuilt only when the size changes. Call once before
+    // sharing the result across threads.
+    const cv::Mat& structuringElement(int kernelSize);
+    
+    // Buffers that are handed to other owners (the mask and labels end up in
+    // the ObjectCounter) come from small rings. An entry is only reused once
+    // nothing outside the ring refers to it any more, so a consumer still
+    // holding the previous image's mask is never overwritten.
+    cv::Mat acquireMask(const cv::Size& size);
+    cv::Mat acquireLabels(const cv::Size& size);
+    
+    // Scratch buffers, private to the estimator between calls
+    cv::Mat blurred;
+    cv::Mat lab;
+    std::vector<cv::Mat> labChannels;
+    cv::Mat gray;
+    BitMask maskBits, morphBits;
+    BitMorphology morphology;
+    DecomposedMorphology decomposedMorphology;
+    LabelingScratch labeling;
+    
+    // Run-length output: the thresholded plane and the runs before labeling
+    cv::Mat thresholdMask;
+    RunLengthMask rawRuns;
+    RunLabelingScratch runLabeling;
+    
+    // Pyramid mode: the downscaled image and its components, and the
+    // full-resolution window currently being refined
+    cv::Mat pyramidImage, pyramidMask;
+    cv::Mat pyramidLabels, pyramidStats, pyramidCentroids;
+    cv::Mat windowGray, windowMask;
+    cv::Mat windowLabels, windowStats, windowCentroids;
+    
+private:
+    static cv::Mat acquire(std::vector<cv::Mat>& ring, const cv::Size& size, int type);
+    static bool isIdle(const cv::Mat& buffer);
+    
+    cv::Ptr<cv::CLAHE> claheInstance;
+    cv::Mat kernel;
+    int kernelSize;
+    
+    std::vector<cv::Mat> maskRing;
+    std::vector<cv::Mat> labelRing;
+};
+
+#endif // PROCESSING_CONTEXT_HH
@@ -0,0 +1,60 @@
+#ifndef RUN_LENGTH_MASK_HH
+#define RUN_LENGTH_MASK_HH
+
+#include "bitMask.hh"
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Horizontal run of set pixels, columns [start, end)
+struct MaskRun {
+    int start;
+    int end;
+};
+
+// Binary mask stored as runs of set pixels, row by row.
+//
+// Coin masks are a handful of solid discs, so a row holds a few runs and the
+// whole mask a few thousand, against millions of bytes for a 0/255 plane.
+// The runs of row y are run(rowBegin(y)) .. run(rowEnd(y) - 1), sorted and
+// never touching each other.
+class RunLengthMask {
+public:
+    RunLengthMask();
+    
+    // Empty mask of the given size, ready for appendRun/endRow
+    void create(int rows, int cols);
+    void clear();
+    
+    int rows() const;
+    int cols() const;
+    bool empty() const;
+    
+    size_t runCount() const;
+    int rowBegin(int y) const;
+    int rowEnd(int y) const;
+    const MaskRun& run(int i) const;
+    const MaskRun* runData() const;
+    
+    // Set pixels
+    long long area() const;
+    
+    // Building: append the runs of the current row left to right, then close it.
+    // create() followed by one endRow() per row gives a complete mask.
+    void appendRun(int start, int end);
+    void extendLastRun(int end);
+    void endRow();
+    
+    // Conversion from a CV_8UC1 mask (any non-zero pixel is set) or a BitMask,
+    // and back to a 0/255 CV_8UC1 plane
+    void encode(const cv::Mat& mask);
+    void encode(const BitMask& mask);
+    void paint(cv::Mat& mask) const;
+
+private:
+    int rowCount;
+    int colCount;
+    std::vector<int> rowOffsets;  // rows + 1 entries once complete
+    std::vector<MaskRun> runs;
+};
+
+#endif // RUN_LENGTH_MASK_HH
@@ -0,0 +1,88 @@
+#ifndef STAGE_TIMER_HH
+#define STAGE_TIMER_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide collector for pipeline stage timings.
+//
+// Every thread records into its own buffer, so timers never take a lock on
+// the hot path. Per-stage totals are always kept; individual events are only
+// stored while tracing is enabled, for export as a Chrome trace-event file
+// (chrome://tracing or ui.perfetto.dev) with one lane per thread.
+// Stage names must be string literals: only the pointer is stored.
+class StageTrace {
+public:
+    struct Event {
+        const char* name;
+        int64_t startUs;
+        int64_t durationUs;
+    };
+    
+    struct StageTotal {
+        const char* name;
+        int64_t count = 0;
+        int64_t totalUs = 0;
+        int64_t maxUs = 0;
+    };
+    
+    struct ThreadBuffer {
+        int lane;
+        std::string threadName;
+        std::vector<Event> events;
+        std::vector<StageTotal> totals;
+    };
+    
+    static StageTrace& instance();
+    
+    // Keep every event for writeChromeTrace (off by default)
+    void setTracingEnabled(bool enable);
+    bool isTracingEnabled() const;
+    
+    // Label the calling thread's lane, e.g. "worker 2"
+    void setThreadName(const std::string& name);
+    
+    void record(const char* name, std::chrono::steady_clock::time_point start,
+                std::chrono::steady_clock::time_point end);
+    
+    // Reporting. Call once the threads that recorded have finished.
+    bool writeChromeTrace(const std::string& path) const;
+    void printSummary() const;
+    void clear();
+
+private:
+    StageTrace();
+    
+    ThreadBuffer& threadBuffer();
+    
+    std::chrono::steady_clock::time_point origin;
+    std::atomic<bool> tracingEnabled;
+    
+    mutable std::mutex buffersMutex;  // Guards the list, not the buffers
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+// Times the enclosing scope as one stage
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char* stageName)
+        : name(stageName), start(std::chrono::steady_clock::now()) {}
+    
+    ~ScopedTimer() {
+        StageTrace::instance().record(name, start, std::chrono::steady_clock::now());
+    }
+    
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // STAGE_TIMER_HH
@@ -0,0 +1,524 @@
+#include "batchProcessor.hh"
+#include "stageTimer.hh"
+#include "logger.hh"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+
+// Constructor
+BatchProcessor::BatchProcessor(const ProcessingOptions& aOptions, int aWorkerCount)
+    : options(aOptions), workerCount(aWorkerCount), decoderCount(0), writerCount(1), queueDepth(8)
+{
+    if (workerCount <= 0) {
+        workerCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    if (workerCount <= 0) {
+        workerCount = 1;
+    }
+}
+
+// Set the directory that receives per-image outputs
+void BatchProcessor::setOutputDirectory(const std::string& directory) {
+    outputDirectory = directory;
+}
+
+// Set the coin catalogue shared by the workers
+void BatchProcessor::setCoinDatabase(std::shared_ptr<CoinDatabase> database) {
+    coinDatabase = database;
+}
+
+// Configure pipelined mode
+void BatchProcessor::setPipeline(int decoders, int writers, size_t depth) {
+    decoderCount = std::max(0, decoders);
+    writerCount = std::max(1, writers);
+    queueDepth = std::max<size_t>(1, depth);
+}
+
+// Output file stem of an input image. A file is named after its file name; an
+// archive member after its path inside the archive, directories joined with
+// '_', so members with the same file name in different directories stay apart.
+std::string BatchProcessor::outputStemFor(const ImageSource& source) {
+    std::string imageName;
+    if (source.isArchiveMember()) {
+        imageName = source.getMemberPath();
+        std::replace(imageName.begin(), imageName.end(), '\\', '/');
+        imageName.erase(0, imageName.find_first_not_of("./"));
+        std::replace(imageName.begin(), imageName.end(), '/', '_');
+    } else {
+        const std::string& path = source.getName();
+        imageName = path.substr(path.find_last_of("/\\") + 1);
+    }
+    
+    size_t lastDot = imageName.find_last_of(".");
+    return (lastDot != std::string::npos) ? imageName.substr(0, lastDot) : imageName;
+}
+
+// Build "<outdir>/<image stem>_results" for every input image. A stem that
+// is already taken, e.g. the same file name from two globbed directories,
+// gets a "_2", "_3", ... suffix so no image overwrites another's outputs.
+std::vector<std::string> BatchProcessor::outputBasesFor(const std::vector<ImageSource>& sources) const {
+    std::vector<std::string> bases(sources.size());
+    if (outputDirectory.empty()) {
+        return bases;
+    }
+    
+    std::string directory = outputDirectory;
+    if (directory.back() != '/' && directory.back() != '\\') {
+        directory += "/";
+    }
+    
+    std::set<std::string> taken;
+    for (size_t i = 0; i < sources.size(); i++) {
+        std::string stem = outputStemFor(sources[i]);
+        std::string unique = stem;
+        for (int suffix = 2; !taken.insert(unique).second; suffix++) {
+            unique = stem + "_" + std::to_string(suffix);
+        }
+        if (unique != stem) {
+            LOG_INFO << "Output name " << stem << " is taken, writing " << sources[i].getName()
+                     << " as " << unique;
+        }
+        bases[i] = directory + unique + "_results";
+    }
+    return bases;
+}
+
+// Process all image files on the worker pool
+BatchSummary BatchProcessor::run(const std::vector<std::string>& imagePaths) {
+    return run(ImageSource::fromFiles(imagePaths));
+}
+
+// Process all images on the worker pool
+BatchSummary BatchProcessor::run(const std::vector<ImageSource>& sources) {
+    if (decoderCount > 0) {
+        return runPipelined(sources);
+    }
+    
+    BatchSummary summary;
+    summary.results.resize(sources.size());
+    const std::vector<std::string> outputBases = outputBasesFor(sources);
+    
+    int threads = std::max(1, std::min(workerCount, static_cast<int>(sources.size())));
+    
+    // OpenCV's own thread pool would compete with ours; with several workers
+    // each image runs single-threaded and parallelism comes from the pool.
+    int previousCvThreads = cv::getNumThreads();
+    if (threads > 1) {
+        cv::setNumThreads(1);
+    }
+    
+    LOG_INFO << "Batch processing " << sources.size() << " images with "
+             << threads << " worker thread(s)";
+    
+    std::atomic<size_t> nextIndex(0);
+    std::atomic<int> completed(0);
+    
+    auto startTime = std::chrono::steady_clock::now();
+    
+    auto workerLoop = [&](int workerIndex) {
+        // One trace lane per worker
+        StageTrace::instance().setThreadName("worker " + std::to_string(workerIndex));
+        
+        CoinWorker worker(options, coinDatabase);
+        
+        for (;;) {
+            size_t index = nextIndex.fetch_add(1);
+            if (index >= sources.size()) {
+                break;
+            }
+            
+            // OpenCV reports bad input by throwing; that fails this image, not the batch
+            const ImageSource& source = sources[index];
+            try {
+                summary.results[index] = worker.process(source, outputBases[index]);
+            } catch (const std::exception& e) {
+                summary.results[index] = ImageResult();
+                summary.results[index].imagePath = source.getName();
+                summary.results[index].error = e.what();
+            }
+            
+            int done = ++completed;
+            logProgress(done, sources.size(), source.getName(), summary.results[index]);
+        }
+    };
+    
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (int i = 0; i < threads; i++) {
+        pool.emplace_back(workerLoop, i);
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    
+    auto endTime = std::chrono::steady_clock::now();
+    summary.elapsedSeconds = std::chrono::duration<double>(endTime - startTime).count();
+    
+    cv::setNumThreads(previousCvThreads);
+    
+    aggregate(summary);
+    return summary;
+}
+
+// Decoded image on its way from a decoder to a compute worker
+struct DecodedImage {
+    size_t index;
+    int decodeScale;
+    cv::Mat image;
+    std::string error;  // Set when the decoder threw
+};
+
+// Rendered outputs on their way from a compute worker to a writer
+struct PendingOutput {
+    size_t index;
+    RenderedOutput output;
+};
+
+// Process all images with separate decode, compute and write stages
+BatchSummary BatchProcessor::runPipelined(const std::vector<ImageSource>& sources) {
+    BatchSummary summary;
+    summary.results.resize(sources.size());
+    const std::vector<std::string> outputBases = outputBasesFor(sources);
+    
+    const int images = static_cast<int>(sources.size());
+    int computeThreads = std::max(1, std::min(workerCount, images));
+    int decodeThreads = std::max(1, std::min(decoderCount, images));
+    int writeThreads = outputDirectory.empty() ? 0 : std::max(1, std::min(writerCount, images));
+    
+    int previousCvThreads = cv::getNumThreads();
+    if (computeThreads > 1) {
+        cv::setNumThreads(1);
+    }
+    
+    LOG_INFO << "Pipelined batch processing " << sources.size() << " images with "
+             << decodeThreads << " decoder, " << computeThreads << " compute and "
+             << writeThreads << " writer thread(s), queue depth " << queueDepth;
+    
+    // Decoders need the catalogue to pick a reduced decode, so the workers share theirs
+    std::shared_ptr<CoinDatabase> database = coinDatabase;
+    if (!database) {
+        database = std::make_shared<CoinDatabase>(options.configPath);
+    }
+    
+    BoundedQueue<DecodedImage> decoded(queueDepth);
+    BoundedQueue<PendingOutput> rendered(queueDepth);
+    
+    std::atomic<size_t> nextIndex(0);
+    std::atomic<int> activeDecoders(decodeThreads);
+    std::atomic<int> activeWorkers(computeThreads);
+    std::atomic<int> completed(0);
+    
+    auto startTime = std::chrono::steady_clock::now();
+    
+    // Decoders take images in input order; a failed read still goes through
+    // the queue so the compute stage records the error
+    auto decoderLoop = [&](int decoderIndex) {
+        StageTrace::instance().setThreadName("decoder " + std::to_string(decoderIndex));
+        for (;;) {
+            size_t index = nextIndex.fetch_add(1);
+            if (index >= sources.size()) {
+                break;
+            }
+            DecodedImage item;
+            item.index = index;
+            item.decodeScale = CoinWorker::chooseDecodeScale(options, database->snapshot()->smallestDiameter());
+            try {
+                ScopedTimer timer("loadImage");
+                item.image = sources[index].decode(BinaryMaskEstimator::decodeFlags(item.decodeScale));
+            } catch (const std::exception& e) {
+                item.error = e.what();
+            }
+            if (!decoded.push(std::move(item))) {
+                break;
+            }
+        }
+        if (--activeDecoders == 0) {
+            decoded.close();
+        }
+    };
+    
+    auto workerLoop = [&](int workerIndex) {
+        StageTrace::instance().setThreadName("worker " + std::to_string(workerIndex));
+        
+        CoinWorker worker(options, database);
+        
+        DecodedImage item;
+        while (decoded.pop(item)) {
+            const std::string& path = sources[item.index].getName();
+            ImageResult& result = summary.results[item.index];
+            PendingOutput pending;
+            bool render = false;
+            // A throw fails this image, not the batch
+            if (!item.error.empty()) {
+                result.imagePath = path;
+                result.error = item.error;
+            } else {
+                try {
+                    result = worker.processDecoded(item.image, path, item.decodeScale);
+                    if (result.success && writeThreads > 0) {
+                        pending.index = item.index;
+                        worker.renderOutputs(outputBases[item.index], pending.output);
+                        render = true;
+                    }
+                } catch (const std::exception& e) {
+                    result = ImageResult();
+                    result.imagePath = path;
+                    result.error = e.what();
+                }
+            }
+            item.image.release();
+            item.error.clear();
+            
+            if (render) {
+                rendered.push(std::move(pending));
+            }
+            
+            logProgress(++completed, sources.size(), path, result);
+        }
+        
+        if (--activeWorkers == 0) {
+            rendered.close();
+        }
+    };
+    
+    auto writerLoop = [&](int writerIndex) {
+        StageTrace::instance().setThreadName("writer " + std::to_string(writerIndex));
+        PendingOutput pending;
+        while (rendered.pop(pending)) {
+            ScopedTimer timer("saveResults");
+            const RenderedOutput& output = pending.output;
+            try {
+                if (!cv::imwrite(output.annotatedPath, output.annotated)) {
+                    std::cerr << "Error: Could not save annotated image to " << output.annotatedPath << std::endl;
+                }
+                if (!cv::imwrite(output.maskPath, output.mask)) {
+                    std::cerr << "Error: Could not save binary mask to " << output.maskPath << std::endl;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Could not save results for " << output.annotatedPath << ": " << e.what() << std::endl;
+            }
+            pending = PendingOutput();
+        }
+    };
+    
+    std::vector<std::thread> pool;
+    pool.reserve(decodeThreads + computeThreads + writeThreads);
+    for (int i = 0; i < decodeThreads; i++) {
+        pool.emplace_back(decoderLoop, i);
+    }
+    for (int i = 0; i < computeThreads; i++) {
+        pool.emplace_back(workerLoop, i);
+    }
+    for (int i = 0; i < writeThreads; i++) {
+        pool.emplace_back(writerLoop, i);
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    
+    auto endTime = std::chrono::steady_clock::now();
+    summary.elapsedSeconds = std::chrono::duration<double>(endTime - startTime).count();
+    
+    cv::setNumThreads(previousCvThreads);
+    
+    summary.queues.push_back({"decode -> compute", decoded.stats()});
+    if (writeThreads > 0) {
+        summary.queues.push_back({"compute -> write", rendered.stats()});
+    }
+    
+    aggregate(summary);
+    return summary;
+}
+
+// Progress line, built in this thread's log buffer and written in one piece
+void BatchProcessor::logProgress(int done, size_t total, const std::string& path, const ImageResult& result) const {
+    if (!Logger::isEnabled(LogLevel::INFO)) {
+        return;
+    }
+    LogMessage message;
+    std::ostream& line = message.stream();
+    line << "[" << done << "/" << total << "] " << path << ": ";
+    if (result.success) {
+        line << result.objectCount << " objects";
+        if (options.enableCoins) {
+            line << ", " << CoinRegistry::formatTotals(result.totalByCurrency);
+        }
+    } else {
+        line << "FAILED (" << result.error << ")";
+    }
+}
+
+// Sum the per-image results in input order so totals don't depend on scheduling.
+// Coins are matched by key, so images classified before and after a catalogue
+// reload add up; a renamed coin is reported under its newest name.
+void BatchProcessor::aggregate(BatchSummary& summary) {
+    for (const auto& result : summary.results) {
+        if (!result.success) {
+            summary.imagesFailed++;
+            continue;
+        }
+        
+        summary.imagesProcessed++;
+        summary.totalObjects += result.objectCount;
+        for (const auto& total : result.totalByCurrency) {
+            summary.totalByCurrency[total.first] += total.second;
+        }
+        for (const auto& pair : result.coinCounts) {
+            summary.coinCounts[pair.first] += pair.second;
+        }
+        for (const auto& pair : result.coinNames) {
+            summary.coinNames[pair.first] = pair.second;
+        }
+    }
+}
+
+// Collect all image files directly inside a directory
+std::vector<std::string> BatchProcessor::collectFromDirectory(const std::string& directory) {
+    std::vector<std::string> entries;
+    cv::glob(directory, entries, false);
+    
+    std::vector<std::string> images;
+    for (const auto& entry : entries) {
+        if (isImageFile(entry)) {
+            images.push_back(entry);
+        }
+    }
+    
+    std::sort(images.begin(), images.end());
+    return images;
+}
+
+// Collect the image members of a tar archive, in archive order
+std::vector<ImageSource> BatchProcessor::collectFromTar(const std::string& tarPath) {
+    std::vector<ImageSource> members;
+    std::vector<ImageSource> images;
+    if (!ImageSource::listTar(tarPath, members)) {
+        return images;
+    }
+    
+    for (const auto& member : members) {
+        if (isImageFile(member.getName())) {
+            images.push_back(member);
+        }
+    }
+    return images;
+}
+
+// Collect image files matching a wildcard pattern such as "resources/*.jpg"
+std::vector<std::string> BatchProcessor::collectFromGlob(const std::string& pattern) {
+    std::vector<std::string> entries;
+    cv::glob(pattern, entries, false);
+    
+    std::sort(entries.begin(), entries.end());
+    return entries;
+}
+
+// Read one image path per line; empty lines and lines starting with # are skipped
+std::vector<std::string> BatchProcessor::collectFromManifest(const std::string& manifestPath) {
+    std::vector<std::string> images;
+    
+    std::ifstream file(manifestPath);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open manifest file: " << manifestPath << std::endl;
+        return images;
+    }
+    
+    std::string line;
+    while (std::getline(file, line)) {
+        // Trim trailing whitespace (including Windows line endings)
+        line.erase(line.find_last_not_of(" \t\r\n") + 1);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        images.push_back(line);
+    }
+    
+    return images;
+}
+
+// Check the file extension against the formats OpenCV can decode
+bool BatchProcessor::isImageFile(const std::string& path) {
+    size_t lastDot = path.find_last_of(".");
+    if (lastDot == std::string::npos) {
+        return false;
+    }
+    
+    std::string ext = path.substr(lastDot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    
+    return ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp" ||
+           ext == "tif" || ext == "tiff" || ext == "webp";
+}
+
+// Print aggregate results of a batch run
+void BatchProcessor::printSummary(const BatchSummary& summary, bool showPerImage) {
+    std::cout << std::string(60, '=') << '\n';
+    std::cout << "BATCH RESULTS" << '\n';
+    std::cout << std::string(60, '=') << '\n';
+    
+    if (showPerImage) {
+        for (const auto& result : summary.results) {
+            std::cout << "  " << result.imagePath << ": ";
+            if (result.success) {
+                std::cout << result.objectCount << " objects";
+                if (!result.coinCounts.empty()) {
+                    std::cout << ", " << CoinRegistry::formatTotals(result.totalByCurrency);
+                }
+                std::cout << '\n';
+            } else {
+                std::cout << "FAILED (" << result.error << ")" << '\n';
+            }
+        }
+        std::cout << std::string(60, '-') << '\n';
+    }
+    
+    std::cout << "Images processed: " << summary.imagesProcessed << '\n';
+    std::cout << "Images failed: " << summary.imagesFailed << '\n';
+    std::cout << "Total objects: " << summary.totalObjects << '\n';
+    
+    if (!summary.coinCounts.empty()) {
+        int coins = 0;
+        for (const auto& pair : summary.coinCounts) {
+            coins += pair.second;
+        }
+        std::cout << ObjectCounter::generateCoinSummaryText(coins, summary.totalByCurrency) << '\n';
+        std::cout << "Coin breakdown:" << '\n';
+        for (const auto& pair : summary.coinCounts) {
+            if (pair.second == 0) {
+                continue;
+            }
+            auto nameIt = summary.coinNames.find(pair.first);
+            std::string name = (nameIt != summary.coinNames.end()) ? nameIt->second : "Unknown";
+            std::cout << "  " << name << ": " << pair.second << '\n';
+        }
+        if (summary.totalByCurrency.empty()) {
+            std::cout << "Total value: " << CoinRegistry::formatValue(0.0, "") << '\n';
+        }
+        for (const auto& total : summary.totalByCurrency) {
+            std::cout << "Total value: " << CoinRegistry::formatValue(total.second, total.first) << '\n';
+        }
+    }
+    
+    std::cout << "Elapsed: " << std::fixed << std::setprecision(2) << summary.elapsedSeconds << " s";
+    if (summary.elapsedSeconds > 0) {
+        int total = summary.imagesProcessed + summary.imagesFailed;
+        std::cout << " (" << std::setprecision(2) << total / summary.elapsedSeconds << " images/s)";
+    }
+    std::cout << '\n';
+    
+    // Where the pipeline waited: producers blocked on a full queue mean the
+    // next stage is the bottleneck, consumers blocked on an empty one the previous
+    for (const auto& queue : summary.queues) {
+        const BoundedQueueStats& stats = queue.stats;
+        std::cout << "Queue " << queue.name << ": depth mean " << std::fixed << std::setprecision(1)
+                  << stats.meanDepth << ", max " << stats.highWater << "/" << stats.capacity
+                  << ", producers waited " << std::setprecision(0) << stats.pushWaitMs << " ms"
+                  << ", consumers waited " << stats.popWaitMs << " ms" << '\n';
+    }
+    std::cout << std::string(60, '=') << '\n';
+}
@@ -1,10 +1,34 @@
 #include "binaryMaskEstimator.hh"
+#include "componentLabeling.hh"
+#include "boxThreshold.hh"
+#include "stageTimer.hh"
+#include "logger.hh"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 #include <opencv2/opencv.hpp>
 
+// Per-core cache budget the automatic tile size aims for
+static const int kTileCacheBudgetBytes = 1 << 20;
+
+// Halo needed by the 5x5 preprocessing blur
+static const int kPreprocessHalo = 2;
+
+// Default smallest filled area, in full-resolution pixels, a component needs to be kept
+static const int kMinComponentArea = 100;
+
+// CLAHE tile grid over the full frame
+static const int kClaheGrid = 8;
+
+// Shortest image edge the coarsest pyramid level may have
+static const int kMinPyramidEdge = 64;
+
 // Constructor
 BinaryMaskEstimator::BinaryMaskEstimator() 
-    : blockSize(11), C(2.0), morphKernelSize(5), morphIterations(2) 
+    : runLengthOutput(false), blockSize(11), C(2.0), thresholdMethod(ThresholdMethod::GAUSSIAN),
+      morphKernelSize(5), morphIterations(2), morphShape(MorphShape::ELLIPSE),
+      fastPreprocessing(false), tiledExecution(false), tileSize(0), pyramidLevels(0),
+      minComponentArea(kMinComponentArea)
 {
     //magical values that I just found by playing with the program
     setAdaptiveThresholdParams(21, 10.0);
@@ -17,19 +41,38 @@ BinaryMaskEstimator::~BinaryMaskEstimator() {
 }
 
 // Load image from file path
-bool BinaryMaskEstimator::loadImage(const std::string& imagePath) {
-    inputImage = cv::imread(imagePath, cv::IMREAD_COLOR);
+bool BinaryMaskEstimator::loadImage(const std::string& imagePath, int decodeScale) {
+    return loadImage(ImageSource::fromFile(imagePath), decodeScale);
+}
+
+// Load image from a mapped file or archive member
+bool BinaryMaskEstimator::loadImage(const ImageSource& source, int decodeScale) {
+    inputImage = source.decode(decodeFlags(decodeScale));
     
     if (inputImage.empty()) {
-        std::cerr << "Error: Could not load image from " << imagePath << std::endl;
+        std::cerr << "Error: Could not load image from " << source.getName() << std::endl;
         return false;
     }
     
-    std::cout << "Image loaded successfully: " << imagePath << std::endl;
+    LOG_DEBUG << "Image loaded successfully: " << source.getName();
     showImageInfo(inputImage, "Input Image");
     return true;
 }
 
+// Decode flags for a reduced-size read
+int BinaryMaskEstimator::decodeFlags(int decodeScale) {
+    switch (decodeScale) {
+        case 2:
+            return cv::IMREAD_REDUCED_COLOR_2;
+        case 4:
+            return cv::IMREAD_REDUCED_COLOR_4;
+        case 8:
+            return cv::IMREAD_REDUCED_COLOR_8;
+        default:
+            return cv::IMREAD_COLOR;
+    }
+}
+
 // Load image from cv::Mat
 bool BinaryMaskEstimator::loadImage(const cv::Mat& image) {
     if (image.empty()) {
@@ -38,67 +81,194 @@ bool BinaryMaskEstimator::loadImage(const cv::Mat& image) {
     }
     
     inputImage = image.clone();
-    std::cout << "Image loaded successfully from cv::Mat" << std::endl;
+    LOG_DEBUG << "Image loaded successfully from cv::Mat";
+    showImageInfo(inputImage, "Input Image");
+    return true;
+}
+
+// Share an existing cv::Mat without copying it
+bool BinaryMaskEstimator::adoptImage(const cv::Mat& image) {
+    if (image.empty()) {
+        std::cerr << "Error: Input image is empty" << std::endl;
+        return false;
+    }
+    
+    inputImage = image;
+    LOG_DEBUG << "Image adopted from cv::Mat (shared, not copied)";
     showImageInfo(inputImage, "Input Image");
     return true;
 }
 
 // Main method to estimate binary mask
 cv::Mat BinaryMaskEstimator::estimateBinaryMask() {
+    return estimateBinaryMaskShared().clone();
+}
+
+// Estimate the binary mask and return the estimator's own copy of it
+const cv::Mat& BinaryMaskEstimator::estimateBinaryMaskShared() {
+    ScopedTimer timer("estimateBinaryMask");
+    
+    // Drop our references first so this run never overwrites a mask that a
+    // previous caller is still holding on to
+    binaryMask.release();
+    componentLabels.release();
+    componentStats.release();
+    componentCentroids.release();
+    runMask.clear();
+    runLabels.clear();
+    
     if (inputImage.empty()) {
         std::cerr << "Error: No input image loaded" << std::endl;
-        return cv::Mat();
+        return binaryMask;
     }
     
-    cv::Mat processedImage = inputImage.clone();
+    if (runLengthOutput) {
+        estimateRunLength();
+        
+        LOG_DEBUG << "Binary mask estimation completed (" << runMask.runCount() << " runs)";
+        return binaryMask;
+    }
     
-    // Step 1: Preprocess the image
-    preprocessImage(processedImage);
+    // Write into a pooled buffer; the one handed out for the previous image
+    // is skipped for as long as someone still holds it
+    binaryMask = context.acquireMask(inputImage.size());
     
-    // Step 2: Convert to grayscale if needed
-    cv::Mat grayImage;
-    if (processedImage.channels() == 3) {
-        cv::cvtColor(processedImage, grayImage, cv::COLOR_BGR2GRAY);
-    } else {
-        grayImage = processedImage.clone();
+    int levels = effectivePyramidLevels();
+    if (levels > 0) {
+        estimatePyramid(binaryMask, levels);
+        
+        LOG_DEBUG << "Binary mask estimation completed (pyramid, " << levels << " levels)";
+        return binaryMask;
+    }
+    
+    if (tiledExecution) {
+        estimateTiled(binaryMask);
+        removeSmallComponents(binaryMask, minComponentArea);
+        
+        LOG_DEBUG << "Binary mask estimation completed (tiled)";
+        return binaryMask;
     }
     
+    // Steps 1-2: Preprocess the image (the input is left untouched) and reduce it to grayscale
+    computeLuminance(inputImage, context.gray);
+    
     // Step 3: Apply adaptive thresholding
-    applyAdaptiveThreshold(grayImage, binaryMask);
+    applyAdaptiveThreshold(context.gray, binaryMask);
     
     // Step 4: Apply morphological operations
     applyMorphologicalOperations(binaryMask);
     
     // Step 5: Remove small components
-    removeSmallComponents(binaryMask, 100);
+    removeSmallComponents(binaryMask, minComponentArea);
     
-    std::cout << "Binary mask estimation completed" << std::endl;
-    return binaryMask.clone();
+    LOG_DEBUG << "Binary mask estimation completed";
+    return binaryMask;
+}
+
+// Run-length pipeline. The full-frame path goes from the morphology bits
+// straight to runs; the tiled and pyramid paths stitch a plane, which is
+// encoded once they are done.
+void BinaryMaskEstimator::estimateRunLength() {
+    cv::Mat& mask = context.thresholdMask;
+    
+    int levels = effectivePyramidLevels();
+    if (levels > 0 || tiledExecution) {
+        if (levels > 0) {
+            estimatePyramid(mask, levels);
+            componentLabels.release();
+        } else {
+            estimateTiled(mask);
+        }
+        context.rawRuns.encode(mask);
+    } else {
+        computeLuminance(inputImage, context.gray);
+        applyAdaptiveThreshold(context.gray, mask);
+        
+        {
+            ScopedTimer timer("morphology");
+            context.maskBits.pack(mask);
+            applyMorphologicalOperations(context.maskBits, context.morphBits, context.morphology,
+                                         context.decomposedMorphology);
+        }
+        context.rawRuns.encode(context.maskBits);
+    }
+    
+    ScopedTimer timer("components");
+    ComponentLabeler::labelRuns(context.rawRuns, minComponentArea, runMask, runLabels,
+                                componentStats, componentCentroids, &context.runLabeling);
+}
+
+// True once an estimate has produced a mask in either representation
+bool BinaryMaskEstimator::hasMask() const {
+    return !binaryMask.empty() || !runMask.empty();
 }
 
-// Preprocess the input image
-void BinaryMaskEstimator::preprocessImage(cv::Mat& image) {
+// Produce the grayscale plane that the adaptive threshold runs on
+void BinaryMaskEstimator::computeLuminance(const cv::Mat& source, cv::Mat& gray,
+                                           const cv::Size& claheGrid) {
+    ScopedTimer timer("preprocess");
+    
+    if (fastPreprocessing) {
+        preprocessLuminance(source, gray, claheGrid);
+        return;
+    }
+    
+    preprocessImage(source, context.blurred, claheGrid);
+    
+    if (context.blurred.channels() == 3) {
+        cv::cvtColor(context.blurred, gray, cv::COLOR_BGR2GRAY);
+    } else {
+        context.blurred.copyTo(gray);
+    }
+}
+
+// Preprocess the input image into a separate buffer
+void BinaryMaskEstimator::preprocessImage(const cv::Mat& source, cv::Mat& image,
+                                          const cv::Size& claheGrid) {
     // Apply Gaussian blur to reduce noise
-    cv::GaussianBlur(image, image, cv::Size(5, 5), 0);
+    cv::GaussianBlur(source, image, cv::Size(5, 5), 0);
     
     // Enhance contrast using CLAHE if it's a color image
     if (image.channels() == 3) {
-        cv::Mat lab;
+        cv::Mat& lab = context.lab;
+        std::vector<cv::Mat>& labChannels = context.labChannels;
         cv::cvtColor(image, lab, cv::COLOR_BGR2Lab);
-        
-        std::vector<cv::Mat> labChannels;
         cv::split(lab, labChannels);
         
-        cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(2.0, cv::Size(8, 8));
-        clahe->apply(labChannels[0], labChannels[0]);
+        {
+            ScopedTimer timer("clahe");
+            context.clahe(claheGrid)->apply(labChannels[0], labChannels[0]);
+        }
         
         cv::merge(labChannels, lab);
         cv::cvtColor(lab, image, cv::COLOR_Lab2BGR);
     }
 }
 
+// Fused preprocessing: one color conversion, then blur and CLAHE on a single plane.
+// Grayscale conversion is linear, so blurring after it gives the same plane as
+// blurring every channel first; CLAHE on gray stands in for CLAHE on Lab L.
+void BinaryMaskEstimator::preprocessLuminance(const cv::Mat& source, cv::Mat& luminance,
+                                              const cv::Size& claheGrid) {
+    if (source.channels() == 1) {
+        cv::GaussianBlur(source, luminance, cv::Size(5, 5), 0);
+        return;
+    }
+    
+    cv::cvtColor(source, luminance, cv::COLOR_BGR2GRAY);
+    cv::GaussianBlur(luminance, luminance, cv::Size(5, 5), 0);
+    
+    ScopedTimer timer("clahe");
+    context.clahe(claheGrid)->apply(luminance, luminance);
+}
+
 // Apply adaptive thresholding
 void BinaryMaskEstimator::applyAdaptiveThreshold(const cv::Mat& grayImage, cv::Mat& mask) {
+    ScopedTimer timer("threshold");
+    if (thresholdMethod == ThresholdMethod::INTEGRAL) {
+        BoxThreshold::applyInverse(grayImage, mask, blockSize, C);
+        return;
+    }
     cv::adaptiveThreshold(grayImage, mask, 255, 
                          cv::ADAPTIVE_THRESH_GAUSSIAN_C, 
                          cv::THRESH_BINARY_INV, blockSize, C);
@@ -106,34 +276,369 @@ void BinaryMaskEstimator::applyAdaptiveThreshold(const cv::Mat& grayImage, cv::M
 
 // Apply morphological operations to clean up the mask
 void BinaryMaskEstimator::applyMorphologicalOperations(cv::Mat& mask) {
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, 
-                                               cv::Size(morphKernelSize, morphKernelSize));
+    applyMorphologicalOperations(mask, context.maskBits, context.morphBits, context.morphology,
+                                 context.decomposedMorphology);
+}
+
+// Close then open on the bit-packed mask. The result is identical to running
+// cv::dilate / cv::erode on the 0/255 plane, with an eighth of the memory traffic.
+void BinaryMaskEstimator::applyMorphologicalOperations(cv::Mat& mask, BitMask& bits, BitMask& scratch,
+                                                       BitMorphology& morphology,
+                                                       DecomposedMorphology& decomposed) {
+    ScopedTimer timer("morphology");
+    bits.pack(mask);
+    applyMorphologicalOperations(bits, scratch, morphology, decomposed);
+    bits.unpack(mask);
+}
+
+// Close then open, in place on the bits
+void BinaryMaskEstimator::applyMorphologicalOperations(BitMask& bits, BitMask& scratch,
+                                                       BitMorphology& morphology,
+                                                       DecomposedMorphology& decomposed) {
+    if (morphShape != MorphShape::ELLIPSE) {
+        // The iterations collapse into one element of the combined radius
+        int radius = morphIterations * (morphKernelSize / 2);
+        if (morphShape == MorphShape::RECT) {
+            decomposed.setSquare(radius);
+        } else {
+            decomposed.setOctagon(radius);
+        }
+        
+        decomposed.dilate(bits, scratch);
+        decomposed.erode(scratch, bits);
+        decomposed.erode(bits, scratch);
+        decomposed.dilate(scratch, bits);
+        return;
+    }
+    
+    morphology.setKernel(context.structuringElement(morphKernelSize));
     
     // Close small gaps
-    cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, kernel, cv::Point(-1, -1), morphIterations);
+    morphology.dilate(bits, scratch, morphIterations);
+    morphology.erode(scratch, bits, morphIterations);
     
     // Open to remove small noise
-    cv::morphologyEx(mask, mask, cv::MORPH_OPEN, kernel, cv::Point(-1, -1), morphIterations);
+    morphology.erode(bits, scratch, morphIterations);
+    morphology.dilate(scratch, bits, morphIterations);
 }
 
-// Remove small connected components
+// Remove small connected components. One labeling pass over the mask (plus one
+// over its background to find holes) replaces tracing and filling every contour;
+// the surviving components are kept for the object counter.
 void BinaryMaskEstimator::removeSmallComponents(cv::Mat& mask, int minArea) {
-    std::vector<std::vector<cv::Point>> contours;
-    std::vector<cv::Vec4i> hierarchy;
+    ScopedTimer timer("components");
+    componentLabels = context.acquireLabels(mask.size());
+    ComponentLabeler::labelFilled(mask, minArea, componentLabels, componentStats,
+                                  componentCentroids, &mask, &context.labeling);
+}
+
+// Rows/columns of context a tile needs so threshold + morphology are exact in its core
+int BinaryMaskEstimator::thresholdMorphologyHalo() const {
+    // Each dilate/erode pass reaches kernelSize/2 pixels; close and open each
+    // run morphIterations dilations and erosions
+    int morphRadius = morphKernelSize / 2;
+    return blockSize / 2 + 4 * morphIterations * morphRadius;
+}
+
+// Pick a core tile edge so that one tile with its halo stays within the cache budget
+int BinaryMaskEstimator::chooseTileSize(int halo, int bytesPerPixel) const {
+    if (tileSize > 0) {
+        return tileSize;
+    }
+    
+    int outerEdge = static_cast<int>(std::sqrt(static_cast<double>(kTileCacheBudgetBytes) / bytesPerPixel));
+    int coreEdge = outerEdge - 2 * halo;
+    
+    // Very large halos would leave tiny cores that are mostly overhead
+    return std::max(coreEdge, std::max(128, 2 * halo));
+}
+
+// Cover the image with non-overlapping core tiles
+std::vector<cv::Rect> BinaryMaskEstimator::makeTiles(const cv::Size& imageSize, int coreSize) {
+    std::vector<cv::Rect> tiles;
+    for (int y = 0; y < imageSize.height; y += coreSize) {
+        for (int x = 0; x < imageSize.width; x += coreSize) {
+            tiles.push_back(cv::Rect(x, y,
+                                     std::min(coreSize, imageSize.width - x),
+                                     std::min(coreSize, imageSize.height - y)));
+        }
+    }
+    return tiles;
+}
+
+// Tiled version of steps 1-4. Pointwise and local stages run per tile in
+// parallel; CLAHE needs statistics of the whole plane, so it runs once on the
+// full luminance plane between the two tiled passes.
+void BinaryMaskEstimator::estimateTiled(cv::Mat& mask) {
+    const cv::Rect imageRect(0, 0, inputImage.cols, inputImage.rows);
+    const bool color = inputImage.channels() == 3;
+    const bool labRoundTrip = color && !fastPreprocessing;
+    
+    // Pass 1: blur + color conversion, producing either the gray plane (fused
+    // path, grayscale input) or the full Lab image (legacy path)
+    cv::Mat plane(inputImage.size(), labRoundTrip ? CV_8UC3 : CV_8UC1);
+    std::vector<cv::Rect> preTiles = makeTiles(inputImage.size(),
+                                               chooseTileSize(kPreprocessHalo, labRoundTrip ? 9 : 4));
+    
+    cv::parallel_for_(cv::Range(0, static_cast<int>(preTiles.size())), [&](const cv::Range& range) {
+        ScopedTimer timer("tilePreprocess");
+        for (int t = range.start; t < range.end; t++) {
+            const cv::Rect& core = preTiles[t];
+            cv::Rect outer = cv::Rect(core.x - kPreprocessHalo, core.y - kPreprocessHalo,
+                                      core.width + 2 * kPreprocessHalo,
+                                      core.height + 2 * kPreprocessHalo) & imageRect;
+            cv::Rect inner(core.x - outer.x, core.y - outer.y, core.width, core.height);
+            
+            cv::Mat tile;
+            if (labRoundTrip) {
+                cv::Mat blurred;
+                cv::GaussianBlur(inputImage(outer), blurred, cv::Size(5, 5), 0);
+                cv::cvtColor(blurred, tile, cv::COLOR_BGR2Lab);
+            } else {
+                if (color) {
+                    cv::cvtColor(inputImage(outer), tile, cv::COLOR_BGR2GRAY);
+                } else {
+                    tile = inputImage(outer).clone();
+                }
+                cv::GaussianBlur(tile, tile, cv::Size(5, 5), 0);
+            }
+            
+            cv::Mat destination = plane(core);
+            tile(inner).copyTo(destination);
+        }
+    });
+    
+    // Global step: CLAHE on the lightness / gray plane
+    cv::Mat lightness;
+    if (color) {
+        if (labRoundTrip) {
+            cv::extractChannel(plane, lightness, 0);
+        } else {
+            lightness = plane;
+        }
+        
+        ScopedTimer timer("clahe");
+        context.clahe()->apply(lightness, lightness);
+    }
+    
+    // Pass 2: back to gray (legacy path), adaptive threshold and morphology
+    const int halo = thresholdMorphologyHalo();
+    mask.create(inputImage.size(), CV_8UC1);
+    context.structuringElement(morphKernelSize);  // Build it before the tiles share it
+    std::vector<cv::Rect> tiles = makeTiles(inputImage.size(),
+                                            chooseTileSize(halo, labRoundTrip ? 9 : 4));
+    
+    cv::parallel_for_(cv::Range(0, static_cast<int>(tiles.size())), [&](const cv::Range& range) {
+        for (int t = range.start; t < range.end; t++) {
+            const cv::Rect& core = tiles[t];
+            cv::Rect outer = cv::Rect(core.x - halo, core.y - halo,
+                                      core.width + 2 * halo, core.height + 2 * halo) & imageRect;
+            cv::Rect inner(core.x - outer.x, core.y - outer.y, core.width, core.height);
+            
+            cv::Mat grayTile;
+            if (labRoundTrip) {
+                cv::Mat labTile = plane(outer).clone();
+                cv::insertChannel(lightness(outer), labTile, 0);
+                
+                cv::Mat bgrTile;
+                cv::cvtColor(labTile, bgrTile, cv::COLOR_Lab2BGR);
+                cv::cvtColor(bgrTile, grayTile, cv::COLOR_BGR2GRAY);
+            } else {
+                grayTile = plane(outer);
+            }
+            
+            cv::Mat maskTile;
+            BitMask tileBits, tileScratch;
+            BitMorphology tileMorphology;
+            DecomposedMorphology tileDecomposed;
+            applyAdaptiveThreshold(grayTile, maskTile);
+            applyMorphologicalOperations(maskTile, tileBits, tileScratch, tileMorphology, tileDecomposed);
+            
+            cv::Mat destination = mask(core);
+            maskTile(inner).copyTo(destination);
+        }
+    });
+}
+
+// Pyramid levels that keep the coarsest image at least kMinPyramidEdge pixels on its short side
+int BinaryMaskEstimator::effectivePyramidLevels() const {
+    int shortEdge = std::min(inputImage.cols, inputImage.rows);
+    int levels = pyramidLevels;
+    while (levels > 0 && (shortEdge >> levels) < kMinPyramidEdge) {
+        levels--;
+    }
+    return levels;
+}
+
+// Coarse-to-fine version of steps 1-5. Only the windows around the coarse
+// candidates are segmented at full resolution; everything else stays background.
+void BinaryMaskEstimator::estimatePyramid(cv::Mat& mask, int levels) {
+    detectCoarse(levels);
+    
+    ScopedTimer timer("pyramidRefine");
+    
+    // The run-length path passes its scratch plane, which may still have the
+    // previous image's size (or none); the windows write into it by row pointer
+    mask.create(inputImage.size(), CV_8UC1);
+    mask.setTo(0);
+    componentLabels = context.acquireLabels(inputImage.size());
+    componentLabels.setTo(0);
     
-    cv::findContours(mask, contours, hierarchy, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    const cv::Rect imageRect(0, 0, inputImage.cols, inputImage.rows);
+    const cv::Mat& coarseStats = context.pyramidStats;
+    const double scaleX = static_cast<double>(inputImage.cols) / context.pyramidMask.cols;
+    const double scaleY = static_cast<double>(inputImage.rows) / context.pyramidMask.rows;
+    
+    // Downsampling can move a boundary by up to a coarse pixel or two
+    const int margin = 2 << levels;
+    
+    // Row 0 (the background) is filled in once the foreground area is known
+    std::vector<int> statsData(5, 0);
+    std::vector<double> centroidData(2, 0.0);
+    for (int c = 1; c < coarseStats.rows; c++) {
+        int left = static_cast<int>(std::floor(coarseStats.at<int>(c, cv::CC_STAT_LEFT) * scaleX));
+        int top = static_cast<int>(std::floor(coarseStats.at<int>(c, cv::CC_STAT_TOP) * scaleY));
+        int right = static_cast<int>(std::ceil((coarseStats.at<int>(c, cv::CC_STAT_LEFT) +
+                                                coarseStats.at<int>(c, cv::CC_STAT_WIDTH)) * scaleX));
+        int bottom = static_cast<int>(std::ceil((coarseStats.at<int>(c, cv::CC_STAT_TOP) +
+                                                 coarseStats.at<int>(c, cv::CC_STAT_HEIGHT)) * scaleY));
+        cv::Rect region = cv::Rect(left - margin, top - margin,
+                                   right - left + 2 * margin, bottom - top + 2 * margin) & imageRect;
+        
+        refineWindow(region, c, mask, statsData, centroidData);
+    }
+    
+    const int nextLabel = static_cast<int>(statsData.size() / 5);
+    long long foregroundArea = 0;
+    for (int id = 1; id < nextLabel; id++) {
+        foregroundArea += statsData[5 * id + cv::CC_STAT_AREA];
+    }
+    statsData[cv::CC_STAT_WIDTH] = inputImage.cols;
+    statsData[cv::CC_STAT_HEIGHT] = inputImage.rows;
+    statsData[cv::CC_STAT_AREA] = static_cast<int>(static_cast<long long>(imageRect.area()) - foregroundArea);
+    
+    componentStats = cv::Mat(nextLabel, 5, CV_32S, statsData.data()).clone();
+    componentCentroids = cv::Mat(nextLabel, 2, CV_64F, centroidData.data()).clone();
+}
+
+// Steps 1-5 on the downscaled image, with the spatial parameters shrunk to match
+void BinaryMaskEstimator::detectCoarse(int levels) {
+    const int scale = 1 << levels;
+    
+    {
+        ScopedTimer timer("pyramidDown");
+        cv::resize(inputImage, context.pyramidImage, cv::Size(), 1.0 / scale, 1.0 / scale, cv::INTER_AREA);
+    }
+    
+    const int fullBlockSize = blockSize;
+    const int fullKernelSize = morphKernelSize;
+    blockSize = std::max(3, (blockSize / scale) | 1);
+    morphKernelSize = std::max(1, (morphKernelSize + scale / 2) / scale);
+    
+    computeLuminance(context.pyramidImage, context.gray);
+    applyAdaptiveThreshold(context.gray, context.pyramidMask);
+    applyMorphologicalOperations(context.pyramidMask);
+    
+    blockSize = fullBlockSize;
+    morphKernelSize = fullKernelSize;
+    
+    ScopedTimer timer("components");
+    ComponentLabeler::labelFilled(context.pyramidMask, std::max(1, minComponentArea / (scale * scale)),
+                                  context.pyramidLabels, context.pyramidStats, context.pyramidCentroids,
+                                  nullptr, &context.labeling);
+}
+
+// Segment one candidate window at full resolution and copy the components that
+// belong to the coarse candidate into the output. A full-resolution component
+// belongs to it when at least half of its pixels fall inside the upscaled coarse
+// component; one that an earlier window already wrote is skipped, so a blob the
+// coarse level split in two is still reported once. Output labels are numbered
+// in the order their statistics rows are appended.
+void BinaryMaskEstimator::refineWindow(const cv::Rect& region, int coarseLabel, cv::Mat& mask,
+                                       std::vector<int>& statsData, std::vector<double>& centroidData) {
+    const cv::Rect imageRect(0, 0, inputImage.cols, inputImage.rows);
+    const int halo = kPreprocessHalo + thresholdMorphologyHalo();
+    cv::Rect outer = cv::Rect(region.x - halo, region.y - halo,
+                              region.width + 2 * halo, region.height + 2 * halo) & imageRect;
+    cv::Rect inner(region.x - outer.x, region.y - outer.y, region.width, region.height);
+    
+    // Same pipeline as the full frame. CLAHE gets tiles of the size they have
+    // over the whole image, so the window is not contrast-stretched harder.
+    auto gridCells = [](int windowEdge, int imageEdge) {
+        return std::max(1, std::min(kClaheGrid, cvRound(static_cast<double>(kClaheGrid) * windowEdge / imageEdge)));
+    };
+    cv::Size claheGrid(gridCells(outer.width, inputImage.cols), gridCells(outer.height, inputImage.rows));
+    computeLuminance(inputImage(outer), context.windowGray, claheGrid);
+    applyAdaptiveThreshold(context.windowGray, context.windowMask);
+    applyMorphologicalOperations(context.windowMask);
+    
+    int count = ComponentLabeler::labelFilled(context.windowMask(inner), minComponentArea,
+                                              context.windowLabels, context.windowStats,
+                                              context.windowCentroids, nullptr, &context.labeling);
+    if (count < 2) {
+        return;
+    }
     
-    // Create a new mask with only large components
-    cv::Mat cleanMask = cv::Mat::zeros(mask.size(), mask.type());
+    const cv::Mat& coarseLabels = context.pyramidLabels;
+    const double coarseX = static_cast<double>(coarseLabels.cols) / inputImage.cols;
+    const double coarseY = static_cast<double>(coarseLabels.rows) / inputImage.rows;
     
-    for (size_t i = 0; i < contours.size(); i++) {
-        double area = cv::contourArea(contours[i]);
-        if (area >= minArea) {
-            cv::fillPoly(cleanMask, std::vector<std::vector<cv::Point>>{contours[i]}, cv::Scalar(255));
+    std::vector<int> coarseColumn(region.width);
+    for (int x = 0; x < region.width; x++) {
+        coarseColumn[x] = std::min(coarseLabels.cols - 1, static_cast<int>((region.x + x) * coarseX));
+    }
+    
+    std::vector<int> overlap(count, 0);
+    std::vector<unsigned char> written(count, 0);
+    for (int y = 0; y < region.height; y++) {
+        const int* windowRow = context.windowLabels.ptr<int>(y);
+        const int* coarseRow = coarseLabels.ptr<int>(std::min(coarseLabels.rows - 1,
+                                                              static_cast<int>((region.y + y) * coarseY)));
+        const int* outputRow = componentLabels.ptr<int>(region.y + y) + region.x;
+        for (int x = 0; x < region.width; x++) {
+            int label = windowRow[x];
+            if (label) {
+                overlap[label] += coarseRow[coarseColumn[x]] == coarseLabel;
+                written[label] |= outputRow[x] != 0;
+            }
+        }
+    }
+    
+    std::vector<int> outputLabel(count, 0);
+    int nextLabel = static_cast<int>(statsData.size() / 5);
+    bool any = false;
+    for (int label = 1; label < count; label++) {
+        int area = context.windowStats.at<int>(label, cv::CC_STAT_AREA);
+        if (written[label] || 2 * overlap[label] < area) {
+            continue;
         }
+        
+        outputLabel[label] = nextLabel++;
+        statsData.push_back(region.x + context.windowStats.at<int>(label, cv::CC_STAT_LEFT));
+        statsData.push_back(region.y + context.windowStats.at<int>(label, cv::CC_STAT_TOP));
+        statsData.push_back(context.windowStats.at<int>(label, cv::CC_STAT_WIDTH));
+        statsData.push_back(context.windowStats.at<int>(label, cv::CC_STAT_HEIGHT));
+        statsData.push_back(area);
+        centroidData.push_back(region.x + context.windowCentroids.at<double>(label, 0));
+        centroidData.push_back(region.y + context.windowCentroids.at<double>(label, 1));
+        any = true;
+    }
+    if (!any) {
+        return;
     }
     
-    mask = cleanMask;
+    for (int y = 0; y < region.height; y++) {
+        const int* windowRow = context.windowLabels.ptr<int>(y);
+        int* outputRow = componentLabels.ptr<int>(region.y + y) + region.x;
+        uchar* maskRow = mask.ptr<uchar>(region.y + y) + region.x;
+        for (int x = 0; x < region.width; x++) {
+            int label = outputLabel[windowRow[x]];
+            if (label) {
+                outputRow[x] = label;
+                maskRow[x] = 255;
+            }
+        }
+    }
 }
 
 // Set adaptive threshold parameters
@@ -142,12 +647,76 @@ void BinaryMaskEstimator::setAdaptiveThresholdParams(int blockSize, double C) {
     this->C = C;
 }
 
+// Select the local mean used by the adaptive threshold
+void BinaryMaskEstimator::setThresholdMethod(ThresholdMethod method) {
+    this->thresholdMethod = method;
+}
+
+ThresholdMethod BinaryMaskEstimator::getThresholdMethod() const {
+    return thresholdMethod;
+}
+
 // Set morphological operation parameters
 void BinaryMaskEstimator::setMorphologicalParams(int kernelSize, int iterations) {
     this->morphKernelSize = kernelSize;
     this->morphIterations = iterations;
 }
 
+// Select the structuring element of the cleanup
+void BinaryMaskEstimator::setMorphShape(MorphShape shape) {
+    this->morphShape = shape;
+}
+
+MorphShape BinaryMaskEstimator::getMorphShape() const {
+    return morphShape;
+}
+
+// Enable/disable the fused preprocessing path
+void BinaryMaskEstimator::setFastPreprocessing(bool enable) {
+    this->fastPreprocessing = enable;
+}
+
+bool BinaryMaskEstimator::isFastPreprocessing() const {
+    return fastPreprocessing;
+}
+
+// Enable/disable tiled execution
+void BinaryMaskEstimator::setTiledExecution(bool enable, int tileSize) {
+    this->tiledExecution = enable;
+    this->tileSize = std::max(0, tileSize);
+}
+
+bool BinaryMaskEstimator::isTiledExecution() const {
+    return tiledExecution;
+}
+
+// Set the number of pyramid levels for coarse-to-fine estimation
+void BinaryMaskEstimator::setPyramidLevels(int levels) {
+    this->pyramidLevels = std::max(0, levels);
+}
+
+int BinaryMaskEstimator::getPyramidLevels() const {
+    return pyramidLevels;
+}
+
+// Enable/disable the run-length mask output
+void BinaryMaskEstimator::setRunLengthOutput(bool enable) {
+    this->runLengthOutput = enable;
+}
+
+bool BinaryMaskEstimator::isRunLengthOutput() const {
+    return runLengthOutput;
+}
+
+// Set the smallest component area kept in the mask
+void BinaryMaskEstimator::setMinComponentArea(int area) {
+    this->minComponentArea = std::max(1, area);
+}
+
+int BinaryMaskEstimator::getMinComponentArea() const {
+    return minComponentArea;
+}
+
 // Save image to file
 void BinaryMaskEstimator::saveImage(const std::string& outputPath, const cv::Mat& image) {
     if (image.empty()) {
@@ -157,7 +726,7 @@ void BinaryMaskEstimator::saveImage(const std::string& outputPath, const cv::Mat
     
     bool success = cv::imwrite(outputPath, image);
     if (success) {
-        std::cout << "Image saved successfully: " << outputPath << std::endl;
+        LOG_INFO << "Image saved successfully: " << outputPath;
     } else {
         std::cerr << "Error: Could not save image to " << outputPath << std::endl;
     }
@@ -165,12 +734,12 @@ void BinaryMaskEstimator::saveImage(const std::string& outputPath, const cv::Mat
 
 // Display original and binary mask images
 void BinaryMaskEstimator::displayImages(const std::string& windowName) {
-    if (inputImage.empty() || binaryMask.empty()) {
+    if (inputImage.empty() || !hasMask()) {
         std::cerr << "Error: Images not ready for display" << std::endl;
         return;
     }
     
-    cv::Mat combined = combineImages(inputImage, binaryMask);
+    cv::Mat combined = combineImages(inputImage, getBinaryMask());
     
     cv::imshow(windowName, combined);
     std::cout << "Press any key to close the display window..." << std::endl;
@@ -183,10 +752,45 @@ cv::Mat BinaryMaskEstimator::getInputImage() const {
     return inputImage.clone();
 }
 
+// In run-length mode the runs are painted into a new plane
 cv::Mat BinaryMaskEstimator::getBinaryMask() const {
+    if (binaryMask.empty() && !runMask.empty()) {
+        cv::Mat painted;
+        runMask.paint(painted);
+        return painted;
+    }
     return binaryMask.clone();
 }
 
+// Non-copying getters; the returned buffers are shared with the estimator
+const cv::Mat& BinaryMaskEstimator::getInputImageRef() const {
+    return inputImage;
+}
+
+const cv::Mat& BinaryMaskEstimator::getBinaryMaskRef() const {
+    return binaryMask;
+}
+
+const cv::Mat& BinaryMaskEstimator::getComponentLabelsRef() const {
+    return componentLabels;
+}
+
+const RunLengthMask& BinaryMaskEstimator::getRunMaskRef() const {
+    return runMask;
+}
+
+const std::vector<int>& BinaryMaskEstimator::getRunLabelsRef() const {
+    return runLabels;
+}
+
+const cv::Mat& BinaryMaskEstimator::getComponentStatsRef() const {
+    return componentStats;
+}
+
+const cv::Mat& BinaryMaskEstimator::getComponentCentroidsRef() const {
+    return componentCentroids;
+}
+
 // Static method to combine two images side by side
 cv::Mat BinaryMaskEstimator::combineImages(const cv::Mat& img1, const cv::Mat& img2) {
     cv::Mat combined;
@@ -218,8 +822,56 @@ cv::Mat BinaryMaskEstimator::combineImages(const cv::Mat& img1, const cv::Mat& i
 
 // Static method to show image information
 void BinaryMaskEstimator::showImageInfo(const cv::Mat& image, const std::string& imageName) {
-    std::cout << imageName << " Info:" << std::endl;
-    std::cout << "  Size: " << image.cols << "x" << image.rows << std::endl;
-    std::cout << "  Channels: " << image.channels() << std::endl;
-    std::cout << "  Type: " << image.type() << std::endl << std::endl;
+    LOG_DEBUG << imageName << " Info:\n"
+              << "  Size: " << image.cols << "x" << image.rows << "\n"
+              << "  Channels: " << image.channels() << "\n"
+              << "  Type: " << image.type() << "\n";
+}
+
+// Map a command-line name to a threshold method
+bool BinaryMaskEstimator::parseThresholdMethod(const std::string& name, ThresholdMethod& method) {
+    if (name == "gaussian") {
+        method = ThresholdMethod::GAUSSIAN;
+    } else if (name == "integral") {
+        method = ThresholdMethod::INTEGRAL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Check a block size before it reaches the threshold stage
+bool BinaryMaskEstimator::isValidBlockSize(int blockSize) {
+    return blockSize >= 3 && blockSize <= BoxThreshold::kMaxBlockSize;
+}
+
+// Command-line name of a threshold method
+const char* BinaryMaskEstimator::thresholdMethodName(ThresholdMethod method) {
+    return method == ThresholdMethod::INTEGRAL ? "integral" : "gaussian";
+}
+
+// Map a command-line name to a morphology shape
+bool BinaryMaskEstimator::parseMorphShape(const std::string& name, MorphShape& shape) {
+    if (name == "ellipse") {
+        shape = MorphShape::ELLIPSE;
+    } else if (name == "rect") {
+        shape = MorphShape::RECT;
+    } else if (name == "octagon") {
+        shape = MorphShape::OCTAGON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Command-line name of a morphology shape
+const char* BinaryMaskEstimator::morphShapeName(MorphShape shape) {
+    switch (shape) {
+        case MorphShape::RECT:
+            return "rect";
+        case MorphShape::OCTAGON:
+            return "octagon";
+        default:
+            return "ellipse";
+    }
 }
@@ -0,0 +1,259 @@
+#include "bitMask.hh"
+#include <algorithm>
+
+static const int kWordBits = 64;
+
+// Constructor
+BitMask::BitMask()
+    : rowCount(0), colCount(0), words(0)
+{
+}
+
+// Size the mask, keeping the allocation when it is large enough
+void BitMask::create(int rows, int cols) {
+    rowCount = rows;
+    colCount = cols;
+    words = (cols + kWordBits - 1) / kWordBits;
+    data.resize(static_cast<size_t>(rows) * words);
+}
+
+int BitMask::rows() const {
+    return rowCount;
+}
+
+int BitMask::cols() const {
+    return colCount;
+}
+
+int BitMask::wordsPerRow() const {
+    return words;
+}
+
+bool BitMask::empty() const {
+    return rowCount == 0 || colCount == 0;
+}
+
+uint64_t* BitMask::row(int y) {
+    return data.data() + static_cast<size_t>(y) * words;
+}
+
+const uint64_t* BitMask::row(int y) const {
+    return data.data() + static_cast<size_t>(y) * words;
+}
+
+// Valid bits of the last word; the rest is padding past the last column
+uint64_t BitMask::lastWordMask() const {
+    int used = colCount - (words - 1) * kWordBits;
+    return used >= kWordBits ? ~0ULL : ((1ULL << used) - 1);
+}
+
+// Pack a CV_8UC1 mask, one bit per pixel
+void BitMask::pack(const cv::Mat& mask) {
+    CV_Assert(mask.type() == CV_8UC1);
+    create(mask.rows, mask.cols);
+    
+    for (int y = 0; y < rowCount; y++) {
+        const uchar* in = mask.ptr<uchar>(y);
+        uint64_t* out = row(y);
+        
+        for (int j = 0; j < words; j++) {
+            const uchar* pixels = in + j * kWordBits;
+            int count = std::min(kWordBits, colCount - j * kWordBits);
+            uint64_t word = 0;
+            for (int i = 0; i < count; i++) {
+                word |= static_cast<uint64_t>(pixels[i] != 0) << i;
+            }
+            out[j] = word;
+        }
+    }
+}
+
+// Expand to a 0/255 CV_8UC1 mask
+void BitMask::unpack(cv::Mat& mask) const {
+    mask.create(rowCount, colCount, CV_8UC1);
+    
+    for (int y = 0; y < rowCount; y++) {
+        const uint64_t* in = row(y);
+        uchar* out = mask.ptr<uchar>(y);
+        for (int x = 0; x < colCount; x++) {
+            out[x] = ((in[x / kWordBits] >> (x % kWordBits)) & 1) ? 255 : 0;
+        }
+    }
+}
+
+// Word m of a row as a shift sees it: words outside the row, and the padding
+// of the last word, read as fill (0 for dilation, all ones for erosion)
+static inline uint64_t wordAt(const uint64_t* row, int m, int words, uint64_t fill, uint64_t padding) {
+    if (m < 0 || m >= words) {
+        return fill;
+    }
+    return m == words - 1 ? (row[m] | padding) : row[m];
+}
+
+// Combine out(x) with in(x + k) for every pixel of a row
+template <typename Combine>
+static void shiftRow(const uint64_t* in, uint64_t* out, int words, int k,
+                     uint64_t fill, uint64_t padding, Combine combine) {
+    int q = k >= 0 ? k / kWordBits : -((-k + kWordBits - 1) / kWordBits);
+    int r = k - q * kWordBits;
+    
+    for (int j = 0; j < words; j++) {
+        uint64_t value = wordAt(in, j + q, words, fill, padding) >> r;
+        if (r != 0) {
+            value |= wordAt(in, j + q + 1, words, fill, padding) << (kWordBits - r);
+        }
+        out[j] = combine(out[j], value);
+    }
+}
+
+// Take the row spans of a structuring element
+void BitMorphology::setKernel(const cv::Mat& kernel) {
+    CV_Assert(kernel.type() == CV_8UC1 && !kernel.empty());
+    const int anchorX = kernel.cols / 2;
+    const int anchorY = kernel.rows / 2;
+    
+    spans.clear();
+    kernelRows.clear();
+    for (int y = 0; y < kernel.rows; y++) {
+        const uchar* values = kernel.ptr<uchar>(y);
+        int first = 0;
+        while (first < kernel.cols && !values[first]) {
+            first++;
+        }
+        if (first == kernel.cols) {
+            continue;
+        }
+        int last = kernel.cols - 1;
+        while (!values[last]) {
+            last--;
+        }
+        for (int x = first; x <= last; x++) {
+            CV_Assert(values[x] != 0);  // One span per kernel row
+        }
+        
+        Span span = {first - anchorX, last - anchorX};
+        KernelRow kernelRow = {y - anchorY, -1};
+        for (size_t s = 0; s < spans.size(); s++) {
+            if (spans[s].left == span.left && spans[s].right == span.right) {
+                kernelRow.span = static_cast<int>(s);
+            }
+        }
+        if (kernelRow.span < 0) {
+            kernelRow.span = static_cast<int>(spans.size());
+            spans.push_back(span);
+        }
+        kernelRows.push_back(kernelRow);
+    }
+    
+    // Narrowest first, so each horizontal pass can usually extend the previous one
+    std::vector<int> order(spans.size());
+    for (size_t s = 0; s < order.size(); s++) {
+        order[s] = static_cast<int>(s);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return spans[a].right - spans[a].left < spans[b].right - spans[b].left;
+    });
+    std::vector<Span> sorted(spans.size());
+    std::vector<int> newIndex(spans.size());
+    for (size_t s = 0; s < order.size(); s++) {
+        sorted[s] = spans[order[s]];
+        newIndex[order[s]] = static_cast<int>(s);
+    }
+    spans.swap(sorted);
+    for (auto& kernelRow : kernelRows) {
+        kernelRow.span = newIndex[kernelRow.span];
+    }
+    
+    horizontal.resize(spans.size());
+}
+
+// Dilate with the current kernel
+void BitMorphology::dilate(const BitMask& src, BitMask& dst, int iterations) {
+    apply(src, dst, iterations, false);
+}
+
+// Erode with the current kernel
+void BitMorphology::erode(const BitMask& src, BitMask& dst, int iterations) {
+    apply(src, dst, iterations, true);
+}
+
+// Repeat one pass, as cv::erode / cv::dilate do for several iterations
+void BitMorphology::apply(const BitMask& src, BitMask& dst, int iterations, bool erode) {
+    applyOnce(src, dst, erode);
+    for (int i = 1; i < iterations; i++) {
+        applyOnce(dst, dst, erode);
+    }
+}
+
+// One erosion or dilation: pixels outside the image count as set for erosion
+// and as clear for dilation, like OpenCV's default morphology border
+void BitMorphology::applyOnce(const BitMask& src, BitMask& dst, bool erode) {
+    const int rows = src.rows();
+    const int words = src.wordsPerRow();
+    const uint64_t lastMask = src.lastWordMask();
+    const uint64_t fill = erode ? ~0ULL : 0ULL;
+    const uint64_t padding = fill & ~lastMask;
+    
+    auto combineOr = [](uint64_t a, uint64_t b) { return a | b; };
+    auto combineAnd = [](uint64_t a, uint64_t b) { return a & b; };
+    auto combineSet = [](uint64_t, uint64_t b) { return b; };
+    
+    // Horizontal passes, one per distinct span
+    for (size_t s = 0; s < spans.size(); s++) {
+        const Span& span = spans[s];
+        horizontal[s].create(rows, src.cols());
+        
+        // Extend the previous span's result when this span contains it
+        const bool extend = s > 0 && span.left <= spans[s - 1].left && span.right >= spans[s - 1].right;
+        const int coveredLeft = extend ? spans[s - 1].left : span.left;
+        const int coveredRight = extend ? spans[s - 1].right : span.left;
+        
+        for (int y = 0; y < rows; y++) {
+            const uint64_t* in = src.row(y);
+            uint64_t* out = horizontal[s].row(y);
+            
+            if (extend) {
+                std::copy(horizontal[s - 1].row(y), horizontal[s - 1].row(y) + words, out);
+            } else {
+                shiftRow(in, out, words, span.left, fill, padding, combineSet);
+            }
+            
+            for (int k = span.left; k <= span.right; k++) {
+                if (k >= coveredLeft && k <= coveredRight) {
+                    continue;
+                }
+                if (erode) {
+                    shiftRow(in, out, words, k, fill, padding, combineAnd);
+                } else {
+                    shiftRow(in, out, words, k, fill, padding, combineOr);
+                }
+            }
+        }
+    }
+    
+    // Vertical pass: one horizontal result per kernel row
+    dst.create(rows, src.cols());
+    for (int y = 0; y < rows; y++) {
+        uint64_t* out = dst.row(y);
+        std::fill(out, out + words, fill);
+        
+        for (const auto& kernelRow : kernelRows) {
+            int sourceY = y + kernelRow.dy;
+            if (sourceY < 0 || sourceY >= rows) {
+                continue;  // Outside the image: neutral for both operations
+            }
+            const uint64_t* in = horizontal[kernelRow.span].row(sourceY);
+            if (erode) {
+                for (int j = 0; j < words; j++) {
+                    out[j] &= in[j];
+                }
+            } else {
+                for (int j = 0; j < words; j++) {
+                    out[j] |= in[j];
+                }
+            }
+        }
+        
+        out[words - 1] &= lastMask;
+    }
+}
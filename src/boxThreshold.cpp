@@ -0,0 +1,89 @@
+#include "boxThreshold.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Rows per stripe, relative to the block size, below which restarting the
+// column sums for every stripe costs more than the parallelism gains
+static const int kMinStripeBlocks = 4;
+
+// Threshold a mask against running box means
+void BoxThreshold::applyInverse(const cv::Mat& src, cv::Mat& dst, int blockSize, double C) {
+    CV_Assert(src.type() == CV_8UC1);
+    CV_Assert(blockSize % 2 == 1 && blockSize > 1 && blockSize <= kMaxBlockSize);
+    
+    // Rows are read again after the rows above them are written
+    cv::Mat source = (src.data == dst.data) ? src.clone() : src;
+    dst.create(source.size(), CV_8UC1);
+    
+    const int width = source.cols;
+    const int height = source.rows;
+    const int radius = blockSize / 2;
+    const int64_t area = static_cast<int64_t>(blockSize) * blockSize;
+    
+    // cv::adaptiveThreshold rounds C down for THRESH_BINARY_INV and compares
+    // against the mean rounded to the nearest integer:
+    //   src + delta <= round(sum / area)  <=>  2 * (src + delta) * area <= 2 * sum + area
+    // Past +-256 every pixel compares the same way, so C is clamped there
+    // before the conversion, and the comparison is made in 64 bits.
+    const int delta = static_cast<int>(std::floor(std::min(std::max(C, -256.0), 256.0)));
+    
+    int stripes = std::max(1, std::min(cv::getNumThreads() * 4, height / (kMinStripeBlocks * blockSize)));
+    
+    cv::parallel_for_(cv::Range(0, height), [&](const cv::Range& rows) {
+        std::vector<int> columnSum(width, 0);
+        // Row prefix sums may wrap; the box sums taken from them are exact
+        // since they fit in 32 bits
+        std::vector<uint32_t> prefix(width + blockSize, 0);
+        
+        auto clampRow = [height](int y) {
+            return std::min(std::max(y, 0), height - 1);
+        };
+        
+        // Column sums of the window around the stripe's first row
+        for (int dy = -radius; dy <= radius; dy++) {
+            const uchar* row = source.ptr<uchar>(clampRow(rows.start + dy));
+            for (int x = 0; x < width; x++) {
+                columnSum[x] += row[x];
+            }
+        }
+        
+        for (int y = rows.start; y < rows.end; y++) {
+            // Slide the window down one row
+            if (y > rows.start) {
+                const uchar* entering = source.ptr<uchar>(clampRow(y + radius));
+                const uchar* leaving = source.ptr<uchar>(clampRow(y - radius - 1));
+                int* sums = columnSum.data();
+                for (int x = 0; x < width; x++) {
+                    sums[x] += entering[x] - leaving[x];
+                }
+            }
+            
+            // Prefix sums along the row, with the edge columns replicated
+            uint32_t running = 0;
+            for (int i = 0; i < radius; i++) {
+                running += columnSum[0];
+                prefix[i + 1] = running;
+            }
+            for (int x = 0; x < width; x++) {
+                running += columnSum[x];
+                prefix[radius + x + 1] = running;
+            }
+            for (int i = 0; i < radius; i++) {
+                running += columnSum[width - 1];
+                prefix[radius + width + i + 1] = running;
+            }
+            
+            // Box sum at x is prefix[x + blockSize] - prefix[x]
+            const uchar* in = source.ptr<uchar>(y);
+            uchar* out = dst.ptr<uchar>(y);
+            const uint32_t* lower = prefix.data();
+            const uint32_t* upper = prefix.data() + blockSize;
+            for (int x = 0; x < width; x++) {
+                int64_t sum = upper[x] - lower[x];
+                out[x] = (2 * (in[x] + delta) * area <= 2 * sum + area) ? 255 : 0;
+            }
+        }
+    }, stripes);
+}
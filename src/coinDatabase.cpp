@@ -0,0 +1,171 @@
+#include "coinDatabase.hh"
+#include "logger.hh"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sys/stat.h>
+
+// Constructor: load the catalogue, falling back to the built-in coins
+CoinDatabase::CoinDatabase(const std::string& aConfigPaths)
+    : configPaths(aConfigPaths), version(0), watching(false)
+{
+    std::stringstream ss(configPaths);
+    std::string path;
+    while (std::getline(ss, path, ',')) {
+        path.erase(0, path.find_first_not_of(" \t"));
+        path.erase(path.find_last_not_of(" \t") + 1);
+        if (!path.empty()) {
+            files.push_back(path);
+        }
+    }
+    
+    if (!reload()) {
+        LOG_INFO << "Config file not found or invalid, using default coin specifications.";
+        std::shared_ptr<CoinRegistry> defaults = std::make_shared<CoinRegistry>();
+        defaults->loadDefaults();
+        std::atomic_store(&current, std::shared_ptr<const CoinRegistry>(defaults));
+    }
+}
+
+// Destructor
+CoinDatabase::~CoinDatabase() {
+    stopWatching();
+}
+
+// Current catalogue
+std::shared_ptr<const CoinRegistry> CoinDatabase::snapshot() const {
+    return std::atomic_load(&current);
+}
+
+// Build a new catalogue from the config files and swap it in
+bool CoinDatabase::reload() {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    
+    // Every listed file must load, so a file caught in the middle of being
+    // replaced doesn't leave its coins out of the new catalogue
+    std::shared_ptr<CoinRegistry> registry = std::make_shared<CoinRegistry>();
+    std::string error;
+    bool valid = true;
+    for (const auto& file : files) {
+        if (!registry->loadFromFile(file, false)) {
+            error = "could not load " + file;
+            valid = false;
+            break;
+        }
+    }
+    if (valid) {
+        valid = validate(*registry, error);
+    }
+    if (!valid) {
+        // On the first load the constructor falls back to the defaults instead
+        if (std::atomic_load(&current)) {
+            std::cerr << "Error: Coin config reload rejected (" << error
+                      << "); keeping the current catalogue" << std::endl;
+        }
+        return false;
+    }
+    
+    std::atomic_store(&current, std::shared_ptr<const CoinRegistry>(registry));
+    uint64_t newVersion = ++version;
+    LOG_INFO << "Coin catalogue v" << newVersion << " loaded from " << configPaths
+             << " (" << registry->size() << " coin types)";
+    return true;
+}
+
+// Number of successful reloads so far
+uint64_t CoinDatabase::getVersion() const {
+    return version.load();
+}
+
+const std::string& CoinDatabase::getConfigPaths() const {
+    return configPaths;
+}
+
+// A usable catalogue has at least one coin, and sizes and values that make sense
+bool CoinDatabase::validate(const CoinRegistry& registry, std::string& error) {
+    if (registry.empty()) {
+        error = "no coins";
+        return false;
+    }
+    
+    for (const CoinInfo& coin : registry.getCoins()) {
+        if (coin.type == UNKNOWN_COIN) {
+            continue;  // Reserved slot
+        }
+        if (!(coin.diameter_mm > 0.0) || !std::isfinite(coin.diameter_mm)) {
+            error = "invalid diameter for " + coin.key;
+            return false;
+        }
+        if (!(coin.value >= 0.0) || !std::isfinite(coin.value)) {
+            error = "invalid value for " + coin.key;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Modification time and size of every config file ("missing" when absent)
+std::vector<std::string> CoinDatabase::fileSignatures() const {
+    std::vector<std::string> signatures;
+    for (const auto& file : files) {
+        struct stat info;
+        if (stat(file.c_str(), &info) != 0) {
+            signatures.push_back("missing");
+            continue;
+        }
+        std::ostringstream signature;
+        signature << info.st_mtime << ":" << info.st_size;
+        signatures.push_back(signature.str());
+    }
+    return signatures;
+}
+
+// Start the polling thread
+void CoinDatabase::startWatching(int intervalMs) {
+    stopWatching();
+    {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        watching = true;
+    }
+    watcher = std::thread(&CoinDatabase::watchLoop, this, std::max(intervalMs, 1));
+    LOG_INFO << "Watching " << configPaths << " for changes every " << intervalMs << " ms";
+}
+
+// Stop the polling thread
+void CoinDatabase::stopWatching() {
+    {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        watching = false;
+    }
+    watchWakeup.notify_all();
+    if (watcher.joinable()) {
+        watcher.join();
+    }
+}
+
+// Reload once the files changed and then stayed the same for one interval
+void CoinDatabase::watchLoop(int intervalMs) {
+    std::vector<std::string> loaded = fileSignatures();
+    std::vector<std::string> previous = loaded;
+    
+    std::unique_lock<std::mutex> lock(watchMutex);
+    while (watching) {
+        watchWakeup.wait_for(lock, std::chrono::milliseconds(intervalMs));
+        if (!watching) {
+            break;
+        }
+        lock.unlock();
+        
+        std::vector<std::string> signatures = fileSignatures();
+        if (signatures != loaded && signatures == previous) {
+            // A failed reload is retried only after the next change
+            reload();
+            loaded = signatures;
+        }
+        previous = signatures;
+        
+        lock.lock();
+    }
+}
@@ -0,0 +1,432 @@
+#include "coinRegistry.hh"
+#include "logger.hh"
+#include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Standard US coins, used when no config file can be loaded and to fill in
+// the face value of legacy config lines that only give a diameter
+struct DefaultCoin {
+    const char* key;
+    const char* name;
+    double diameter_mm;
+    int b, g, r;
+    double value;
+};
+
+const DefaultCoin kDefaultCoins[] = {
+    {"PENNY", "Penny", 19.05, 139, 69, 19, 0.01},
+    {"NICKEL", "Nickel", 21.21, 192, 192, 192, 0.05},
+    {"DIME", "Dime", 17.91, 211, 211, 211, 0.10},
+    {"QUARTER", "Quarter", 24.26, 169, 169, 169, 0.25},
+    {"HALF_DOLLAR", "Half Dollar", 30.61, 190, 190, 190, 0.50},
+    {"DOLLAR", "Dollar", 26.50, 200, 200, 150, 1.00},
+};
+
+const char* kDefaultCurrency = "USD";
+
+} // namespace
+
+// Constructor
+CoinRegistry::CoinRegistry() {
+    clear();
+}
+
+// Remove every denomination
+void CoinRegistry::clear() {
+    coins.clear();
+    keyIndex.clear();
+    nameIndex.clear();
+    sortedDiameters.clear();
+    sortedTypes.clear();
+    
+    CoinInfo unknown;
+    unknown.type = UNKNOWN_COIN;
+    unknown.key = "UNKNOWN";
+    unknown.name = "Unknown";
+    unknown.color = cv::Scalar(128, 128, 128);
+    coins.push_back(unknown);
+}
+
+// Add or replace a denomination, returning its id
+CoinType CoinRegistry::add(const CoinInfo& info) {
+    CoinType type = insert(info);
+    rebuildIndex();
+    return type;
+}
+
+// Add or replace a denomination without touching the diameter index
+CoinType CoinRegistry::insert(const CoinInfo& info) {
+    // Only the exact key identifies the coin to replace; a key that happens
+    // to equal another coin's display name adds a new coin
+    const std::string key = toLower(info.key);
+    auto existing = keyIndex.find(key);
+    if (existing == keyIndex.end()) {
+        CoinType type = static_cast<CoinType>(coins.size());
+        coins.push_back(info);
+        coins[type].type = type;
+        keyIndex[key] = type;
+        nameIndex.insert(std::make_pair(toLower(info.name), type));
+        return type;
+    }
+    
+    CoinType type = existing->second;
+    coins[type] = info;
+    coins[type].type = type;
+    // The old name may now belong to another coin, or to none
+    rebuildNameIndex();
+    return type;
+}
+
+// Map every display name to the first coin (in load order) that carries it
+void CoinRegistry::rebuildNameIndex() {
+    nameIndex.clear();
+    for (size_t i = 1; i < coins.size(); i++) {
+        nameIndex.insert(std::make_pair(toLower(coins[i].name), static_cast<CoinType>(i)));
+    }
+}
+
+// Sort the diameter index. Ties keep load order so results are deterministic.
+void CoinRegistry::rebuildIndex() {
+    std::vector<CoinType> order;
+    order.reserve(coins.size());
+    for (size_t i = 1; i < coins.size(); i++) {
+        order.push_back(static_cast<CoinType>(i));
+    }
+    std::stable_sort(order.begin(), order.end(), [this](CoinType a, CoinType b) {
+        return coins[a].diameter_mm < coins[b].diameter_mm;
+    });
+    
+    sortedTypes = order;
+    sortedDiameters.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        sortedDiameters[i] = coins[order[i]].diameter_mm;
+    }
+}
+
+// Load one config file and append its denominations
+bool CoinRegistry::loadFromFile(const std::string& configPath, bool verbose) {
+    std::ifstream file(configPath);
+    if (!file.is_open()) {
+        std::cerr << "Warning: Could not open coin config file: " << configPath << std::endl;
+        return false;
+    }
+    
+    if (verbose) {
+        LOG_INFO << "Loading coin configuration from: " << configPath;
+    }
+    
+    std::string line;
+    int lineNumber = 0;
+    int loaded = 0;
+    
+    while (std::getline(file, line)) {
+        lineNumber++;
+        
+        std::string trimmed = trim(line);
+        // Skip empty lines and comments
+        if (trimmed.empty() || trimmed[0] == '#' || trimmed[0] == ';') {
+            continue;
+        }
+        
+        CoinInfo info;
+        std::string error;
+        if (!parseLine(trimmed, info, error)) {
+            std::cerr << "Warning: " << error << " at line " << lineNumber
+                      << " in config file: " << configPath << std::endl;
+            continue;
+        }
+        
+        insert(info);
+        loaded++;
+        if (verbose) {
+            LOG_DEBUG << "  Loaded: " << info.name << " (diameter: " << info.diameter_mm
+                      << "mm, value: " << formatValue(info.value, info.currency) << ")";
+        }
+    }
+    
+    rebuildIndex();
+    
+    if (loaded == 0) {
+        std::cerr << "Error: No valid coin configurations loaded from file: " << configPath << std::endl;
+        return false;
+    }
+    
+    if (verbose) {
+        LOG_INFO << "Successfully loaded " << loaded << " coin configurations.";
+    }
+    return true;
+}
+
+// Load a comma-separated list of config files. Succeeds if any file loads.
+bool CoinRegistry::loadFromConfigList(const std::string& configPaths, bool verbose) {
+    std::stringstream ss(configPaths);
+    std::string path;
+    bool anyLoaded = false;
+    
+    while (std::getline(ss, path, ',')) {
+        path = trim(path);
+        if (path.empty()) continue;
+        if (loadFromFile(path, verbose)) {
+            anyLoaded = true;
+        }
+    }
+    
+    return anyLoaded;
+}
+
+// Load the built-in US coin specifications
+void CoinRegistry::loadDefaults(bool verbose) {
+    if (verbose) {
+        LOG_INFO << "Loading default US coin specifications...";
+    }
+    
+    for (const DefaultCoin& coin : kDefaultCoins) {
+        CoinInfo info;
+        info.key = coin.key;
+        info.name = coin.name;
+        info.diameter_mm = coin.diameter_mm;
+        info.color = cv::Scalar(coin.b, coin.g, coin.r);
+        info.value = coin.value;
+        info.currency = kDefaultCurrency;
+        insert(info);
+    }
+    rebuildIndex();
+    
+    if (verbose) {
+        LOG_INFO << "Default coin database initialized with " << size()
+                 << " coin types.";
+    }
+}
+
+// Parse KEY,NAME,DIAMETER_MM,COLOR_BGR[,VALUE[,CURRENCY]]
+bool CoinRegistry::parseLine(const std::string& line, CoinInfo& info, std::string& error) const {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ',')) {
+        fields.push_back(trim(field));
+    }
+    
+    if (fields.size() < 4 || fields[0].empty()) {
+        error = "Invalid format";
+        return false;
+    }
+    
+    info.key = fields[0];
+    info.name = fields[1].empty() ? fields[0] : fields[1];
+    
+    try {
+        info.diameter_mm = std::stod(fields[2]);
+    } catch (const std::exception& e) {
+        error = "Invalid diameter '" + fields[2] + "'";
+        return false;
+    }
+    if (info.diameter_mm <= 0) {
+        error = "Invalid diameter '" + fields[2] + "'";
+        return false;
+    }
+    
+    // Colors are normally B:G:R; the older B,G,R form spans three fields
+    size_t next = 4;
+    std::string colorStr = fields[3];
+    if (colorStr.find(':') == std::string::npos && fields.size() >= 6) {
+        colorStr = fields[3] + "," + fields[4] + "," + fields[5];
+        next = 6;
+    }
+    info.color = parseColor(colorStr);
+    
+    // Face value: explicit column, else the built-in US value for known keys
+    info.value = 0.0;
+    info.currency = kDefaultCurrency;
+    if (next < fields.size() && !fields[next].empty()) {
+        try {
+            info.value = std::stod(fields[next]);
+        } catch (const std::exception& e) {
+            error = "Invalid value '" + fields[next] + "'";
+            return false;
+        }
+    } else {
+        std::string lowerKey = toLower(info.key);
+        for (const DefaultCoin& coin : kDefaultCoins) {
+            if (toLower(coin.key) == lowerKey) {
+                info.value = coin.value;
+                break;
+            }
+        }
+    }
+    next++;
+    if (next < fields.size() && !fields[next].empty()) {
+        info.currency = fields[next];
+        std::transform(info.currency.begin(), info.currency.end(), info.currency.begin(), ::toupper);
+    }
+    
+    return true;
+}
+
+// Number of loaded denominations
+size_t CoinRegistry::size() const {
+    return coins.size() - 1;
+}
+
+// Check whether any denomination is loaded
+bool CoinRegistry::empty() const {
+    return size() == 0;
+}
+
+// Get a denomination by id, or nullptr when the id is not loaded
+const CoinInfo* CoinRegistry::find(CoinType type) const {
+    if (type <= UNKNOWN_COIN || type >= static_cast<CoinType>(coins.size())) {
+        return nullptr;
+    }
+    return &coins[type];
+}
+
+// Resolve a config key or, failing that, a display name, case-insensitively
+CoinType CoinRegistry::findByKey(const std::string& keyOrName) const {
+    const std::string lookup = toLower(trim(keyOrName));
+    auto it = keyIndex.find(lookup);
+    if (it != keyIndex.end()) {
+        return it->second;
+    }
+    it = nameIndex.find(lookup);
+    if (it != nameIndex.end()) {
+        return it->second;
+    }
+    return UNKNOWN_COIN;
+}
+
+// Diameter of the smallest denomination
+double CoinRegistry::smallestDiameter() const {
+    return sortedDiameters.empty() ? 0.0 : sortedDiameters.front();
+}
+
+// Find the denomination with the closest diameter with a binary search
+CoinType CoinRegistry::nearestByDiameter(double diameter_mm, double& difference) const {
+    difference = std::numeric_limits<double>::max();
+    if (sortedDiameters.empty()) {
+        return UNKNOWN_COIN;
+    }
+    
+    // Only the entries either side of the insertion point can be nearest
+    size_t upper = std::lower_bound(sortedDiameters.begin(), sortedDiameters.end(), diameter_mm) 
+                   - sortedDiameters.begin();
+    size_t best = upper;
+    if (upper == sortedDiameters.size()) {
+        best = upper - 1;
+    } else if (upper > 0) {
+        double below = diameter_mm - sortedDiameters[upper - 1];
+        double above = sortedDiameters[upper] - diameter_mm;
+        if (below <= above) {
+            // Step back to the first entry of a run of equal diameters
+            best = upper - 1;
+            while (best > 0 && sortedDiameters[best - 1] == sortedDiameters[best]) {
+                best--;
+            }
+        }
+    }
+    
+    difference = std::abs(diameter_mm - sortedDiameters[best]);
+    return sortedTypes[best];
+}
+
+// All denominations; slot 0 is the UNKNOWN_COIN placeholder
+const std::vector<CoinInfo>& CoinRegistry::getCoins() const {
+    return coins;
+}
+
+// Distinct currencies in the catalogue, sorted
+std::vector<std::string> CoinRegistry::getCurrencies() const {
+    std::set<std::string> currencies;
+    for (size_t i = 1; i < coins.size(); i++) {
+        currencies.insert(coins[i].currency);
+    }
+    return std::vector<std::string>(currencies.begin(), currencies.end());
+}
+
+// Parse a "B:G:R" or "B,G,R" color
+cv::Scalar CoinRegistry::parseColor(const std::string& colorStr) {
+    cv::Scalar defaultColor(128, 128, 128); // Gray default
+    
+    std::string str = colorStr;
+    char delimiter = ':';
+    if (str.find(',') != std::string::npos) {
+        delimiter = ',';
+    }
+    
+    std::stringstream ss(str);
+    std::string bStr, gStr, rStr;
+    
+    if (std::getline(ss, bStr, delimiter) &&
+        std::getline(ss, gStr, delimiter) &&
+        std::getline(ss, rStr)) {
+        
+        try {
+            int b = std::stoi(bStr);
+            int g = std::stoi(gStr);
+            int r = std::stoi(rStr);
+            
+            // Clamp values to valid range
+            b = std::max(0, std::min(255, b));
+            g = std::max(0, std::min(255, g));
+            r = std::max(0, std::min(255, r));
+            
+            return cv::Scalar(b, g, r);
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: Invalid color format '" << colorStr 
+                      << "', using default gray." << std::endl;
+        }
+    } else {
+        std::cerr << "Warning: Invalid color format '" << colorStr 
+                  << "', expected 'B:G:R' or 'B,G,R'." << std::endl;
+    }
+    
+    return defaultColor;
+}
+
+// Format a money amount: "$1.25" for USD, "1.25 EUR" otherwise
+std::string CoinRegistry::formatValue(double value, const std::string& currency) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    if (currency.empty() || currency == kDefaultCurrency) {
+        out << "$" << value;
+    } else {
+        out << value << " " << currency;
+    }
+    return out.str();
+}
+
+// Format per-currency totals: "$1.25 + 4.00 EUR", "$0.00" when there are none
+std::string CoinRegistry::formatTotals(const std::map<std::string, double>& totals) {
+    if (totals.empty()) {
+        return formatValue(0.0, "");
+    }
+    std::string text;
+    for (const auto& total : totals) {
+        if (!text.empty()) text += " + ";
+        text += formatValue(total.second, total.first);
+    }
+    return text;
+}
+
+// Lower-case copy of a string
+std::string CoinRegistry::toLower(const std::string& str) {
+    std::string lower = str;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    return lower;
+}
+
+// Copy of a string without leading and trailing whitespace
+std::string CoinRegistry::trim(const std::string& str) {
+    size_t first = str.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return "";
+    size_t last = str.find_last_not_of(" \t\r\n");
+    return str.substr(first, last - first + 1);
+}
@@ -0,0 +1,420 @@
+#include "coinServer.hh"
+#include "boxThreshold.hh"
+#include "stageTimer.hh"
+#include "logger.hh"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Largest header line and image a client may send
+static const size_t kMaxHeaderBytes = 4096;
+static const size_t kMaxImageBytes = 64 * 1024 * 1024;
+
+// Seconds a worker waits on a silent client before giving up on it
+static const int kClientTimeoutSeconds = 10;
+
+// Constructor
+CoinServer::CoinServer(const ProcessingOptions& aOptions, int aWorkerCount, size_t queueCapacity)
+    : options(aOptions), workerCount(aWorkerCount), listenSocket(-1), connections(queueCapacity),
+      stopping(false), previousCvThreads(0), served(0), failed(0), rejected(0)
+{
+    if (workerCount <= 0) {
+        workerCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    if (workerCount <= 0) {
+        workerCount = 1;
+    }
+}
+
+// Destructor
+CoinServer::~CoinServer() {
+    shutdown();
+}
+
+// Set the presets a request may refer to by name
+void CoinServer::setPresets(const std::map<std::string, double>& aPresets) {
+    presets = aPresets;
+}
+
+// Set the coin catalogue shared by the workers
+void CoinServer::setCoinDatabase(std::shared_ptr<CoinDatabase> database) {
+    coinDatabase = database;
+}
+
+// Open the listening socket and start the worker pool
+bool CoinServer::start(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Invalid socket path: " << path << std::endl;
+        return false;
+    }
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    
+    listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        std::cerr << "Error: Could not create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // A socket file left behind by an earlier run would make bind fail
+    unlink(path.c_str());
+    if (bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listenSocket, 128) < 0) {
+        std::cerr << "Error: Could not listen on " << path << ": " << std::strerror(errno) << std::endl;
+        close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+    socketPath = path;
+    
+    // Same split as batch mode: parallelism comes from the workers
+    previousCvThreads = cv::getNumThreads();
+    if (workerCount > 1) {
+        cv::setNumThreads(1);
+    }
+    
+    workers.reserve(workerCount);
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&CoinServer::workerLoop, this, i);
+    }
+    
+    LOG_INFO << "Listening on " << socketPath << " with " << workerCount
+             << " worker(s), queue capacity " << connections.capacity();
+    return true;
+}
+
+// Accept loop. Polls with a timeout so stop() is noticed without a wakeup call.
+void CoinServer::run() {
+    while (!stopping.load() && listenSocket >= 0) {
+        pollfd listening;
+        listening.fd = listenSocket;
+        listening.events = POLLIN;
+        listening.revents = 0;
+        
+        int ready = poll(&listening, 1, 200);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "Error: poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        
+        int connection = accept(listenSocket, nullptr, nullptr);
+        if (connection < 0) {
+            continue;
+        }
+        
+        if (!connections.tryPush(connection)) {
+            rejected++;
+            writeAll(connection, errorJson("busy"));
+            close(connection);
+        }
+    }
+    
+    shutdown();
+}
+
+// Request the accept loop to end
+void CoinServer::stop() {
+    stopping.store(true);
+}
+
+// Stop accepting, let the workers finish the queued connections, clean up
+void CoinServer::shutdown() {
+    if (listenSocket >= 0) {
+        close(listenSocket);
+        listenSocket = -1;
+        unlink(socketPath.c_str());
+    }
+    
+    connections.close();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (!workers.empty()) {
+        workers.clear();
+        cv::setNumThreads(previousCvThreads);
+        LOG_INFO << "Server stopped: " << served.load() << " served, " << failed.load()
+                 << " failed, " << rejected.load() << " rejected as busy";
+    }
+}
+
+// One worker thread: a warm CoinWorker serving queued connections
+void CoinServer::workerLoop(int workerIndex) {
+    StageTrace::instance().setThreadName("worker " + std::to_string(workerIndex));
+    
+    CoinWorker worker(options, coinDatabase);
+    int connection;
+    while (connections.pop(connection)) {
+        handleConnection(connection, worker);
+        close(connection);
+    }
+}
+
+// Read one request, process it and answer
+void CoinServer::handleConnection(int connection, CoinWorker& worker) {
+    timeval timeout;
+    timeout.tv_sec = kClientTimeoutSeconds;
+    timeout.tv_usec = 0;
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    std::string header, rest;
+    Request request;
+    std::string error;
+    bool valid = readLine(connection, header, rest);
+    if (!valid) {
+        error = "missing or oversized header line";
+    } else {
+        valid = parseHeader(header, request, error);
+    }
+    if (valid && rest.size() > request.size) {
+        error = "more image bytes than size=";
+        valid = false;
+    }
+    if (!valid) {
+        failed++;
+        writeAll(connection, errorJson(error));
+        return;
+    }
+    
+    std::vector<uchar> bytes(request.size);
+    std::copy(rest.begin(), rest.end(), bytes.begin());
+    if (!readExactly(connection, reinterpret_cast<char*>(bytes.data()) + rest.size(),
+                     request.size - rest.size())) {
+        failed++;
+        writeAll(connection, errorJson("connection closed before all image bytes arrived"));
+        return;
+    }
+    
+    // OpenCV reports bad input by throwing; it must not escape the worker thread
+    ImageResult result;
+    try {
+        worker.setOptions(request.options);
+        result = worker.processEncoded(bytes, request.name);
+    } catch (const std::exception& e) {
+        failed++;
+        writeAll(connection, errorJson(e.what()));
+        return;
+    }
+    
+    auto end = std::chrono::steady_clock::now();
+    double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+    
+    if (result.success) {
+        served++;
+    } else {
+        failed++;
+    }
+    writeAll(connection, resultToJson(result, worker, milliseconds));
+}
+
+// Parse "key=value ..." into the request, starting from the server options
+bool CoinServer::parseHeader(const std::string& header, Request& request, std::string& error) const {
+    request.options = options;
+    request.name = "";
+    request.size = 0;
+    bool haveSize = false;
+    
+    std::istringstream fields(header);
+    std::string field;
+    while (fields >> field) {
+        size_t equals = field.find('=');
+        if (equals == std::string::npos) {
+            error = "expected key=value, got '" + field + "'";
+            return false;
+        }
+        std::string key = field.substr(0, equals);
+        std::string value = field.substr(equals + 1);
+        
+        try {
+            if (key == "size") {
+                long long size = std::stoll(value);
+                if (size <= 0 || static_cast<unsigned long long>(size) > kMaxImageBytes) {
+                    error = "size out of range";
+                    return false;
+                }
+                request.size = static_cast<size_t>(size);
+                haveSize = true;
+            } else if (key == "block") {
+                int blockSize = std::stoi(value);
+                if (!BinaryMaskEstimator::isValidBlockSize(blockSize)) {
+                    error = "block must be 3 to " + std::to_string(BoxThreshold::kMaxBlockSize);
+                    return false;
+                }
+                request.options.blockSize = blockSize;
+            } else if (key == "c") {
+                double c = std::stod(value);
+                if (!std::isfinite(c)) {
+                    error = "c must be finite";
+                    return false;
+                }
+                request.options.C = c;
+            } else if (key == "ppmm") {
+                // CoinWorker only applies a positive calibration, so anything else
+                // would classify with the previous request's value
+                double pixelsPerMM = std::stod(value);
+                if (!std::isfinite(pixelsPerMM) || pixelsPerMM <= 0.0) {
+                    error = "ppmm must be a positive number";
+                    return false;
+                }
+                request.options.pixelsPerMM = pixelsPerMM;
+                request.options.enableCoins = true;
+            } else if (key == "preset") {
+                auto preset = presets.find(value);
+                if (preset == presets.end()) {
+                    error = "unknown preset '" + value + "'";
+                    return false;
+                }
+                request.options.pixelsPerMM = preset->second;
+                request.options.enableCoins = true;
+            } else if (key == "name") {
+                request.name = value;
+            } else {
+                error = "unknown parameter '" + key + "'";
+                return false;
+            }
+        } catch (const std::exception&) {
+            error = "invalid value for " + key;
+            return false;
+        }
+    }
+    
+    if (!haveSize) {
+        error = "missing size=";
+        return false;
+    }
+    return true;
+}
+
+// Format an image result as one JSON line
+std::string CoinServer::resultToJson(const ImageResult& result, CoinWorker& worker, double milliseconds) const {
+    if (!result.success) {
+        return errorJson(result.error);
+    }
+    
+    std::ostringstream json;
+    json << "{\"ok\":true,\"name\":\"" << escapeJson(result.imagePath) << "\""
+         << ",\"objects\":" << result.objectCount;
+    if (!result.coinCounts.empty() || worker.getOptions().enableCoins) {
+        // One amount per currency code; amounts in different currencies can't be added
+        json << ",\"total_value\":{";
+        bool first = true;
+        for (const auto& total : result.totalByCurrency) {
+            json << (first ? "" : ",") << "\"" << escapeJson(total.first) << "\":"
+                 << std::fixed << std::setprecision(2) << total.second;
+            first = false;
+        }
+        json << "},\"coins\":{";
+        first = true;
+        for (const auto& pair : result.coinCounts) {
+            if (pair.second == 0) {
+                continue;
+            }
+            // Named from the catalogue that classified the image, not the worker's current one
+            auto name = result.coinNames.find(pair.first);
+            json << (first ? "" : ",") << "\"" << escapeJson(name != result.coinNames.end() ? name->second : "Unknown")
+                 << "\":" << pair.second;
+            first = false;
+        }
+        json << "}";
+    }
+    json << ",\"ms\":" << std::fixed << std::setprecision(1) << milliseconds << "}\n";
+    return json.str();
+}
+
+std::string CoinServer::errorJson(const std::string& error) {
+    return "{\"ok\":false,\"error\":\"" + escapeJson(error) + "\"}\n";
+}
+
+// Escape quotes, backslashes and control characters for a JSON string
+std::string CoinServer::escapeJson(const std::string& text) {
+    std::ostringstream escaped;
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped << '\\' << c;
+        } else if (c < 0x20) {
+            escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+                    << std::dec << std::setfill(' ');
+        } else {
+            escaped << c;
+        }
+    }
+    return escaped.str();
+}
+
+// Read up to the first newline. Bytes received after it are returned in rest.
+bool CoinServer::readLine(int connection, std::string& line, std::string& rest) {
+    std::string buffer;
+    char chunk[4096];
+    for (;;) {
+        size_t newline = buffer.find('\n');
+        if (newline != std::string::npos) {
+            line = buffer.substr(0, newline);
+            rest = buffer.substr(newline + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            return true;
+        }
+        if (buffer.size() > kMaxHeaderBytes) {
+            return false;
+        }
+        
+        ssize_t received = recv(connection, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(received));
+    }
+}
+
+// Read exactly size bytes
+bool CoinServer::readExactly(int connection, char* buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t received = recv(connection, buffer + done, size - done, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(received);
+    }
+    return true;
+}
+
+// Write the whole string; a client that went away doesn't raise SIGPIPE
+bool CoinServer::writeAll(int connection, const std::string& text) {
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t sent = send(connection, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(sent);
+    }
+    return true;
+}
@@ -0,0 +1,232 @@
+#include "coinWorker.hh"
+#include "stageTimer.hh"
+#include <iostream>
+#include <algorithm>
+
+// Constructor
+CoinWorker::CoinWorker(const ProcessingOptions& aOptions, std::shared_ptr<CoinDatabase> database)
+    : options(aOptions), decodeScale(1), counter(aOptions.configPath, database)
+{
+    configure();
+}
+
+// Apply the run options, scaled to the current decode, to the estimator and counter
+void CoinWorker::configure() {
+    applied = scaledOptions(options, decodeScale);
+    
+    maskEstimator.setAdaptiveThresholdParams(applied.blockSize, applied.C);
+    maskEstimator.setThresholdMethod(applied.thresholdMethod);
+    maskEstimator.setMorphologicalParams(applied.kernelSize, applied.iterations);
+    maskEstimator.setMorphShape(applied.morphShape);
+    maskEstimator.setFastPreprocessing(applied.fastPreprocessing);
+    maskEstimator.setTiledExecution(applied.tiledExecution, applied.tileSize);
+    maskEstimator.setPyramidLevels(applied.pyramidLevels);
+    maskEstimator.setRunLengthOutput(applied.runLengthMask);
+    maskEstimator.setMinComponentArea(applied.minComponentArea);
+    
+    counter.setAreaFilter(applied.minArea, applied.maxArea);
+    counter.setShapeFilter(applied.minCircularity, applied.maxAspectRatio);
+    counter.enableAreaFiltering(applied.enableAreaFilter);
+    counter.enableShapeFiltering(applied.enableShapeFilter);
+    counter.setGeometryMode(applied.geometryMode);
+    counter.setCoinClassification(applied.enableCoins);
+    counter.setReportScale(decodeScale);
+    
+    if (applied.pixelsPerMM > 0) {
+        counter.setPixelsPerMM(applied.pixelsPerMM);
+    }
+}
+
+// Switch to other options. The estimator and counter setters only invalidate
+// what actually changed, and the coin config is only reread when its path does.
+void CoinWorker::setOptions(const ProcessingOptions& newOptions) {
+    bool configChanged = newOptions.configPath != options.configPath;
+    options = newOptions;
+    if (configChanged) {
+        counter.loadCoinConfig(options.configPath);
+    }
+    configure();
+}
+
+// Reconfigure when an image comes at another decode scale than the last one
+void CoinWorker::useDecodeScale(int scale) {
+    if (scale != decodeScale) {
+        decodeScale = scale;
+        configure();
+    }
+}
+
+// Process one image end to end
+ImageResult CoinWorker::process(const std::string& imagePath, const std::string& outputBase) {
+    return process(ImageSource::fromFile(imagePath), outputBase);
+}
+
+// Process one mapped file or archive member end to end
+ImageResult CoinWorker::process(const ImageSource& source, const std::string& outputBase) {
+    ImageResult result;
+    result.imagePath = source.getName();
+    
+    useDecodeScale(chooseDecodeScale(options, counter.getSmallestCoinDiameter()));
+    
+    bool loaded;
+    {
+        ScopedTimer timer("loadImage");
+        loaded = maskEstimator.loadImage(source, decodeScale);
+    }
+    if (!loaded) {
+        result.error = "could not load image";
+        return result;
+    }
+    
+    return processLoaded(result, outputBase);
+}
+
+// Process one image handed over as encoded file bytes
+ImageResult CoinWorker::processEncoded(const std::vector<uchar>& bytes, const std::string& name) {
+    ImageResult result;
+    result.imagePath = name;
+    
+    useDecodeScale(chooseDecodeScale(options, counter.getSmallestCoinDiameter()));
+    
+    cv::Mat image;
+    {
+        ScopedTimer timer("decode");
+        if (!bytes.empty()) {
+            image = cv::imdecode(bytes, BinaryMaskEstimator::decodeFlags(decodeScale));
+        }
+    }
+    if (image.empty() || !maskEstimator.adoptImage(image)) {
+        result.error = "could not decode image";
+        return result;
+    }
+    
+    return processLoaded(result, "");
+}
+
+// Process one image decoded by the caller
+ImageResult CoinWorker::processDecoded(const cv::Mat& image, const std::string& imagePath, int scale) {
+    ImageResult result;
+    result.imagePath = imagePath;
+    useDecodeScale(scale);
+    
+    if (image.empty() || !maskEstimator.adoptImage(image)) {
+        result.error = "could not load image";
+        return result;
+    }
+    
+    return processLoaded(result, "");
+}
+
+// Prepare the last image's outputs for a writer thread
+void CoinWorker::renderOutputs(const std::string& outputBase, RenderedOutput& output) {
+    ObjectCounter::resultPaths(outputBase, output.annotatedPath, output.maskPath);
+    output.annotated = counter.getAnnotatedImage();
+    
+    // The shared mask buffer stays with this output until it is written; the
+    // estimator's buffer ring doesn't reuse a mask that is still referenced
+    output.mask = counter.getReportScale() > 1 ? cv::Mat() : counter.getBinaryMaskRef();
+    if (output.mask.empty()) {
+        output.mask = counter.getReportMask();
+    }
+}
+
+// Everything after the image is in the estimator
+ImageResult CoinWorker::processLoaded(ImageResult result, const std::string& outputBase) {
+    // The decoded image and the mask are handed over without a second decode or copy
+    maskEstimator.estimateBinaryMaskShared();
+    if (!maskEstimator.hasMask()) {
+        result.error = "binary mask estimation failed";
+        return result;
+    }
+    
+    if (!counter.loadFromEstimator(maskEstimator)) {
+        result.error = "could not hand image and mask to counter";
+        return result;
+    }
+    
+    int objectCount = counter.countObjects();
+    if (objectCount < 0) {
+        result.error = "object counting failed";
+        return result;
+    }
+    
+    if (options.doCalibration && options.enableCoins) {
+        counter.calibrateWithKnownCoin(applied.calibrationPoint, options.calibrationCoin);
+        objectCount = counter.reclassify();
+    }
+    
+    result.objectCount = objectCount;
+    if (options.enableCoins) {
+        const CoinRegistry& registry = counter.getCoinRegistry();
+        for (const auto& pair : counter.getCoinCounts()) {
+            const CoinInfo* info = registry.find(pair.first);
+            std::string key = info ? info->key : "";
+            result.coinCounts[key] += pair.second;
+            result.coinNames[key] = info ? info->name : "Unknown";
+        }
+        result.totalByCurrency = counter.getTotalValueByCurrency();
+    }
+    
+    // Calibration changes pixelsPerMM, so restore the configured value to keep
+    // every image of the run on the same starting calibration
+    if (options.doCalibration && options.enableCoins && applied.pixelsPerMM > 0) {
+        counter.setPixelsPerMM(applied.pixelsPerMM);
+    }
+    
+    if (!outputBase.empty()) {
+        ScopedTimer timer("saveResults");
+        counter.saveResults(outputBase);
+    }
+    
+    result.success = true;
+    return result;
+}
+
+// Pick the decode reduction for the smallest coin of the catalogue
+int CoinWorker::chooseDecodeScale(const ProcessingOptions& options, double smallestCoinMM) {
+    if (options.reduceMinCoinPixels <= 0.0 || !options.enableCoins ||
+        options.pixelsPerMM <= 0.0 || smallestCoinMM <= 0.0) {
+        return 1;
+    }
+    
+    const double coinPixels = smallestCoinMM * options.pixelsPerMM;
+    for (int scale = 8; scale > 1; scale /= 2) {
+        if (coinPixels / scale >= options.reduceMinCoinPixels) {
+            return scale;
+        }
+    }
+    return 1;
+}
+
+// Shrink every pixel-sized setting by the decode reduction
+ProcessingOptions CoinWorker::scaledOptions(const ProcessingOptions& options, int decodeScale) {
+    ProcessingOptions scaled = options;
+    if (decodeScale <= 1) {
+        return scaled;
+    }
+    
+    const double factor = 1.0 / decodeScale;
+    scaled.minArea = options.minArea * factor * factor;
+    scaled.maxArea = options.maxArea * factor * factor;
+    scaled.minComponentArea = std::max(1, cvRound(options.minComponentArea * factor * factor));
+    scaled.pixelsPerMM = options.pixelsPerMM * factor;
+    scaled.calibrationPoint = cv::Point(cvRound(options.calibrationPoint.x * factor),
+                                        cvRound(options.calibrationPoint.y * factor));
+    
+    // The threshold neighbourhood stays odd and at least 3x3. The morphology
+    // kernel keeps at least 3 pixels too (unless it was set smaller), since a
+    // 1-pixel open/close does nothing at all.
+    scaled.blockSize = std::max(3, cvRound(options.blockSize * factor)) | 1;
+    scaled.kernelSize = std::max(std::min(options.kernelSize, 3), cvRound(options.kernelSize * factor));
+    return scaled;
+}
+
+// Get the options this worker was configured with
+const ProcessingOptions& CoinWorker::getOptions() const {
+    return options;
+}
+
+// Get the display name the coin database uses for a coin type
+std::string CoinWorker::getCoinName(CoinType type) const {
+    return counter.getCoinName(type);
+}
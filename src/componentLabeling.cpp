@@ -0,0 +1,396 @@
+#include "componentLabeling.hh"
+#include <algorithm>
+#include <vector>
+
+// Union-find root with path halving
+static int findRoot(std::vector<int>& parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Join two sets; the lower index stays the root, so a component's root is its
+// first run in raster order
+static void unite(std::vector<int>& parent, int a, int b) {
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) {
+        parent[b] = a;
+    } else if (b < a) {
+        parent[a] = b;
+    }
+}
+
+// Unite the overlapping runs of two consecutive rows. With touchDiagonally,
+// runs that only meet at a corner count as connected (8-connectivity).
+static void uniteRows(const MaskRun* runs, std::vector<int>& parent,
+                      int above, int aboveEnd, int below, int belowEnd, bool touchDiagonally) {
+    const int slack = touchDiagonally ? 1 : 0;
+    while (above < aboveEnd && below < belowEnd) {
+        const MaskRun& a = runs[above];
+        const MaskRun& b = runs[below];
+        if (a.start < b.end + slack && b.start < a.end + slack) {
+            unite(parent, above, below);
+        }
+        // The run that ends first can't reach any later run of the other row
+        if (a.end < b.end) {
+            above++;
+        } else {
+            below++;
+        }
+    }
+}
+
+// Check whether a component's bounding box reaches the image border
+bool ComponentLabeler::touchesBorder(const cv::Mat& stats, int label, const cv::Size& size) {
+    int left = stats.at<int>(label, cv::CC_STAT_LEFT);
+    int top = stats.at<int>(label, cv::CC_STAT_TOP);
+    int width = stats.at<int>(label, cv::CC_STAT_WIDTH);
+    int height = stats.at<int>(label, cv::CC_STAT_HEIGHT);
+    return left == 0 || top == 0 || left + width == size.width || top + height == size.height;
+}
+
+// Column of a component's first pixel in raster order (it lies on the bbox top row)
+int ComponentLabeler::firstColumn(const cv::Mat& labels, const cv::Mat& stats, int label) {
+    int left = stats.at<int>(label, cv::CC_STAT_LEFT);
+    int top = stats.at<int>(label, cv::CC_STAT_TOP);
+    int width = stats.at<int>(label, cv::CC_STAT_WIDTH);
+    
+    const int* row = labels.ptr<int>(top);
+    for (int x = left; x < left + width; x++) {
+        if (row[x] == label) {
+            return x;
+        }
+    }
+    return left;
+}
+
+// Label components with holes filled and drop the small ones
+int ComponentLabeler::labelFilled(const cv::Mat& mask, int minArea,
+                                  cv::Mat& labels, cv::Mat& stats, cv::Mat& centroids,
+                                  cv::Mat* cleanMask, LabelingScratch* scratch) {
+    CV_Assert(mask.type() == CV_8UC1);
+    const cv::Size size = mask.size();
+    
+    LabelingScratch localScratch;
+    LabelingScratch& s = scratch ? *scratch : localScratch;
+    
+    // Foreground is 8-connected, so the background between objects is 4-connected.
+    // The foreground labels are computed straight into the output buffer.
+    cv::Mat& fgLabels = labels;
+    cv::Mat& fgStats = s.fgStats;
+    cv::Mat& fgCentroids = s.fgCentroids;
+    int fgCount = cv::connectedComponentsWithStats(mask, fgLabels, fgStats, fgCentroids, 8, CV_32S);
+    
+    cv::Mat& bgLabels = s.bgLabels;
+    cv::Mat& bgStats = s.bgStats;
+    cv::Mat& bgCentroids = s.bgCentroids;
+    cv::compare(mask, 0, s.background, cv::CMP_EQ);
+    int bgCount = cv::connectedComponentsWithStats(s.background, bgLabels, bgStats, bgCentroids, 4, CV_32S);
+    
+    // A background region that doesn't reach the border is a hole. The pixel
+    // right above its first pixel is foreground (otherwise it would belong to
+    // the same 4-connected region) and identifies the enclosing component.
+    std::vector<int>& holeParent = s.holeParent;
+    holeParent.assign(bgCount, 0);
+    for (int h = 1; h < bgCount; h++) {
+        if (!touchesBorder(bgStats, h, size)) {
+            int x = firstColumn(bgLabels, bgStats, h);
+            int top = bgStats.at<int>(h, cv::CC_STAT_TOP);
+            holeParent[h] = fgLabels.at<int>(top - 1, x);
+        }
+    }
+    
+    // Likewise the pixel above a component's first pixel is background; if that
+    // background is a hole, the component is nested inside another one
+    std::vector<int>& parentHole = s.parentHole;
+    parentHole.assign(fgCount, 0);
+    for (int c = 1; c < fgCount; c++) {
+        if (!touchesBorder(fgStats, c, size)) {
+            int x = firstColumn(fgLabels, fgStats, c);
+            int top = fgStats.at<int>(c, cv::CC_STAT_TOP);
+            int h = bgLabels.at<int>(top - 1, x);
+            if (holeParent[h] != 0) {
+                parentHole[c] = h;
+            }
+        }
+    }
+    
+    // Resolve every component to its outermost (top-level) ancestor
+    std::vector<int>& root = s.root;
+    root.assign(fgCount, 0);
+    for (int c = 1; c < fgCount; c++) {
+        int r = c;
+        while (parentHole[r] != 0) {
+            r = holeParent[parentHole[r]];
+        }
+        root[c] = r;
+    }
+    
+    // Accumulate filled area and centroid per top-level component
+    std::vector<double>& area = s.area;
+    std::vector<double>& sumX = s.sumX;
+    std::vector<double>& sumY = s.sumY;
+    area.assign(fgCount, 0.0);
+    sumX.assign(fgCount, 0.0);
+    sumY.assign(fgCount, 0.0);
+    for (int c = 1; c < fgCount; c++) {
+        double a = fgStats.at<int>(c, cv::CC_STAT_AREA);
+        area[root[c]] += a;
+        sumX[root[c]] += a * fgCentroids.at<double>(c, 0);
+        sumY[root[c]] += a * fgCentroids.at<double>(c, 1);
+    }
+    for (int h = 1; h < bgCount; h++) {
+        if (holeParent[h] != 0) {
+            int r = root[holeParent[h]];
+            double a = bgStats.at<int>(h, cv::CC_STAT_AREA);
+            area[r] += a;
+            sumX[r] += a * bgCentroids.at<double>(h, 0);
+            sumY[r] += a * bgCentroids.at<double>(h, 1);
+        }
+    }
+    
+    // Number the surviving top-level components
+    std::vector<int>& newLabel = s.newLabel;
+    newLabel.assign(fgCount, 0);
+    int count = 1;
+    for (int c = 1; c < fgCount; c++) {
+        if (root[c] == c && area[c] >= minArea) {
+            newLabel[c] = count++;
+        }
+    }
+    
+    stats.create(count, 5, CV_32S);
+    centroids.create(count, 2, CV_64F);
+    
+    long long foregroundArea = 0;
+    for (int c = 1; c < fgCount; c++) {
+        int id = newLabel[c];
+        if (id == 0) {
+            continue;
+        }
+        // Holes and nested components lie inside the outer component's bbox
+        stats.at<int>(id, cv::CC_STAT_LEFT) = fgStats.at<int>(c, cv::CC_STAT_LEFT);
+        stats.at<int>(id, cv::CC_STAT_TOP) = fgStats.at<int>(c, cv::CC_STAT_TOP);
+        stats.at<int>(id, cv::CC_STAT_WIDTH) = fgStats.at<int>(c, cv::CC_STAT_WIDTH);
+        stats.at<int>(id, cv::CC_STAT_HEIGHT) = fgStats.at<int>(c, cv::CC_STAT_HEIGHT);
+        stats.at<int>(id, cv::CC_STAT_AREA) = static_cast<int>(area[c]);
+        centroids.at<double>(id, 0) = sumX[c] / area[c];
+        centroids.at<double>(id, 1) = sumY[c] / area[c];
+        foregroundArea += static_cast<long long>(area[c]);
+    }
+    
+    stats.at<int>(0, cv::CC_STAT_LEFT) = 0;
+    stats.at<int>(0, cv::CC_STAT_TOP) = 0;
+    stats.at<int>(0, cv::CC_STAT_WIDTH) = size.width;
+    stats.at<int>(0, cv::CC_STAT_HEIGHT) = size.height;
+    stats.at<int>(0, cv::CC_STAT_AREA) = static_cast<int>(static_cast<long long>(size.area()) - foregroundArea);
+    centroids.at<double>(0, 0) = 0.0;
+    centroids.at<double>(0, 1) = 0.0;
+    
+    // Lookup tables from the two labelings to the final labels
+    std::vector<int>& fgMap = s.fgMap;
+    fgMap.assign(fgCount, 0);
+    for (int c = 1; c < fgCount; c++) {
+        fgMap[c] = newLabel[root[c]];
+    }
+    std::vector<int>& bgMap = s.bgMap;
+    bgMap.assign(bgCount, 0);
+    for (int h = 1; h < bgCount; h++) {
+        if (holeParent[h] != 0) {
+            bgMap[h] = newLabel[root[holeParent[h]]];
+        }
+    }
+    
+    // Single pass rewriting the foreground labels into the final ones and writing the clean mask
+    if (cleanMask) {
+        cleanMask->create(size, CV_8UC1);
+    }
+    for (int y = 0; y < size.height; y++) {
+        int* fgRow = fgLabels.ptr<int>(y);
+        const int* bgRow = bgLabels.ptr<int>(y);
+        uchar* maskRow = cleanMask ? cleanMask->ptr<uchar>(y) : nullptr;
+        
+        for (int x = 0; x < size.width; x++) {
+            int label = fgRow[x] ? fgMap[fgRow[x]] : bgMap[bgRow[x]];
+            fgRow[x] = label;
+            if (maskRow) {
+                maskRow[x] = label ? 255 : 0;
+            }
+        }
+    }
+    
+    return count;
+}
+
+// Label a run-length mask with holes filled and drop the small components
+int ComponentLabeler::labelRuns(const RunLengthMask& mask, int minArea, RunLengthMask& cleanMask,
+                                std::vector<int>& runLabels, cv::Mat& stats, cv::Mat& centroids,
+                                RunLabelingScratch* scratch) {
+    CV_Assert(&mask != &cleanMask);
+    const int rows = mask.rows();
+    const int cols = mask.cols();
+    const int runCount = static_cast<int>(mask.runCount());
+    
+    RunLabelingScratch localScratch;
+    RunLabelingScratch& s = scratch ? *scratch : localScratch;
+    
+    // Foreground runs, 8-connected between rows
+    const MaskRun* runs = mask.runData();
+    std::vector<int>& runParent = s.runParent;
+    runParent.resize(runCount);
+    for (int i = 0; i < runCount; i++) {
+        runParent[i] = i;
+    }
+    for (int y = 1; y < rows; y++) {
+        uniteRows(runs, runParent, mask.rowBegin(y - 1), mask.rowEnd(y - 1),
+                  mask.rowBegin(y), mask.rowEnd(y), true);
+    }
+    
+    // Background runs (the gaps), 4-connected between rows. A gap between two
+    // runs of a row remembers the run on its left; the one on its right is next.
+    std::vector<MaskRun>& gaps = s.gaps;
+    std::vector<int>& gapOffsets = s.gapOffsets;
+    std::vector<int>& gapLeftRun = s.gapLeftRun;
+    std::vector<int>& runGapAfter = s.runGapAfter;
+    std::vector<unsigned char>& gapOnBorder = s.gapOnBorder;
+    gaps.clear();
+    gapLeftRun.clear();
+    gapOnBorder.clear();
+    gapOffsets.assign(1, 0);
+    runGapAfter.assign(runCount, -1);
+    
+    for (int y = 0; y < rows; y++) {
+        int x = 0;
+        for (int i = mask.rowBegin(y); i < mask.rowEnd(y); i++) {
+            if (runs[i].start > x) {
+                if (i > mask.rowBegin(y)) {
+                    runGapAfter[i - 1] = static_cast<int>(gaps.size());
+                }
+                gaps.push_back({x, runs[i].start});
+                gapLeftRun.push_back(i > mask.rowBegin(y) ? i - 1 : -1);
+                gapOnBorder.push_back(y == 0 || y == rows - 1 || x == 0);
+            }
+            x = runs[i].end;
+        }
+        if (x < cols) {
+            gaps.push_back({x, cols});
+            gapLeftRun.push_back(-1);
+            gapOnBorder.push_back(1);
+        }
+        gapOffsets.push_back(static_cast<int>(gaps.size()));
+    }
+    
+    const int gapCount = static_cast<int>(gaps.size());
+    std::vector<int>& gapParent = s.gapParent;
+    gapParent.resize(gapCount);
+    for (int g = 0; g < gapCount; g++) {
+        gapParent[g] = g;
+    }
+    for (int y = 1; y < rows; y++) {
+        uniteRows(gaps.data(), gapParent, gapOffsets[y - 1], gapOffsets[y],
+                  gapOffsets[y], gapOffsets[y + 1], false);
+    }
+    for (int g = 0; g < gapCount; g++) {
+        if (gapOnBorder[g]) {
+            gapOnBorder[findRoot(gapParent, g)] = 1;
+        }
+    }
+    
+    // A gap region that never reaches the border is a hole: it and everything
+    // inside it belong to the component around it
+    std::vector<long long>& area = s.area;
+    area.assign(runCount, 0);
+    for (int g = 0; g < gapCount; g++) {
+        if (!gapOnBorder[findRoot(gapParent, g)]) {
+            unite(runParent, gapLeftRun[g], gapLeftRun[g] + 1);
+        }
+    }
+    for (int i = 0; i < runCount; i++) {
+        area[findRoot(runParent, i)] += runs[i].end - runs[i].start;
+    }
+    for (int g = 0; g < gapCount; g++) {
+        if (!gapOnBorder[findRoot(gapParent, g)]) {
+            area[findRoot(runParent, gapLeftRun[g])] += gaps[g].end - gaps[g].start;
+        }
+    }
+    
+    // Number the surviving components in raster order of their first run
+    std::vector<int>& newLabel = s.newLabel;
+    newLabel.assign(runCount, 0);
+    int count = 1;
+    for (int i = 0; i < runCount; i++) {
+        if (runParent[i] == i && area[i] >= minArea) {
+            newLabel[i] = count++;
+        }
+    }
+    
+    // Clean mask: kept runs, merged across the holes between them
+    cleanMask.create(rows, cols);
+    runLabels.clear();
+    for (int y = 0; y < rows; y++) {
+        bool previousKept = false;
+        for (int i = mask.rowBegin(y); i < mask.rowEnd(y); i++) {
+            int label = newLabel[findRoot(runParent, i)];
+            if (label == 0) {
+                previousKept = false;
+                continue;
+            }
+            int gap = i > mask.rowBegin(y) ? runGapAfter[i - 1] : -1;
+            if (previousKept && gap >= 0 && !gapOnBorder[findRoot(gapParent, gap)]) {
+                cleanMask.extendLastRun(runs[i].end);
+            } else {
+                cleanMask.appendRun(runs[i].start, runs[i].end);
+                runLabels.push_back(label);
+            }
+            previousKept = true;
+        }
+        cleanMask.endRow();
+    }
+    
+    // Statistics straight from the clean runs
+    stats.create(count, 5, CV_32S);
+    centroids.create(count, 2, CV_64F);
+    std::vector<int> left(count, cols), top(count, rows), right(count, -1), bottom(count, -1);
+    std::vector<long long> pixels(count, 0);
+    std::vector<double> sumX(count, 0.0), sumY(count, 0.0);
+    
+    long long foregroundArea = 0;
+    for (int y = 0; y < rows; y++) {
+        for (int i = cleanMask.rowBegin(y); i < cleanMask.rowEnd(y); i++) {
+            const MaskRun& r = cleanMask.run(i);
+            int label = runLabels[i];
+            long long length = r.end - r.start;
+            left[label] = std::min(left[label], r.start);
+            right[label] = std::max(right[label], r.end - 1);
+            top[label] = std::min(top[label], y);
+            bottom[label] = std::max(bottom[label], y);
+            pixels[label] += length;
+            sumX[label] += length * (r.start + r.end - 1) / 2.0;
+            sumY[label] += static_cast<double>(length) * y;
+            foregroundArea += length;
+        }
+    }
+    
+    for (int label = 1; label < count; label++) {
+        stats.at<int>(label, cv::CC_STAT_LEFT) = left[label];
+        stats.at<int>(label, cv::CC_STAT_TOP) = top[label];
+        stats.at<int>(label, cv::CC_STAT_WIDTH) = right[label] - left[label] + 1;
+        stats.at<int>(label, cv::CC_STAT_HEIGHT) = bottom[label] - top[label] + 1;
+        stats.at<int>(label, cv::CC_STAT_AREA) = static_cast<int>(pixels[label]);
+        centroids.at<double>(label, 0) = sumX[label] / pixels[label];
+        centroids.at<double>(label, 1) = sumY[label] / pixels[label];
+    }
+    
+    stats.at<int>(0, cv::CC_STAT_LEFT) = 0;
+    stats.at<int>(0, cv::CC_STAT_TOP) = 0;
+    stats.at<int>(0, cv::CC_STAT_WIDTH) = cols;
+    stats.at<int>(0, cv::CC_STAT_HEIGHT) = rows;
+    stats.at<int>(0, cv::CC_STAT_AREA) = static_cast<int>(static_cast<long long>(rows) * cols - foregroundArea);
+    centroids.at<double>(0, 0) = 0.0;
+    centroids.at<double>(0, 1) = 0.0;
+    
+    return count;
+}
@@ -0,0 +1,281 @@
+#include "decomposedMorphology.hh"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+static const int kWordBits = 64;
+
+// 64 bits of a row starting at bit p; bits outside the row's words read as fill
+static inline uint64_t readBits(const uint64_t* row, int words, int p, uint64_t fill) {
+    int q = p >= 0 ? p / kWordBits : -((-p + kWordBits - 1) / kWordBits);
+    int r = p - q * kWordBits;
+    uint64_t low = (q >= 0 && q < words) ? row[q] : fill;
+    if (r == 0) {
+        return low;
+    }
+    uint64_t high = (q + 1 >= 0 && q + 1 < words) ? row[q + 1] : fill;
+    return (low >> r) | (high << (kWordBits - r));
+}
+
+// Bits lo..hi-1 of a word
+static inline uint64_t bitRange(int lo, int hi) {
+    if (hi <= lo) {
+        return 0;
+    }
+    uint64_t upper = hi >= kWordBits ? ~0ULL : ((1ULL << hi) - 1);
+    return upper & ~((1ULL << lo) - 1);
+}
+
+// Set bits for erosion (minimum), clear for dilation (maximum)
+static inline uint64_t combine(uint64_t a, uint64_t b, bool erode) {
+    return erode ? (a & b) : (a | b);
+}
+
+// Constructor
+DecomposedMorphology::DecomposedMorphology()
+    : radius(0)
+{
+}
+
+// Square of side 2 * radius + 1
+void DecomposedMorphology::setSquare(int aRadius) {
+    radius = std::max(0, aRadius);
+    segments.clear();
+    if (radius > 0) {
+        segments.push_back({HORIZONTAL, radius});
+        segments.push_back({VERTICAL, radius});
+    }
+}
+
+// Octagon approximating a disk of the given radius
+void DecomposedMorphology::setOctagon(int aRadius) {
+    radius = std::max(0, aRadius);
+    segments.clear();
+    if (radius == 0) {
+        return;
+    }
+    
+    // The diamond part (diagonals plus cross) has radius 2c + 1 ~ (2 - sqrt(2)) R
+    int diagonal = std::max(0, static_cast<int>(std::lround(((2.0 - std::sqrt(2.0)) * radius - 1.0) / 2.0)));
+    int straight = radius - (2 * diagonal + 1);
+    
+    if (straight > 0) {
+        segments.push_back({HORIZONTAL, straight});
+        segments.push_back({VERTICAL, straight});
+    }
+    if (diagonal > 0) {
+        segments.push_back({DIAGONAL, diagonal});
+        segments.push_back({ANTIDIAGONAL, diagonal});
+    }
+    segments.push_back({CROSS, 1});
+}
+
+int DecomposedMorphology::getRadius() const {
+    return radius;
+}
+
+// Dilate by the current element
+void DecomposedMorphology::dilate(const BitMask& src, BitMask& dst) {
+    apply(src, dst, false);
+}
+
+// Erode by the current element
+void DecomposedMorphology::erode(const BitMask& src, BitMask& dst) {
+    apply(src, dst, true);
+}
+
+// Copy the image into the middle of a margin of fill, run every segment, copy it back
+void DecomposedMorphology::apply(const BitMask& src, BitMask& dst, bool erode) {
+    const uint64_t fill = erode ? ~0ULL : 0ULL;
+    const int margin = radius;
+    const int srcWords = src.wordsPerRow();
+    
+    work.create(src.rows() + 2 * margin, src.cols() + 2 * margin);
+    const int words = work.wordsPerRow();
+    fillRow.assign(words, fill);
+    
+    for (int y = 0; y < work.rows(); y++) {
+        uint64_t* out = work.row(y);
+        int sourceY = y - margin;
+        if (sourceY < 0 || sourceY >= src.rows()) {
+            std::fill(out, out + words, fill);
+            continue;
+        }
+        
+        // Bits past src's last column are padding, not pixels
+        const uint64_t* in = src.row(sourceY);
+        for (int j = 0; j < words; j++) {
+            int p = j * kWordBits - margin;
+            uint64_t valid = bitRange(std::max(0, -p), std::min(kWordBits, src.cols() - p));
+            out[j] = (readBits(in, srcWords, p, fill) & valid) | (fill & ~valid);
+        }
+    }
+    
+    for (const auto& segment : segments) {
+        switch (segment.direction) {
+            case HORIZONTAL:
+                applyHorizontal(segment.radius, erode);
+                break;
+            case VERTICAL:
+                applyVertical(segment.radius, erode);
+                break;
+            case DIAGONAL:
+                applyDiagonal(segment.radius, 1, erode);
+                break;
+            case ANTIDIAGONAL:
+                applyDiagonal(segment.radius, -1, erode);
+                break;
+            case CROSS:
+                applyCross(erode);
+                break;
+        }
+    }
+    
+    dst.create(src.rows(), src.cols());
+    const uint64_t lastMask = dst.lastWordMask();
+    for (int y = 0; y < dst.rows(); y++) {
+        const uint64_t* in = work.row(y + margin);
+        uint64_t* out = dst.row(y);
+        for (int j = 0; j < srcWords; j++) {
+            out[j] = readBits(in, words, j * kWordBits + margin, fill);
+        }
+        out[srcWords - 1] &= lastMask;
+    }
+}
+
+// Horizontal segment by shift doubling: start from in(x - r), then fold in
+// t(x + step) until the window covers 2r + 1 pixels
+void DecomposedMorphology::applyHorizontal(int segmentRadius, bool erode) {
+    const uint64_t fill = erode ? ~0ULL : 0ULL;
+    const int words = work.wordsPerRow();
+    const int length = 2 * segmentRadius + 1;
+    line.resize(words);
+    
+    for (int y = 0; y < work.rows(); y++) {
+        uint64_t* row = work.row(y);
+        for (int j = 0; j < words; j++) {
+            line[j] = readBits(row, words, j * kWordBits - segmentRadius, fill);
+        }
+        
+        // In place: word j only reads words at or after j
+        for (int covered = 1; covered < length; ) {
+            int step = std::min(covered, length - covered);
+            for (int j = 0; j < words; j++) {
+                line[j] = combine(line[j], readBits(line.data(), words, j * kWordBits + step, fill), erode);
+            }
+            covered += step;
+        }
+        
+        std::copy(line.begin(), line.end(), row);
+    }
+}
+
+// Vertical segment, van Herk/Gil-Werman: running prefix and suffix within
+// blocks of 2r + 1 rows, then one combine of a suffix and a prefix per row
+void DecomposedMorphology::applyVertical(int segmentRadius, bool erode) {
+    const int rows = work.rows();
+    const int words = work.wordsPerRow();
+    const int length = 2 * segmentRadius + 1;
+    const int extended = rows + 2 * segmentRadius;
+    
+    // Row i of the extended column is work row i - r, fill outside
+    auto source = [&](int i) -> const uint64_t* {
+        int y = i - segmentRadius;
+        return (y >= 0 && y < rows) ? work.row(y) : fillRow.data();
+    };
+    
+    prefix.create(extended, work.cols());
+    suffix.create(extended, work.cols());
+    for (int start = 0; start < extended; start += length) {
+        int end = std::min(start + length, extended);
+        
+        std::copy(source(start), source(start) + words, prefix.row(start));
+        for (int i = start + 1; i < end; i++) {
+            const uint64_t* previous = prefix.row(i - 1);
+            const uint64_t* in = source(i);
+            uint64_t* out = prefix.row(i);
+            for (int j = 0; j < words; j++) {
+                out[j] = combine(previous[j], in[j], erode);
+            }
+        }
+        
+        std::copy(source(end - 1), source(end - 1) + words, suffix.row(end - 1));
+        for (int i = end - 2; i >= start; i--) {
+            const uint64_t* next = suffix.row(i + 1);
+            const uint64_t* in = source(i);
+            uint64_t* out = suffix.row(i);
+            for (int j = 0; j < words; j++) {
+                out[j] = combine(next[j], in[j], erode);
+            }
+        }
+    }
+    
+    // The window of output row y is extended rows y .. y + 2r
+    for (int y = 0; y < rows; y++) {
+        const uint64_t* head = suffix.row(y);
+        const uint64_t* tail = prefix.row(y + length - 1);
+        uint64_t* out = work.row(y);
+        for (int j = 0; j < words; j++) {
+            out[j] = combine(head[j], tail[j], erode);
+        }
+    }
+}
+
+// Diagonal segment (slope 1: down-right, -1: up-right) by shift doubling
+void DecomposedMorphology::applyDiagonal(int segmentRadius, int slope, bool erode) {
+    const uint64_t fill = erode ? ~0ULL : 0ULL;
+    const int rows = work.rows();
+    const int words = work.wordsPerRow();
+    const int length = 2 * segmentRadius + 1;
+    
+    // t(x, y) = in(x - r, y - slope * r)
+    scratch.create(rows, work.cols());
+    for (int y = 0; y < rows; y++) {
+        int sourceY = y - slope * segmentRadius;
+        const uint64_t* in = (sourceY >= 0 && sourceY < rows) ? work.row(sourceY) : fillRow.data();
+        uint64_t* out = scratch.row(y);
+        for (int j = 0; j < words; j++) {
+            out[j] = readBits(in, words, j * kWordBits - segmentRadius, fill);
+        }
+    }
+    
+    // t(x, y) op= t(x + step, y + slope * step). Rows are visited so that the
+    // neighbor row has not been updated yet in this pass.
+    for (int covered = 1; covered < length; ) {
+        int step = std::min(covered, length - covered);
+        for (int i = 0; i < rows; i++) {
+            int y = slope > 0 ? i : rows - 1 - i;
+            int neighborY = y + slope * step;
+            const uint64_t* neighbor = (neighborY >= 0 && neighborY < rows) ? scratch.row(neighborY) : fillRow.data();
+            uint64_t* out = scratch.row(y);
+            for (int j = 0; j < words; j++) {
+                out[j] = combine(out[j], readBits(neighbor, words, j * kWordBits + step, fill), erode);
+            }
+        }
+        covered += step;
+    }
+    
+    std::swap(work, scratch);
+}
+
+// Five-pixel cross: the pixel and its 4-neighbors
+void DecomposedMorphology::applyCross(bool erode) {
+    const uint64_t fill = erode ? ~0ULL : 0ULL;
+    const int rows = work.rows();
+    const int words = work.wordsPerRow();
+    
+    scratch.create(rows, work.cols());
+    for (int y = 0; y < rows; y++) {
+        const uint64_t* up = y > 0 ? work.row(y - 1) : fillRow.data();
+        const uint64_t* down = y + 1 < rows ? work.row(y + 1) : fillRow.data();
+        const uint64_t* in = work.row(y);
+        uint64_t* out = scratch.row(y);
+        for (int j = 0; j < words; j++) {
+            uint64_t value = combine(in[j], combine(up[j], down[j], erode), erode);
+            value = combine(value, readBits(in, words, j * kWordBits - 1, fill), erode);
+            out[j] = combine(value, readBits(in, words, j * kWordBits + 1, fill), erode);
+        }
+    }
+    
+    std::swap(work, scratch);
+}
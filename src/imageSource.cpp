@@ -0,0 +1,271 @@
+#include "imageSource.hh"
+#include "logger.hh"
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t kTarBlock = 512;
+
+// Map a file read-only
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open " << path << ": " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        std::cerr << "Error: " << path << " is empty or unreadable" << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    
+    size_t length = static_cast<size_t>(info.st_size);
+    void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file alive on its own
+    close(fd);
+    if (address == MAP_FAILED) {
+        std::cerr << "Error: Could not map " << path << ": " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+    
+    return std::shared_ptr<const MappedFile>(new MappedFile(path, address, length));
+}
+
+// Constructor
+MappedFile::MappedFile(const std::string& aPath, void* aAddress, size_t aLength)
+    : path(aPath), address(aAddress), length(aLength)
+{
+}
+
+// Destructor
+MappedFile::~MappedFile() {
+    munmap(address, length);
+}
+
+const uchar* MappedFile::data() const {
+    return static_cast<const uchar*>(address);
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
+
+const std::string& MappedFile::getPath() const {
+    return path;
+}
+
+// Start reading ahead the pages of one member
+void MappedFile::willNeed(size_t offset, size_t rangeLength) const {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset - offset % page;
+    size_t end = std::min(offset + rangeLength, length);
+    if (end > start) {
+        madvise(static_cast<char*>(address) + start, end - start, MADV_WILLNEED);
+    }
+}
+
+// Constructor
+ImageSource::ImageSource()
+    : offset(0), size(0)
+{
+}
+
+// A plain file
+ImageSource ImageSource::fromFile(const std::string& path) {
+    ImageSource source;
+    source.name = path;
+    source.path = path;
+    return source;
+}
+
+std::vector<ImageSource> ImageSource::fromFiles(const std::vector<std::string>& paths) {
+    std::vector<ImageSource> sources;
+    sources.reserve(paths.size());
+    for (const auto& path : paths) {
+        sources.push_back(fromFile(path));
+    }
+    return sources;
+}
+
+// NUL-terminated (or full-width) text field of a tar header
+static std::string tarText(const uchar* field, size_t width) {
+    const char* text = reinterpret_cast<const char*>(field);
+    return std::string(text, strnlen(text, width));
+}
+
+// Numeric tar header field: octal text, or big-endian binary when the high
+// bit of the first byte is set (GNU extension for members of 8 GiB and more)
+static bool tarNumber(const uchar* field, size_t width, unsigned long long& value) {
+    value = 0;
+    if (field[0] & 0x80) {
+        for (size_t i = 1; i < width; i++) {
+            value = (value << 8) | field[i];
+        }
+        return true;
+    }
+    
+    size_t i = 0;
+    while (i < width && field[i] == ' ') {
+        i++;
+    }
+    bool digits = false;
+    for (; i < width && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = value * 8 + (field[i] - '0');
+        digits = true;
+    }
+    return digits;
+}
+
+// Header checksum: the sum of all bytes with the checksum field read as spaces
+static bool tarChecksumValid(const uchar* header) {
+    unsigned long long stored;
+    if (!tarNumber(header + 148, 8, stored)) {
+        return false;
+    }
+    unsigned long long sum = 0;
+    for (size_t i = 0; i < kTarBlock; i++) {
+        sum += (i >= 148 && i < 156) ? ' ' : header[i];
+    }
+    return sum == stored;
+}
+
+// "path" record of a pax extended header ("<length> path=<value>\n" records)
+static std::string paxPath(const uchar* data, size_t size) {
+    std::string records(reinterpret_cast<const char*>(data), size);
+    size_t position = 0;
+    while (position < records.size()) {
+        size_t space = records.find(' ', position);
+        if (space == std::string::npos) {
+            break;
+        }
+        size_t recordLength = std::strtoul(records.c_str() + position, nullptr, 10);
+        if (recordLength == 0 || position + recordLength > records.size()) {
+            break;
+        }
+        std::string record = records.substr(space + 1, position + recordLength - space - 2);
+        if (record.compare(0, 5, "path=") == 0) {
+            return record.substr(5);
+        }
+        position += recordLength;
+    }
+    return "";
+}
+
+// Walk the headers of an uncompressed tar archive
+bool ImageSource::listTar(const std::string& tarPath, std::vector<ImageSource>& members) {
+    std::shared_ptr<const MappedFile> archive = MappedFile::open(tarPath);
+    if (!archive) {
+        return false;
+    }
+    
+    const uchar* data = archive->data();
+    const size_t archiveSize = archive->size();
+    if (archiveSize >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+        std::cerr << "Error: " << tarPath << " is gzip-compressed; only uncompressed tar archives can be mapped"
+                  << std::endl;
+        return false;
+    }
+    
+    std::string longName;  // From a GNU 'L' or pax 'x' header, for the next member only
+    size_t position = 0;
+    while (position + kTarBlock <= archiveSize) {
+        const uchar* header = data + position;
+        if (std::all_of(header, header + kTarBlock, [](uchar byte) { return byte == 0; })) {
+            break;  // End-of-archive marker
+        }
+        
+        unsigned long long memberSize;
+        if (!tarChecksumValid(header) || !tarNumber(header + 124, 12, memberSize)) {
+            std::cerr << "Error: " << tarPath << " is not a tar archive or is corrupt at offset "
+                      << position << std::endl;
+            return false;
+        }
+        
+        const size_t dataOffset = position + kTarBlock;
+        if (memberSize > archiveSize - dataOffset) {
+            std::cerr << "Error: " << tarPath << " is truncated" << std::endl;
+            return false;
+        }
+        
+        const char type = static_cast<char>(header[156]);
+        if (type == 'L') {
+            longName = tarText(data + dataOffset, static_cast<size_t>(memberSize));
+        } else if (type == 'x') {
+            longName = paxPath(data + dataOffset, static_cast<size_t>(memberSize));
+        } else {
+            if (type == '0' || type == '\0' || type == '7') {
+                std::string memberName = longName;
+                if (memberName.empty()) {
+                    memberName = tarText(header, 100);
+                    // ustar keeps the leading directories of long paths in the prefix field
+                    if (std::memcmp(header + 257, "ustar", 5) == 0 && header[345] != 0) {
+                        memberName = tarText(header + 345, 155) + "/" + memberName;
+                    }
+                }
+                
+                ImageSource member;
+                member.name = tarPath + ":" + memberName;
+                member.memberPath = memberName;
+                member.mapping = archive;
+                member.offset = dataOffset;
+                member.size = static_cast<size_t>(memberSize);
+                members.push_back(member);
+            }
+            longName.clear();
+        }
+        
+        position = dataOffset + (memberSize + kTarBlock - 1) / kTarBlock * kTarBlock;
+    }
+    
+    LOG_DEBUG << "Mapped " << tarPath << " (" << archiveSize << " bytes, " << members.size() << " files)";
+    return true;
+}
+
+// Decode straight from the mapped bytes
+cv::Mat ImageSource::decode(int flags) const {
+    std::shared_ptr<const MappedFile> file = mapping;
+    size_t start = offset;
+    size_t length = size;
+    if (!file) {
+        file = MappedFile::open(path);
+        if (!file) {
+            return cv::Mat();
+        }
+        start = 0;
+        length = file->size();
+    }
+    if (length == 0 || length > static_cast<size_t>(INT_MAX)) {
+        std::cerr << "Error: " << name << " has an unsupported size (" << length << " bytes)" << std::endl;
+        return cv::Mat();
+    }
+    
+    file->willNeed(start, length);
+    
+    // A header over the mapped bytes; imdecode only reads them
+    const cv::Mat encoded(1, static_cast<int>(length), CV_8UC1, const_cast<uchar*>(file->data() + start));
+    cv::Mat image = cv::imdecode(encoded, flags);
+    if (image.empty()) {
+        std::cerr << "Error: Could not decode " << name << std::endl;
+    }
+    return image;
+}
+
+const std::string& ImageSource::getName() const {
+    return name;
+}
+
+const std::string& ImageSource::getMemberPath() const {
+    return memberPath;
+}
+
+bool ImageSource::isArchiveMember() const {
+    return mapping != nullptr;
+}
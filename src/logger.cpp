@@ -0,0 +1,87 @@
+#include "logger.hh"
+#include <iostream>
+#include <mutex>
+
+std::atomic<int> Logger::currentLevel(static_cast<int>(LogLevel::INFO));
+
+namespace {
+
+std::mutex consoleMutex;
+
+// Per-thread line buffer, reused for every message of the thread
+struct ThreadLogBuffer {
+    std::ostringstream stream;
+    std::ios::fmtflags defaultFlags = stream.flags();
+    std::streamsize defaultPrecision = stream.precision();
+    bool inUse = false;
+};
+
+ThreadLogBuffer& threadLogBuffer() {
+    thread_local ThreadLogBuffer buffer;
+    return buffer;
+}
+
+} // namespace
+
+// Set the verbosity for all threads
+void Logger::setLevel(LogLevel level) {
+    currentLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel Logger::getLevel() {
+    return static_cast<LogLevel>(currentLevel.load(std::memory_order_relaxed));
+}
+
+// Parse a level name
+bool Logger::parseLevel(const std::string& name, LogLevel& level) {
+    if (name == "quiet") {
+        level = LogLevel::QUIET;
+    } else if (name == "info") {
+        level = LogLevel::INFO;
+    } else if (name == "debug") {
+        level = LogLevel::DEBUG;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Flush std::cout
+void Logger::flush() {
+    std::lock_guard<std::mutex> lock(consoleMutex);
+    std::cout.flush();
+}
+
+// Start a line in the thread's buffer
+LogMessage::LogMessage() {
+    ThreadLogBuffer& buffer = threadLogBuffer();
+    if (buffer.inUse) {
+        nested.reset(new std::ostringstream());
+        out = nested.get();
+        return;
+    }
+    
+    buffer.inUse = true;
+    out = &buffer.stream;
+}
+
+// Finish the line and hand it to the console in one write
+LogMessage::~LogMessage() {
+    *out << '\n';
+    
+    {
+        std::lock_guard<std::mutex> lock(consoleMutex);
+        const std::string& text = out->str();
+        std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+    
+    if (!nested) {
+        // Reset text and formatting so the next message starts clean
+        ThreadLogBuffer& buffer = threadLogBuffer();
+        buffer.stream.str(std::string());
+        buffer.stream.clear();
+        buffer.stream.flags(buffer.defaultFlags);
+        buffer.stream.precision(buffer.defaultPrecision);
+        buffer.inUse = false;
+    }
+}
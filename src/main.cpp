@@ -1,28 +1,45 @@
 #include "objectCounter.hh"
 #include "binaryMaskEstimator.hh"
+#include "boxThreshold.hh"
+#include "batchProcessor.hh"
+#include "coinServer.hh"
+#include "stageTimer.hh"
+#include "logger.hh"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <csignal>
 
 void printUsage(const char* programName) {
     std::cout << "Usage: " << programName << " [options]" << std::endl;
     std::cout << "Options:" << std::endl;
     std::cout << "  -i <image_path>      Input image file path" << std::endl;
     std::cout << "  -o <output_path>     Output base path for results (optional)" << std::endl;
-    std::cout << "  -config <config_path> Path to coin configuration file (default: coins.cfg)" << std::endl;
+    std::cout << "  -config <config_path> Coin configuration file(s), comma separated (default: coins.cfg)" << std::endl;
     std::cout << "  -minarea <value>     Minimum object area (default: 50)" << std::endl;
     std::cout << "  -maxarea <value>     Maximum object area (default: 50000)" << std::endl;
     std::cout << "  -mincirc <value>     Minimum circularity for shape filtering (default: 0.3)" << std::endl;
     std::cout << "  -maxaspect <value>   Maximum aspect ratio for shape filtering (default: 3.0)" << std::endl;
     std::cout << "  -noarea              Disable area filtering" << std::endl;
     std::cout << "  -shape               Enable shape filtering" << std::endl;
+    std::cout << "  -geometry <mode>     Circularity/diameter: exact (traced contour, default) or fast (moments)" << std::endl;
     std::cout << "  -b <block_size>      Block size for adaptive threshold (default: 21)" << std::endl;
     std::cout << "  -c <C_value>         C parameter for adaptive threshold (default: 10.0)" << std::endl;
+    std::cout << "  -thresh <method>     Adaptive threshold mean: gaussian (default) or integral" << std::endl;
     std::cout << "  -k <kernel_size>     Morphological kernel size (default: 7)" << std::endl;
     std::cout << "  -iter <iterations>   Morphological iterations (default: 3)" << std::endl;
+    std::cout << "  -morph <shape>       Morphology element: ellipse (default), rect or octagon" << std::endl;
+    std::cout << "  -fastpre             Fused single-plane preprocessing (gray, blur, CLAHE)" << std::endl;
+    std::cout << "  -tiled               Tiled, multi-core mask estimation for very large images" << std::endl;
+    std::cout << "  -tilesize <pixels>   Core tile edge for -tiled (default: sized to fit L2)" << std::endl;
+    std::cout << "  -pyramid <levels>    Coarse-to-fine detection on an image downscaled 2^levels times" << std::endl;
+    std::cout << "  -reduce <pixels>     Decode at 1/2, 1/4 or 1/8 size while the smallest coin stays <pixels> across" << std::endl;
+    std::cout << "  -rle                 Keep the mask as runs; label and measure components on them" << std::endl;
     std::cout << "  -display             Display the results" << std::endl;
+    std::cout << "  -timing              Print a per-stage timing table at the end of the run" << std::endl;
+    std::cout << "  -trace <file.json>   Write a Chrome trace of every stage (implies -timing; not with -serve)" << std::endl;
     std::cout << "  -summary             Print detailed object summary" << std::endl;
     
     // Coin detection options
@@ -30,11 +47,32 @@ void printUsage(const char* programName) {
     std::cout << "  -coins               Enable coin classification" << std::endl;
     std::cout << "  -ppmm <value>        Pixels per millimeter for size calibration" << std::endl;
     std::cout << "  -calibrate <x> <y> <type>  Calibrate using known coin at position (x,y)" << std::endl;
-    std::cout << "                       Types: penny, nickel, dime, quarter, half, dollar" << std::endl;
+    std::cout << "                       <type> is a key or name from the coin config, e.g. quarter" << std::endl;
     std::cout << "  -preset <name>       Use preset calibration (phone, camera, scanner)" << std::endl;
     std::cout << "  -coinsum             Print coin summary with total value" << std::endl;
     std::cout << "  -interactive         Interactive calibration mode" << std::endl;
     
+    // Batch options
+    std::cout << std::endl << "Batch Options:" << std::endl;
+    std::cout << "  -dir <directory>     Process every image in a directory" << std::endl;
+    std::cout << "  -glob <pattern>      Process every file matching a pattern (e.g. \"resources/*.jpg\")" << std::endl;
+    std::cout << "  -manifest <file>     Process the image paths listed in a file (one per line)" << std::endl;
+    std::cout << "  -tar <archive>       Process the images in an uncompressed tar archive without extracting it" << std::endl;
+    std::cout << "  -threads <count>     Worker threads for batch and server mode (default: all cores)" << std::endl;
+    std::cout << "                       In batch mode -o names an output directory" << std::endl;
+    std::cout << "  -decoders <count>    Batch: decode images on <count> separate threads (pipelined mode)" << std::endl;
+    std::cout << "  -writers <count>     Batch: threads writing the output images in pipelined mode (default: 1)" << std::endl;
+    std::cout << "  -pipedepth <count>   Batch: images each pipeline queue may hold (default: 8)" << std::endl;
+    std::cout << "  -watch <ms>          Batch/server: reload the coin config when it changes, polling every <ms>" << std::endl;
+    
+    // Server options
+    std::cout << std::endl << "Server Options:" << std::endl;
+    std::cout << "  -serve <socket_path> Serve requests on a Unix domain socket until SIGINT/SIGTERM" << std::endl;
+    std::cout << "  -queue <count>       Connections waiting for a worker before new ones get \"busy\" (default: 64)" << std::endl;
+    
+    std::cout << "  -quiet               Only print results (no progress messages)" << std::endl;
+    std::cout << "  -verbose             Print per-stage progress details" << std::endl;
+    std::cout << "  -log <level>         Progress verbosity: quiet, info (default) or debug" << std::endl;
     std::cout << "  -help                Show this help message" << std::endl;
     std::cout << std::endl;
     std::cout << "Examples:" << std::endl;
@@ -44,6 +82,7 @@ void printUsage(const char* programName) {
     std::cout << "  " << programName << " -i coins.jpg -coins -calibrate 100 150 quarter -coinsum" << std::endl;
     std::cout << "  " << programName << " -i coins.jpg -coins -ppmm 15.7 -coinsum -display" << std::endl;
     std::cout << "  " << programName << " -i objects.png -o results -shape -mincirc 0.5" << std::endl;
+    std::cout << "  " << programName << " -dir resources -threads 8 -coins -preset phone" << std::endl;
 }
 
 struct CalibrationPreset {
@@ -83,53 +122,59 @@ double getPresetCalibration(const std::string& presetName) {
     return -1.0;  // Not found
 }
 
-// Function to convert string to CoinType
-CoinType stringToCoinType(const std::string& coinStr) {
-    std::string lower = coinStr;
-    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-    
-    if (lower == "penny") return CoinType::PENNY;
-    if (lower == "nickel") return CoinType::NICKEL;
-    if (lower == "dime") return CoinType::DIME;
-    if (lower == "quarter") return CoinType::QUARTER;
-    return CoinType::UNKNOWN;
-}
-
+// Server stopped by SIGINT/SIGTERM
+static CoinServer* activeServer = nullptr;
 
+static void stopServer(int) {
+    if (activeServer) {
+        activeServer->stop();
+    }
+}
 
+// Print the stage timing table and write the trace file if one was requested
+void reportStageTimings(const std::string& tracePath, bool showTiming) {
+    StageTrace& trace = StageTrace::instance();
+    if (showTiming) {
+        trace.printSummary();
+    }
+    if (!tracePath.empty() && trace.writeChromeTrace(tracePath)) {
+        LOG_INFO << "Trace written: " << tracePath;
+    }
+}
 
 int main(int argc, char* argv[]) {
-    std::cout << "Coin Counter Test Program" << std::endl;
-    std::cout << "=========================" << std::endl;
-    
     // Parse command line arguments
+    ProcessingOptions options;
     std::string inputPath = "";
     std::string outputPath = "";
-    std::string configPath = "coins.cfg";
-    double minArea = 200.0;
-    double maxArea = 50000.0;
-    double minCircularity = 0.3;
-    double maxAspectRatio = 2.0;
-    bool enableAreaFilter = true;
-    bool enableShapeFilter = true;
-    int blockSize = 11;
-    double C = 2.0;
-    int kernelSize = 2;
-    int iterations = 1;
     bool display = false;
     bool showSummary = false;
     bool showHelp = false;
     
     // Coin detection parameters
-    bool enableCoins = false;
     bool showCoinSummary = false;
-    double pixelsPerMM = 12.0;  // defaulting to phone 
     std::string presetName = "";
-    bool doCalibration = false;
-    cv::Point calibrationPoint;
-    CoinType calibrationCoinType = CoinType::UNKNOWN;
     bool interactiveMode = false;
     
+    // Batch parameters
+    std::string batchDirectory = "";
+    std::string batchGlob = "";
+    std::string manifestPath = "";
+    std::string tarPath = "";
+    int threadCount = 0;
+    int watchIntervalMs = 0;  // 0 = don't watch the coin config
+    
+    // Server parameters
+    std::string socketPath = "";
+    int queueCapacity = 64;
+    int decoderCount = 0;  // 0 = workers load their own images
+    int writerCount = 1;
+    int pipelineDepth = 8;
+    
+    // Stage timing
+    std::string tracePath = "";
+    bool showTiming = false;
+    
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
         
@@ -140,27 +185,60 @@ int main(int argc, char* argv[]) {
         } else if (arg == "-o" && i + 1 < argc) {
             outputPath = argv[++i];
         } else if (arg == "-config" && i + 1 < argc) {
-            configPath = argv[++i];
+            options.configPath = argv[++i];
         } else if (arg == "-minarea" && i + 1 < argc) {
-            minArea = std::stod(argv[++i]);
+            options.minArea = std::stod(argv[++i]);
         } else if (arg == "-maxarea" && i + 1 < argc) {
-            maxArea = std::stod(argv[++i]);
+            options.maxArea = std::stod(argv[++i]);
         } else if (arg == "-mincirc" && i + 1 < argc) {
-            minCircularity = std::stod(argv[++i]);
+            options.minCircularity = std::stod(argv[++i]);
         } else if (arg == "-maxaspect" && i + 1 < argc) {
-            maxAspectRatio = std::stod(argv[++i]);
+            options.maxAspectRatio = std::stod(argv[++i]);
         } else if (arg == "-noarea") {
-            enableAreaFilter = false;
+            options.enableAreaFilter = false;
         } else if (arg == "-shape") {
-            enableShapeFilter = true;
+            options.enableShapeFilter = true;
+        } else if (arg == "-geometry" && i + 1 < argc) {
+            if (!ObjectCounter::parseGeometryMode(argv[++i], options.geometryMode)) {
+                std::cerr << "Error: Unknown geometry mode '" << argv[i] << "', expected exact or fast" << std::endl;
+                return 1;
+            }
         } else if (arg == "-b" && i + 1 < argc) {
-            blockSize = std::stoi(argv[++i]);
+            options.blockSize = std::stoi(argv[++i]);
+            if (!BinaryMaskEstimator::isValidBlockSize(options.blockSize)) {
+                std::cerr << "Error: Block size " << options.blockSize << " out of range, expected 3 to "
+                          << BoxThreshold::kMaxBlockSize << std::endl;
+                return 1;
+            }
         } else if (arg == "-c" && i + 1 < argc) {
-            C = std::stod(argv[++i]);
+            options.C = std::stod(argv[++i]);
+        } else if (arg == "-thresh" && i + 1 < argc) {
+            if (!BinaryMaskEstimator::parseThresholdMethod(argv[++i], options.thresholdMethod)) {
+                std::cerr << "Error: Unknown threshold method '" << argv[i] << "', expected gaussian or integral" << std::endl;
+                return 1;
+            }
         } else if (arg == "-k" && i + 1 < argc) {
-            kernelSize = std::stoi(argv[++i]);
+            options.kernelSize = std::stoi(argv[++i]);
         } else if (arg == "-iter" && i + 1 < argc) {
-            iterations = std::stoi(argv[++i]);
+            options.iterations = std::stoi(argv[++i]);
+        } else if (arg == "-morph" && i + 1 < argc) {
+            if (!BinaryMaskEstimator::parseMorphShape(argv[++i], options.morphShape)) {
+                std::cerr << "Error: Unknown morphology shape '" << argv[i] << "', expected ellipse, rect or octagon" << std::endl;
+                return 1;
+            }
+        } else if (arg == "-fastpre") {
+            options.fastPreprocessing = true;
+        } else if (arg == "-tiled") {
+            options.tiledExecution = true;
+        } else if (arg == "-tilesize" && i + 1 < argc) {
+            options.tiledExecution = true;
+            options.tileSize = std::stoi(argv[++i]);
+        } else if (arg == "-pyramid" && i + 1 < argc) {
+            options.pyramidLevels = std::stoi(argv[++i]);
+        } else if (arg == "-reduce" && i + 1 < argc) {
+            options.reduceMinCoinPixels = std::stod(argv[++i]);
+        } else if (arg == "-rle") {
+            options.runLengthMask = true;
         } else if (arg == "-display") {
             display = true;
         } else if (arg == "-summary") {
@@ -168,27 +246,65 @@ int main(int argc, char* argv[]) {
         }
         // Coin detection arguments
         else if (arg == "-coins") {
-            enableCoins = true;
+            options.enableCoins = true;
         } else if (arg == "-coinsum") {
             showCoinSummary = true;
         } else if (arg == "-ppmm" && i + 1 < argc) {
-            pixelsPerMM = std::stod(argv[++i]);
+            options.pixelsPerMM = std::stod(argv[++i]);
         } else if (arg == "-preset" && i + 1 < argc) {
             presetName = argv[++i];
-            enableCoins = true;  // Automatically enable coin detection
+            options.enableCoins = true;  // Automatically enable coin detection
         } else if (arg == "-calibrate" && i + 3 < argc) {
-            doCalibration = true;
-            calibrationPoint.x = std::stoi(argv[++i]);
-            calibrationPoint.y = std::stoi(argv[++i]);
-            calibrationCoinType = stringToCoinType(argv[++i]);
-            if (calibrationCoinType == CoinType::UNKNOWN) {
-                std::cerr << "Error: Unknown coin type for calibration: " << argv[i] << std::endl;
+            options.doCalibration = true;
+            options.calibrationPoint.x = std::stoi(argv[++i]);
+            options.calibrationPoint.y = std::stoi(argv[++i]);
+            options.calibrationCoin = argv[++i];
+            options.enableCoins = true;  // Automatically enable coin detection
+        } else if (arg == "-quiet") {
+            Logger::setLevel(LogLevel::QUIET);
+        } else if (arg == "-verbose") {
+            Logger::setLevel(LogLevel::DEBUG);
+        } else if (arg == "-log" && i + 1 < argc) {
+            LogLevel level;
+            if (!Logger::parseLevel(argv[++i], level)) {
+                std::cerr << "Error: Unknown log level '" << argv[i] << "', expected quiet, info or debug" << std::endl;
                 return 1;
             }
-            enableCoins = true;  // Automatically enable coin detection
+            Logger::setLevel(level);
+        } else if (arg == "-timing") {
+            showTiming = true;
+        } else if (arg == "-trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+            showTiming = true;
         } else if (arg == "-interactive") {
             interactiveMode = true;
-            enableCoins = true;  // Automatically enable coin detection
+            options.enableCoins = true;  // Automatically enable coin detection
+        }
+        // Batch arguments
+        else if (arg == "-dir" && i + 1 < argc) {
+            batchDirectory = argv[++i];
+        } else if (arg == "-glob" && i + 1 < argc) {
+            batchGlob = argv[++i];
+        } else if (arg == "-manifest" && i + 1 < argc) {
+            manifestPath = argv[++i];
+        } else if (arg == "-tar" && i + 1 < argc) {
+            tarPath = argv[++i];
+        } else if (arg == "-threads" && i + 1 < argc) {
+            threadCount = std::stoi(argv[++i]);
+        } else if (arg == "-watch" && i + 1 < argc) {
+            watchIntervalMs = std::stoi(argv[++i]);
+        } else if (arg == "-decoders" && i + 1 < argc) {
+            decoderCount = std::stoi(argv[++i]);
+        } else if (arg == "-writers" && i + 1 < argc) {
+            writerCount = std::stoi(argv[++i]);
+        } else if (arg == "-pipedepth" && i + 1 < argc) {
+            pipelineDepth = std::stoi(argv[++i]);
+        }
+        // Server arguments
+        else if (arg == "-serve" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "-queue" && i + 1 < argc) {
+            queueCapacity = std::stoi(argv[++i]);
         }
     }
     
@@ -203,111 +319,214 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
-    // Main processing
-    if (!inputPath.empty()) {
-        std::cout << "\n=== Processing Image ===" << std::endl;
-        std::cout << "Input: " << inputPath << std::endl;
-        std::cout << "Config for coins : " << configPath << std::endl;
+    // A server never finishes, so its trace would only grow until shutdown
+    if (!socketPath.empty() && !tracePath.empty()) {
+        std::cerr << "Error: -trace can't be combined with -serve; use -timing instead" << std::endl;
+        return 1;
+    }
+    
+    LOG_INFO << "Coin Counter Test Program\n=========================";
+    
+    // Handle preset calibration
+    if (!presetName.empty()) {
+        double presetValue = getPresetCalibration(presetName);
+        if (presetValue > 0) {
+            options.pixelsPerMM = presetValue;
+            LOG_INFO << "Using preset calibration '" << presetName << "': " 
+                     << options.pixelsPerMM << " pixels/mm";
+        } else {
+            std::cerr << "Error: Unknown preset '" << presetName << "'" << std::endl;
+            printPresets();
+            return 1;
+        }
+    }
+    
+    StageTrace::instance().setThreadName("main");
+    StageTrace::instance().setTracingEnabled(!tracePath.empty());
+    
+    // Calibration coins are resolved against the configured catalogue
+    if (options.doCalibration) {
+        CoinRegistry registry;
+        if (!registry.loadFromConfigList(options.configPath, false)) {
+            registry.loadDefaults(false);
+        }
+        if (registry.findByKey(options.calibrationCoin) == UNKNOWN_COIN) {
+            std::cerr << "Error: Unknown coin type for calibration: " << options.calibrationCoin << std::endl;
+            return 1;
+        }
+    }
+    
+    // Server mode: requests may pick any preset by name
+    if (!socketPath.empty()) {
+        CoinServer server(options, threadCount, static_cast<size_t>(std::max(1, queueCapacity)));
+        std::map<std::string, double> presets;
+        for (const auto& preset : getCalibrationPresets()) {
+            presets[preset.name] = preset.pixelsPerMM;
+        }
+        server.setPresets(presets);
         
-        //print the stats being used for the binary mask
-        std::cout << "=======================================================" << std::endl;
-        std::cout << "initializing binary mask with the following parameters " << std::endl;
-        std::cout << "=======================================================" << std::endl;
-        std::cout << "block size: " << blockSize << std::endl;
-        std::cout << "Adaptive threshold C: " << C << std::endl;
-        std::cout << "kernel size: " << kernelSize << std::endl;
-        std::cout << "# of iterations: " << iterations << std::endl;
-        // Create instances
-        BinaryMaskEstimator maskEstimator;
-        ObjectCounter counter(configPath);
-         
+        std::shared_ptr<CoinDatabase> database = std::make_shared<CoinDatabase>(options.configPath);
+        if (watchIntervalMs > 0) {
+            database->startWatching(watchIntervalMs);
+        }
+        server.setCoinDatabase(database);
         
-        // Configure mask estimator
-        maskEstimator.setAdaptiveThresholdParams(blockSize, C);
-        maskEstimator.setMorphologicalParams(kernelSize, iterations);
+        if (!server.start(socketPath)) {
+            return 1;
+        }
+        activeServer = &server;
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        server.run();
+        activeServer = nullptr;
         
-        // Configure object counter
-        counter.setAreaFilter(minArea, maxArea);
-        counter.setShapeFilter(minCircularity, maxAspectRatio);
-
-        std::cout << "\nConfiguration (Permissive for all coins):" << std::endl;
-        std::cout << "  Area filter: " << (enableAreaFilter ? "enabled" : "disabled");
-        if (enableAreaFilter) {
-            std::cout << " (min: " << minArea << ", max: " << maxArea << ")";
+        reportStageTimings(tracePath, showTiming);
+        return 0;
+    }
+    
+    // Batch processing
+    if (!batchDirectory.empty() || !batchGlob.empty() || !manifestPath.empty() || !tarPath.empty()) {
+        std::vector<ImageSource> sources;
+        if (!batchDirectory.empty()) {
+            sources = ImageSource::fromFiles(BatchProcessor::collectFromDirectory(batchDirectory));
+        } else if (!batchGlob.empty()) {
+            sources = ImageSource::fromFiles(BatchProcessor::collectFromGlob(batchGlob));
+        } else if (!manifestPath.empty()) {
+            sources = ImageSource::fromFiles(BatchProcessor::collectFromManifest(manifestPath));
+        } else {
+            sources = BatchProcessor::collectFromTar(tarPath);
         }
-        std::cout << std::endl;
-
-        counter.enableAreaFiltering(enableAreaFilter);
-        counter.enableShapeFiltering(enableShapeFilter);
-        counter.setCoinClassification(enableCoins);  // Fixed: use setCoinClassification instead
         
-        // Handle preset calibration
-        if (!presetName.empty()) {
-            double presetValue = getPresetCalibration(presetName);
-            if (presetValue > 0) {
-                pixelsPerMM = presetValue;
-                std::cout << "Using preset calibration '" << presetName << "': " 
-                          << pixelsPerMM << " pixels/mm" << std::endl;
-            } else {
-                std::cerr << "Error: Unknown preset '" << presetName << "'" << std::endl;
-                printPresets();
-                return 1;
-            }
+        if (sources.empty()) {
+            std::cerr << "No input images found for batch processing." << std::endl;
+            return 1;
         }
         
-        if (pixelsPerMM > 0) {
-            std::cout << "\n\nsetting to " << pixelsPerMM << std::endl;
-            counter.setPixelsPerMM(pixelsPerMM);
+        BatchProcessor batch(options, threadCount);
+        batch.setOutputDirectory(outputPath);
+        batch.setPipeline(decoderCount, writerCount, static_cast<size_t>(std::max(1, pipelineDepth)));
+        
+        std::shared_ptr<CoinDatabase> database = std::make_shared<CoinDatabase>(options.configPath);
+        if (watchIntervalMs > 0) {
+            database->startWatching(watchIntervalMs);
         }
+        batch.setCoinDatabase(database);
+        
+        BatchSummary summary = batch.run(sources);
+        BatchProcessor::printSummary(summary, showSummary);
+        reportStageTimings(tracePath, showTiming);
         
-        // Print configuration
-        std::cout << "\nConfiguration:" << std::endl;
-        std::cout << "  Area filter: " << (enableAreaFilter ? "enabled" : "disabled");
-        if (enableAreaFilter) {
-            std::cout << " (min: " << minArea << ", max: " << maxArea << ")";
+        return summary.imagesFailed > 0 ? 1 : 0;
+    }
+    
+    // Main processing
+    if (!inputPath.empty()) {
+        // Print the configuration once
+        if (Logger::isEnabled(LogLevel::INFO)) {
+            LogMessage message;
+            std::ostream& out = message.stream();
+            out << "\n=== Processing Image ===\n"
+                << "Input: " << inputPath << "\n"
+                << "Config for coins : " << options.configPath << "\n"
+                << "\nConfiguration:\n"
+                << "  Binary mask: block size " << options.blockSize
+                << ", C " << options.C
+                << ", " << BinaryMaskEstimator::thresholdMethodName(options.thresholdMethod) << " mean"
+                << ", kernel size " << options.kernelSize
+                << ", iterations " << options.iterations
+                << ", " << BinaryMaskEstimator::morphShapeName(options.morphShape) << " element\n"
+                << "  Preprocessing: " << (options.fastPreprocessing ? "fused" : "legacy")
+                << ", execution: ";
+            if (options.pyramidLevels > 0) {
+                out << "pyramid (" << options.pyramidLevels << " levels)";
+            } else {
+                out << (options.tiledExecution ? "tiled" : "full frame");
+            }
+            out << (options.runLengthMask ? ", run-length mask" : "") << "\n";
+            
+            out << "  Area filter: " << (options.enableAreaFilter ? "enabled" : "disabled");
+            if (options.enableAreaFilter) {
+                out << " (min: " << options.minArea << ", max: " << options.maxArea << ")";
+            }
+            out << "\n";
+            
+            out << "  Shape filter: " << (options.enableShapeFilter ? "enabled" : "disabled");
+            if (options.enableShapeFilter) {
+                out << " (min circularity: " << options.minCircularity 
+                    << ", max aspect ratio: " << options.maxAspectRatio << ")";
+            }
+            out << "\n";
+            out << "  Geometry: " << ObjectCounter::geometryModeName(options.geometryMode) << "\n";
+            
+            out << "  Coin detection: " << (options.enableCoins ? "enabled" : "disabled");
+            if (options.enableCoins && options.pixelsPerMM > 0) {
+                out << " (calibration: " << options.pixelsPerMM << " pixels/mm)";
+            }
         }
-        std::cout << std::endl;
         
-        std::cout << "  Shape filter: " << (enableShapeFilter ? "enabled" : "disabled");
-        if (enableShapeFilter) {
-            std::cout << " (min circularity: " << minCircularity 
-                      << ", max aspect ratio: " << maxAspectRatio << ")";
+        // Create instances
+        BinaryMaskEstimator maskEstimator;
+        ObjectCounter counter(options.configPath);
+        
+        // With a reduced decode every pixel-sized setting shrinks along with the image
+        int decodeScale = CoinWorker::chooseDecodeScale(options, counter.getSmallestCoinDiameter());
+        if (decodeScale > 1) {
+            LOG_INFO << "Decoding at 1/" << decodeScale << " size (smallest coin "
+                     << counter.getSmallestCoinDiameter() * options.pixelsPerMM / decodeScale << " pixels across)";
+            options = CoinWorker::scaledOptions(options, decodeScale);
         }
-        std::cout << std::endl;
         
-        std::cout << "  Coin detection: " << (enableCoins ? "enabled" : "disabled");
-        if (enableCoins && pixelsPerMM > 0) {
-            std::cout << " (calibration: " << pixelsPerMM << " pixels/mm)";
+        // Configure mask estimator
+        maskEstimator.setAdaptiveThresholdParams(options.blockSize, options.C);
+        maskEstimator.setThresholdMethod(options.thresholdMethod);
+        maskEstimator.setMorphologicalParams(options.kernelSize, options.iterations);
+        maskEstimator.setMorphShape(options.morphShape);
+        maskEstimator.setFastPreprocessing(options.fastPreprocessing);
+        maskEstimator.setTiledExecution(options.tiledExecution, options.tileSize);
+        maskEstimator.setPyramidLevels(options.pyramidLevels);
+        maskEstimator.setRunLengthOutput(options.runLengthMask);
+        maskEstimator.setMinComponentArea(options.minComponentArea);
+        
+        // Configure object counter
+        counter.setAreaFilter(options.minArea, options.maxArea);
+        counter.setShapeFilter(options.minCircularity, options.maxAspectRatio);
+        counter.enableAreaFiltering(options.enableAreaFilter);
+        counter.enableShapeFiltering(options.enableShapeFilter);
+        counter.setGeometryMode(options.geometryMode);
+        counter.setCoinClassification(options.enableCoins);
+        counter.setReportScale(decodeScale);
+        
+        if (options.pixelsPerMM > 0) {
+            counter.setPixelsPerMM(options.pixelsPerMM);
         }
-        std::cout << std::endl;
         
         // Step 1: Generate binary mask
-        std::cout << "\n=== Step 1: Generating Binary Mask ===" << std::endl;
-        if (!maskEstimator.loadImage(inputPath)) {
+        LOG_INFO << "\n=== Step 1: Generating Binary Mask ===";
+        bool loaded;
+        {
+            ScopedTimer timer("loadImage");
+            loaded = maskEstimator.loadImage(inputPath, decodeScale);
+        }
+        if (!loaded) {
             std::cerr << "Failed to load image: " << inputPath << std::endl;
             return 1;
         }
         
-        cv::Mat binaryMask = maskEstimator.estimateBinaryMask();
-        if (binaryMask.empty()) {
+        maskEstimator.estimateBinaryMaskShared();
+        if (!maskEstimator.hasMask()) {
             std::cerr << "Failed to generate binary mask!" << std::endl;
             return 1;
         }
         
-        // Step 2: Load into object counter
-        std::cout << "\n=== Step 2: Loading Image and Mask ===" << std::endl;
-        if (!counter.loadImage(inputPath)) {
-            std::cerr << "Failed to load image into counter!" << std::endl;
-            return 1;
-        }
-        
-        if (!counter.loadBinaryMask(binaryMask)) {
-            std::cerr << "Failed to load binary mask!" << std::endl;
+        // Step 2: Hand the decoded image and mask to the object counter (no re-decode, no copies)
+        LOG_INFO << "\n=== Step 2: Loading Image and Mask ===";
+        if (!counter.loadFromEstimator(maskEstimator)) {
+            std::cerr << "Failed to load image and mask into counter!" << std::endl;
             return 1;
         }
         
         // Step 3: Count objects
-        std::cout << "\n=== Step 3: Counting Objects ===" << std::endl;
+        LOG_INFO << "\n=== Step 3: Counting Objects ===";
         int objectCount = counter.countObjects();
         
         if (objectCount < 0) {
@@ -316,38 +535,37 @@ int main(int argc, char* argv[]) {
         }
         
         // Step 4: Handle calibration
-        if (interactiveMode && enableCoins) {
+        if (interactiveMode && options.enableCoins) {
             // Re-run classification after calibration
-            counter.countObjects();
-        } else if (doCalibration && enableCoins) {
-            std::cout << "\n=== Step 4: Calibration ===" << std::endl;
-            counter.calibrateWithKnownCoin(calibrationPoint, calibrationCoinType);
-            // Re-run classification after calibration
-            counter.countObjects();
+            counter.reclassify();
+        } else if (options.doCalibration && options.enableCoins) {
+            LOG_INFO << "\n=== Step 4: Calibration ===";
+            counter.calibrateWithKnownCoin(options.calibrationPoint, options.calibrationCoin);
+            // Re-run classification after calibration (detections are reused)
+            counter.reclassify();
         }
         
         // Step 5: Display results
-        std::cout << "\n=== Results ===" << std::endl;
+        std::cout << "\n=== Results ===" << '\n';
         std::string imageName = inputPath.substr(inputPath.find_last_of("/\\") + 1);
         
-        if (enableCoins) {
-            auto coinCounts = counter.getCoinCounts();
-            double totalValue = counter.getTotalValue();
-            std::cout << std::string(60, '=') << std::endl;
-            std::cout << "COIN DETECTION RESULTS" << std::endl;
-            std::cout << std::string(60, '=') << std::endl;
-            std::cout << ObjectCounter::generateCoinSummaryText(coinCounts, totalValue) << std::endl;
-            std::cout << std::string(60, '=') << std::endl;
+        if (options.enableCoins) {
+            auto totals = counter.getTotalValueByCurrency();
+            std::cout << std::string(60, '=') << '\n';
+            std::cout << "COIN DETECTION RESULTS" << '\n';
+            std::cout << std::string(60, '=') << '\n';
+            std::cout << ObjectCounter::generateCoinSummaryText(counter.getObjectCount(), totals) << '\n';
+            std::cout << std::string(60, '=') << '\n';
             
             if (showCoinSummary) {
                 counter.printCoinSummary();
             }
         } else {
-            std::cout << std::string(50, '=') << std::endl;
-            std::cout << "OBJECT DETECTION RESULTS" << std::endl;
-            std::cout << std::string(50, '=') << std::endl;
-            std::cout << ObjectCounter::generateSummaryText(objectCount, imageName) << std::endl;
-            std::cout << std::string(50, '=') << std::endl;
+            std::cout << std::string(50, '=') << '\n';
+            std::cout << "OBJECT DETECTION RESULTS" << '\n';
+            std::cout << std::string(50, '=') << '\n';
+            std::cout << ObjectCounter::generateSummaryText(objectCount, imageName) << '\n';
+            std::cout << std::string(50, '=') << '\n';
         }
         
         // Print detailed summary if requested
@@ -356,17 +574,20 @@ int main(int argc, char* argv[]) {
         }
         
         // Save results
-        if (!outputPath.empty()) {
-            counter.saveResults(outputPath);
-            size_t lastDot = outputPath.find_last_of(".");
-            std::string basePathNoExt = (lastDot != std::string::npos) ? outputPath.substr(0, lastDot) : outputPath;
-            //maskEstimator.saveImage(basePathNoExt + "_original_mask.png", binaryMask);
-        } else {
-            // Generate default output filename
-            size_t lastDot = inputPath.find_last_of(".");
-            std::string defaultOutput = inputPath.substr(0, lastDot) + "_results";
-            counter.saveResults(defaultOutput);
-            //maskEstimator.saveImage(defaultOutput + "_original_mask.png", binaryMask);
+        {
+            ScopedTimer timer("saveResults");
+            if (!outputPath.empty()) {
+                counter.saveResults(outputPath);
+                size_t lastDot = outputPath.find_last_of(".");
+                std::string basePathNoExt = (lastDot != std::string::npos) ? outputPath.substr(0, lastDot) : outputPath;
+                //maskEstimator.saveImage(basePathNoExt + "_original_mask.png", binaryMask);
+            } else {
+                // Generate default output filename
+                size_t lastDot = inputPath.find_last_of(".");
+                std::string defaultOutput = inputPath.substr(0, lastDot) + "_results";
+                counter.saveResults(defaultOutput);
+                //maskEstimator.saveImage(defaultOutput + "_original_mask.png", binaryMask);
+            }
         }
         
         // Display if requested
@@ -374,10 +595,12 @@ int main(int argc, char* argv[]) {
             counter.displayResults("Coin Detection Results");
         }
         
-        std::cout << "\nProcessing completed successfully!" << std::endl;
+        reportStageTimings(tracePath, showTiming);
         
+        LOG_INFO << "\nProcessing completed successfully!";
+    
     } else {
-        std::cerr << "No input image specified. Use -i <image_path>" << std::endl;
+        std::cerr << "No input image specified. Use -i <image_path> or -dir/-glob/-manifest" << std::endl;
         std::cerr << "Use -help to see all available options." << std::endl;
         return 1;
     }
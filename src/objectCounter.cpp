@@ -1,19 +1,34 @@
 #include "objectCounter.hh"
+#include "binaryMaskEstimator.hh"
+#include "componentLabeling.hh"
+#include "stageTimer.hh"
+#include "logger.hh"
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
+#include <limits>
+#include <utility>
+
+// Fewest objects a parallel stripe of feature extraction or classification gets
+static const int kMinObjectsPerStripe = 32;
 
 // Constructor
-ObjectCounter::ObjectCounter(std::string aConfigPath) 
+ObjectCounter::ObjectCounter(std::string aConfigPath, std::shared_ptr<CoinDatabase> database) 
     : minObjectArea(50.0), maxObjectArea(50000.0), minCircularity(0.3), 
       maxAspectRatio(3.0), useAreaFiltering(true), useShapeFiltering(false),
-      enableCoinClassification(false), pixelsPerMM(0.0),
-      configFilePath(aConfigPath)
+      geometryMode(GeometryMode::EXACT),
+      enableCoinClassification(false), pixelsPerMM(0.0), reportScale(1),
+      coinDatabase(database), configFilePath(aConfigPath), dirtyInputs(DIRTY_ALL)
 {
     // Default parameters work well for coins and similar circular objects
-    initializeCoinDatabase();
+    if (coinDatabase) {
+        coinRegistry = coinDatabase->snapshot();
+    } else {
+        initializeCoinDatabase();
+    }
 }
 
 // Destructor
@@ -23,166 +38,63 @@ ObjectCounter::~ObjectCounter() {
 
 // Initialize coin database with standard US coin specifications
 void ObjectCounter::initializeCoinDatabase() {
-    //all magic values that I just had to sit here and try ovr and over to work with
-    /*
-    coinDatabase[CoinType::PENNY] = {CoinType::PENNY, "Penny", 8.0, cv::Scalar(139, 69, 19)};      // Brown
-    coinDatabase[CoinType::NICKEL] = {CoinType::NICKEL, "Nickel", 9.0, cv::Scalar(192, 192, 192)};  // Silver
-    coinDatabase[CoinType::DIME] = {CoinType::DIME, "Dime", 7.56, cv::Scalar(211, 211, 211)};        // Light Silver
-    coinDatabase[CoinType::QUARTER] = {CoinType::QUARTER, "Quarter", 10.25, cv::Scalar(169, 169, 169)}; // Gray
-    */
     if (!loadCoinConfigFromFile(configFilePath)) 
     {
-        std::cout << "Config file not found or invalid, using default coin specifications." << std::endl;
+        LOG_INFO << "Config file not found or invalid, using default coin specifications.";
         loadDefaultCoinConfig();
     }
 }
 
+// Replace the coin catalogue with the denominations in configPath, which
+// may list several files separated by commas. The new catalogue is built
+// aside and swapped in; snapshots handed out earlier are never modified.
 bool ObjectCounter::loadCoinConfigFromFile(const std::string& configPath) 
 {
-    std::ifstream file(configPath);
-    if (!file.is_open()) {
-        std::cerr << "Warning: Could not open coin config file: " << configPath << std::endl;
-        return false;
-    }
-    
-    std::cout << "Loading coin configuration from: " << configPath << std::endl;
-    
-    coinDatabase.clear();
-    std::string line;
-    int lineNumber = 0;
-    
-    while (std::getline(file, line)) 
-    {
-        lineNumber++;
-        
-        // Skip empty lines and comments
-        if (line.empty() || line[0] == '#' || line[0] == ';') 
-        {
-            continue;
-        }
-        
-        // Parse line: TYPE,NAME,DIAMETER_MM,COLOR_BGR
-        // Example: PENNY,Penny,19.05,139:69:19
-        std::stringstream ss(line);
-        std::string typeStr, name, diameterStr, colorStr;
-        
-        if (!std::getline(ss, typeStr, ',') ||
-            !std::getline(ss, name, ',') ||
-            !std::getline(ss, diameterStr, ',') ||
-            !std::getline(ss, colorStr)) 
-        {
-            std::cerr << "Warning: Invalid format at line " << lineNumber 
-                      << " in config file: " << configPath << std::endl;
-            continue;
-        }
-        
-        // Convert type string to enum
-        CoinType coinType = stringToCoinType(typeStr);
-        if (coinType == CoinType::UNKNOWN) 
-        {
-            std::cerr << "Warning: Unknown coin type '" << typeStr 
-                      << "' at line " << lineNumber << std::endl;
-            continue;
-        }
-        
-        // Parse diameter
-        double diameter;
-        try 
-        {
-            diameter = std::stod(diameterStr);
-        } 
-        catch (const std::exception& e) 
-        {
-            std::cerr << "Warning: Invalid diameter '" << diameterStr 
-                      << "' at line " << lineNumber << std::endl;
-            continue;
-        }
-        
-        // Parse color
-        cv::Scalar color = parseColor(colorStr);
-        
-        // Add to database
-        coinDatabase[coinType] = {coinType, name, diameter, color};
-        std::cout << "  Loaded: " << name << " (diameter: " << diameter 
-                  << "mm, color: " << colorStr << ")" << std::endl;
-    }
-    
-    file.close();
-    
-    if (coinDatabase.empty()) 
-    {
-        std::cerr << "Error: No valid coin configurations loaded from file." << std::endl;
-        return false;
-    }
-    
-    std::cout << "Successfully loaded " << coinDatabase.size() 
-              << " coin configurations." << std::endl;
-    return true;
-}
-
-CoinType ObjectCounter::stringToCoinType(const std::string& coinStr) const 
-{
-    std::string lower = coinStr;
-    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-    
-    if (lower == "penny") return CoinType::PENNY;
-    if (lower == "nickel") return CoinType::NICKEL;
-    if (lower == "dime") return CoinType::DIME;
-    if (lower == "quarter") return CoinType::QUARTER;
-    
-    return CoinType::UNKNOWN;
-}
-
-cv::Scalar ObjectCounter::parseColor(const std::string& colorStr) const 
-{
-    cv::Scalar defaultColor(128, 128, 128); // Gray default
-    
-    // Expected format: "B:G:R" or "B,G,R"
-    std::string str = colorStr;
-    char delimiter = ':';
-    if (str.find(',') != std::string::npos) {
-        delimiter = ',';
-    }
-    
-    std::stringstream ss(str);
-    std::string bStr, gStr, rStr;
-    
-    if (std::getline(ss, bStr, delimiter) &&
-        std::getline(ss, gStr, delimiter) &&
-        std::getline(ss, rStr)) {
-        
-        try {
-            int b = std::stoi(bStr);
-            int g = std::stoi(gStr);
-            int r = std::stoi(rStr);
-            
-            // Clamp values to valid range
-            b = std::max(0, std::min(255, b));
-            g = std::max(0, std::min(255, g));
-            r = std::max(0, std::min(255, r));
-            
-            return cv::Scalar(b, g, r);
-        } catch (const std::exception& e) {
-            std::cerr << "Warning: Invalid color format '" << colorStr 
-                      << "', using default gray." << std::endl;
-        }
-    } else {
-        std::cerr << "Warning: Invalid color format '" << colorStr 
-                  << "', expected 'B:G:R' or 'B,G,R'." << std::endl;
-    }
-    
-    return defaultColor;
+    std::shared_ptr<CoinRegistry> registry = std::make_shared<CoinRegistry>();
+    bool loaded = registry->loadFromConfigList(configPath);
+    coinRegistry = registry;
+    return loaded;
 }
 
 // Public method to load/reload coin configuration
 bool ObjectCounter::loadCoinConfig(const std::string& configPath) {
     configFilePath = configPath;
+    coinDatabase.reset();
+    markDirty(DIRTY_CLASSIFICATION);
     return loadCoinConfigFromFile(configPath);
 }
 
 // Reload current configuration
 void ObjectCounter::reloadCoinConfig() {
+    if (coinDatabase) {
+        coinDatabase->reload();
+        refreshCoinSnapshot();
+        return;
+    }
     initializeCoinDatabase();
+    markDirty(DIRTY_CLASSIFICATION);
+}
+
+// Share a hot-reloadable catalogue with other counters
+void ObjectCounter::setCoinDatabase(std::shared_ptr<CoinDatabase> database) {
+    coinDatabase = database;
+    if (coinDatabase) {
+        configFilePath = coinDatabase->getConfigPaths();
+    }
+    refreshCoinSnapshot();
+}
+
+// Pick up the shared database's latest catalogue. Classification results
+// from the previous snapshot are redone if it changed.
+void ObjectCounter::refreshCoinSnapshot() {
+    if (!coinDatabase) {
+        return;
+    }
+    std::shared_ptr<const CoinRegistry> latest = coinDatabase->snapshot();
+    if (latest != coinRegistry) {
+        coinRegistry = latest;
+        markDirty(DIRTY_CLASSIFICATION);
+    }
 }
 
 // Get current config file path
@@ -193,37 +105,32 @@ std::string ObjectCounter::getConfigPath() const {
 // Load default coin configuration (fallback)
 void ObjectCounter::loadDefaultCoinConfig() 
 {
-    std::cout << "Loading default US coin specifications..." << std::endl;
-    
-    coinDatabase.clear();
-    
-    // Default US coin specifications (diameter in mm)
-    coinDatabase[CoinType::PENNY] = {CoinType::PENNY, "Penny", 19.05, cv::Scalar(139, 69, 19)};
-    coinDatabase[CoinType::NICKEL] = {CoinType::NICKEL, "Nickel", 21.21, cv::Scalar(192, 192, 192)};
-    coinDatabase[CoinType::DIME] = {CoinType::DIME, "Dime", 17.91, cv::Scalar(211, 211, 211)};
-    coinDatabase[CoinType::QUARTER] = {CoinType::QUARTER, "Quarter", 24.26, cv::Scalar(169, 169, 169)};
-    coinDatabase[CoinType::HALF_DOLLAR] = {CoinType::HALF_DOLLAR, "Half Dollar", 30.61, cv::Scalar(190, 190, 190)};
-    coinDatabase[CoinType::DOLLAR] = {CoinType::DOLLAR, "Dollar", 26.50, cv::Scalar(200, 200, 150)};
-    
-    std::cout << "Default coin database initialized with " << coinDatabase.size() 
-              << " coin types." << std::endl;
+    std::shared_ptr<CoinRegistry> registry = std::make_shared<CoinRegistry>();
+    registry->loadDefaults();
+    coinRegistry = registry;
 }
 
 // Load image from file path
 bool ObjectCounter::loadImage(const std::string& imagePath) {
-    inputImage = cv::imread(imagePath, cv::IMREAD_COLOR);
+    return loadImage(ImageSource::fromFile(imagePath));
+}
+
+// Load image from a mapped file or archive member
+bool ObjectCounter::loadImage(const ImageSource& source) {
+    inputImage = source.decode(cv::IMREAD_COLOR);
     
     if (inputImage.empty()) {
-        std::cerr << "Error: Could not load image from " << imagePath << std::endl;
+        std::cerr << "Error: Could not load image from " << source.getName() << std::endl;
         return false;
     }
     
-    std::cout << "Image loaded successfully: " << imagePath << std::endl;
+    LOG_DEBUG << "Image loaded successfully: " << source.getName();
     showImageInfo(inputImage, "Input Image");
     
     // Clear previous results
-    detectedObjects.clear();
     binaryMask = cv::Mat();
+    runMask.clear();
+    invalidateMask();
     
     return true;
 }
@@ -236,12 +143,13 @@ bool ObjectCounter::loadImage(const cv::Mat& image) {
     }
     
     inputImage = image.clone();
-    std::cout << "Image loaded successfully from cv::Mat" << std::endl;
+    LOG_DEBUG << "Image loaded successfully from cv::Mat";
     showImageInfo(inputImage, "Input Image");
     
     // Clear previous results
-    detectedObjects.clear();
     binaryMask = cv::Mat();
+    runMask.clear();
+    invalidateMask();
     
     return true;
 }
@@ -263,100 +171,449 @@ bool ObjectCounter::loadBinaryMask(const cv::Mat& mask) {
     // Ensure the mask is binary (0 or 255)
     cv::threshold(binaryMask, binaryMask, 127, 255, cv::THRESH_BINARY);
     
-    std::cout << "Binary mask loaded successfully" << std::endl;
+    LOG_DEBUG << "Binary mask loaded successfully";
     showImageInfo(binaryMask, "Binary Mask");
     
     // Clear previous object detection results
-    detectedObjects.clear();
+    runMask.clear();
+    invalidateMask();
+    
+    return true;
+}
+
+// Load a bit-packed binary mask, expanding it to the 0/255 plane contours are traced on
+bool ObjectCounter::loadBinaryMask(const BitMask& mask) {
+    if (mask.empty()) {
+        std::cerr << "Error: Binary mask is empty" << std::endl;
+        return false;
+    }
+    
+    // A fresh buffer, never one shared with the mask estimator
+    binaryMask = cv::Mat();
+    mask.unpack(binaryMask);
+    
+    LOG_DEBUG << "Binary mask loaded successfully (unpacked from bits)";
+    showImageInfo(binaryMask, "Binary Mask");
+    
+    // Clear previous object detection results
+    runMask.clear();
+    invalidateMask();
+    
+    return true;
+}
+
+// Load a run-length mask; no 0/255 plane is created
+bool ObjectCounter::loadRunLengthMask(const RunLengthMask& mask) {
+    if (mask.empty()) {
+        std::cerr << "Error: Binary mask is empty" << std::endl;
+        return false;
+    }
+    
+    runMask = mask;
+    binaryMask = cv::Mat();
+    LOG_DEBUG << "Binary mask loaded as " << runMask.runCount() << " runs";
+    
+    // Clear previous object detection results
+    invalidateMask();
+    
+    return true;
+}
+
+// Share an existing image without copying it
+bool ObjectCounter::adoptImage(const cv::Mat& image) {
+    if (image.empty()) {
+        std::cerr << "Error: Input image is empty" << std::endl;
+        return false;
+    }
+    
+    inputImage = image;
+    LOG_DEBUG << "Image adopted from cv::Mat (shared, not copied)";
+    showImageInfo(inputImage, "Input Image");
+    
+    // Clear previous results
+    binaryMask = cv::Mat();
+    runMask.clear();
+    invalidateMask();
+    
+    return true;
+}
+
+// Share an existing binary mask without copying it
+bool ObjectCounter::adoptBinaryMask(const cv::Mat& mask) {
+    if (mask.type() != CV_8UC1) {
+        return loadBinaryMask(mask);
+    }
+    
+    binaryMask = mask;
+    LOG_DEBUG << "Binary mask adopted (shared, not copied)";
+    showImageInfo(binaryMask, "Binary Mask");
+    
+    // Clear previous object detection results
+    runMask.clear();
+    invalidateMask();
+    
+    return true;
+}
+
+// Share the connected components of the current mask, so findContours can skip labeling
+bool ObjectCounter::adoptComponents(const cv::Mat& labels, const cv::Mat& stats, const cv::Mat& centroids) {
+    if (labels.type() != CV_32SC1 || labels.size() != binaryMask.size() ||
+        stats.type() != CV_32SC1 || stats.cols != 5 || centroids.rows != stats.rows) {
+        std::cerr << "Error: Component labels do not match the binary mask" << std::endl;
+        return false;
+    }
+    
+    componentLabels = labels;
+    componentStats = stats;
+    componentCentroids = centroids;
+    markDirty(DIRTY_MASK);
+    return true;
+}
+
+// Take the components of the current run-length mask: one label per run
+bool ObjectCounter::adoptRunComponents(const std::vector<int>& labels, const cv::Mat& stats,
+                                       const cv::Mat& centroids) {
+    if (labels.size() != runMask.runCount() ||
+        stats.type() != CV_32SC1 || stats.cols != 5 || centroids.rows != stats.rows) {
+        std::cerr << "Error: Component labels do not match the run-length mask" << std::endl;
+        return false;
+    }
+    
+    runLabels = labels;
+    componentStats = stats;
+    componentCentroids = centroids;
+    markDirty(DIRTY_MASK);
+    return true;
+}
+
+// Take the decoded image, estimated mask and its components straight from a mask estimator
+bool ObjectCounter::loadFromEstimator(const BinaryMaskEstimator& estimator) {
+    const cv::Mat& mask = estimator.getBinaryMaskRef();
+    if (!estimator.hasMask()) {
+        std::cerr << "Error: Mask estimator has no binary mask. Run estimateBinaryMask() first." << std::endl;
+        return false;
+    }
+    
+    if (mask.empty()) {
+        if (!adoptImage(estimator.getInputImageRef()) || !loadRunLengthMask(estimator.getRunMaskRef())) {
+            return false;
+        }
+        adoptRunComponents(estimator.getRunLabelsRef(), estimator.getComponentStatsRef(),
+                           estimator.getComponentCentroidsRef());
+        return true;
+    }
+    
+    if (!adoptImage(estimator.getInputImageRef()) || !adoptBinaryMask(mask)) {
+        return false;
+    }
     
+    if (!estimator.getComponentLabelsRef().empty()) {
+        adoptComponents(estimator.getComponentLabelsRef(), estimator.getComponentStatsRef(),
+                        estimator.getComponentCentroidsRef());
+    }
     return true;
 }
 
-// Main method to count objects
+// Drop everything derived from the mask
+void ObjectCounter::invalidateMask() {
+    candidateObjects.clear();
+    detectedObjects.clear();
+    componentLabels = cv::Mat();
+    componentStats = cv::Mat();
+    componentCentroids = cv::Mat();
+    runLabels.clear();
+    markDirty(DIRTY_MASK);
+}
+
+// Whether a mask is loaded, as a plane or as runs
+bool ObjectCounter::hasMask() const {
+    return !binaryMask.empty() || !runMask.empty();
+}
+
+cv::Size ObjectCounter::maskSize() const {
+    return runMask.empty() ? binaryMask.size() : cv::Size(runMask.cols(), runMask.rows());
+}
+
+// The mask as a 0/255 plane, painted from the runs if that's how it was loaded
+cv::Mat ObjectCounter::materializedMask() const {
+    if (runMask.empty()) {
+        return binaryMask;
+    }
+    cv::Mat painted;
+    runMask.paint(painted);
+    return painted;
+}
+
+// Paint one run-labeled component into a buffer the size of its bounding box
+void ObjectCounter::paintComponent(int label, const cv::Rect& boundingBox, cv::Mat& objectMask) const {
+    objectMask.setTo(0);
+    for (int y = boundingBox.y; y < boundingBox.y + boundingBox.height; y++) {
+        uchar* row = objectMask.ptr<uchar>(y - boundingBox.y);
+        for (int i = runMask.rowBegin(y); i < runMask.rowEnd(y); i++) {
+            if (runLabels[i] == label) {
+                const MaskRun& run = runMask.run(i);
+                std::fill(row + run.start - boundingBox.x, row + run.end - boundingBox.x, 255);
+            }
+        }
+    }
+}
+
+// Record that an input changed; the stages depending on it rerun on the next count
+void ObjectCounter::markDirty(unsigned int inputs) {
+    dirtyInputs |= inputs;
+}
+
+// Check whether any of the given inputs changed since the last count
+bool ObjectCounter::isDirty(unsigned int inputs) const {
+    return (dirtyInputs & inputs) != 0;
+}
+
+// Main method to count objects. Only the stages whose inputs changed since the
+// previous call are rerun:
+//   mask or area filter   -> findContours, analyzeObjects, classifyCoins
+//   shape filter          -> analyzeObjects, classifyCoins
+//   calibration/coin data -> classifyCoins
 int ObjectCounter::countObjects() {
     if (inputImage.empty()) {
         std::cerr << "Error: No input image loaded" << std::endl;
         return -1;
     }
     
-    if (binaryMask.empty()) {
+    if (!hasMask()) {
         std::cerr << "Error: No binary mask loaded. Please load a binary mask first." << std::endl;
         return -1;
     }
     
     // Verify that image and mask have compatible dimensions
-    if (inputImage.rows != binaryMask.rows || inputImage.cols != binaryMask.cols) {
+    if (inputImage.size() != maskSize()) {
         std::cerr << "Error: Input image and binary mask have different dimensions" << std::endl;
         std::cerr << "Image size: " << inputImage.cols << "x" << inputImage.rows << std::endl;
-        std::cerr << "Mask size: " << binaryMask.cols << "x" << binaryMask.rows << std::endl;
+        std::cerr << "Mask size: " << maskSize().width << "x" << maskSize().height << std::endl;
         return -1;
     }
     
-    std::cout << "Starting object counting process..." << std::endl;
+    // One catalogue snapshot for the whole image
+    refreshCoinSnapshot();
+    
+    if (dirtyInputs == 0) {
+        return static_cast<int>(detectedObjects.size());
+    }
+    
+    ScopedTimer timer("countObjects");
     
-    // Step 1: Find contours in the binary mask
-    findContours();
+    LOG_DEBUG << "Starting object counting process...";
+    
+    // Step 1: Find contours in the binary mask (area filter is applied here)
+    if (isDirty(DIRTY_MASK | DIRTY_AREA_FILTER)) {
+        findContours();
+        markDirty(DIRTY_SHAPE_FILTER);
+    }
     
     // Step 2: Analyze objects and filter based on criteria
-    analyzeObjects();
+    if (isDirty(DIRTY_SHAPE_FILTER)) {
+        analyzeObjects();
+        markDirty(DIRTY_CLASSIFICATION);
+    }
     
     // Step 3: Classify coins if enabled
-    if (enableCoinClassification) {
-        classifyCoins();
+    if (isDirty(DIRTY_CLASSIFICATION)) {
+        if (enableCoinClassification) {
+            classifyCoins();
+        } else {
+            clearClassification();
+        }
     }
     
+    dirtyInputs = 0;
+    
     int objectCount = static_cast<int>(detectedObjects.size());
-    std::cout << "Object counting completed. Found " << objectCount << " objects." << std::endl;
+    LOG_DEBUG << "Object counting completed. Found " << objectCount << " objects.";
     
     return objectCount;
 }
 
-// Find contours in the binary mask
+// Rerun only coin classification on the current detections, e.g. after a new
+// calibration. Falls back to a full count if the mask or filters changed.
+int ObjectCounter::reclassify() {
+    refreshCoinSnapshot();
+    if (isDirty(DIRTY_MASK | DIRTY_AREA_FILTER | DIRTY_SHAPE_FILTER)) {
+        return countObjects();
+    }
+    
+    if (enableCoinClassification) {
+        classifyCoins();
+    } else {
+        clearClassification();
+    }
+    dirtyInputs &= ~static_cast<unsigned int>(DIRTY_CLASSIFICATION);
+    
+    return static_cast<int>(detectedObjects.size());
+}
+
+// Reset coin fields when classification is switched off
+void ObjectCounter::clearClassification() {
+    std::fill(detectedObjects.coinType.begin(), detectedObjects.coinType.end(), UNKNOWN_COIN);
+    std::fill(detectedObjects.diameterMM.begin(), detectedObjects.diameterMM.end(), 0.0);
+    std::fill(detectedObjects.confidence.begin(), detectedObjects.confidence.end(), 0.0);
+}
+
+// Find objects in the binary mask. Area, bounding box, centroid and aspect
+// ratio come from the connected-component statistics, and the area filter is
+// applied on them; contours are only traced later, for the objects that
+// survive the cheap filters and only once something needs them.
 void ObjectCounter::findContours() {
-    std::vector<std::vector<cv::Point>> contours;
-    std::vector<cv::Vec4i> hierarchy;
+    ScopedTimer timer("candidates");
     
-    cv::findContours(binaryMask, contours, hierarchy, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    if (!runMask.empty()) {
+        if (componentStats.empty()) {
+            RunLengthMask filled;
+            ComponentLabeler::labelRuns(runMask, 0, filled, runLabels, componentStats, componentCentroids);
+            runMask = std::move(filled);
+        }
+    } else if (componentLabels.empty()) {
+        ComponentLabeler::labelFilled(binaryMask, 0, componentLabels, componentStats, componentCentroids);
+    }
     
-    std::cout << "Found " << contours.size() << " contours" << std::endl;
+    int componentCount = componentStats.rows - 1;  // Row 0 is the background
     
-    // Convert contours to ObjectInfo structures
-    detectedObjects.clear();
-    detectedObjects.reserve(contours.size());
-    
-    for (size_t i = 0; i < contours.size(); i++) {
-        ObjectInfo obj;
-        obj.id = static_cast<int>(i);
-        obj.contour = contours[i];
-        obj.area = cv::contourArea(contours[i]);
-        obj.boundingBox = cv::boundingRect(contours[i]);
-        
-        // Calculate center
-        cv::Moments moments = cv::moments(contours[i]);
-        if (moments.m00 != 0) {
-            obj.center.x = static_cast<float>(moments.m10 / moments.m00);
-            obj.center.y = static_cast<float>(moments.m01 / moments.m00);
-        } else {
-            obj.center.x = static_cast<float>(obj.boundingBox.x + obj.boundingBox.width / 2);
-            obj.center.y = static_cast<float>(obj.boundingBox.y + obj.boundingBox.height / 2);
+    candidateObjects.clear();
+    candidateObjects.reserve(componentCount, 0);
+    
+    for (int label = 1; label <= componentCount; label++) {
+        double area = componentStats.at<int>(label, cv::CC_STAT_AREA);
+        if (useAreaFiltering && (area < minObjectArea || area > maxObjectArea)) {
+            continue;
         }
         
-        // Calculate shape properties
-        obj.circularity = calculateCircularity(contours[i], obj.area);
-        obj.aspectRatio = calculateAspectRatio(obj.boundingBox);
+        cv::Rect boundingBox(componentStats.at<int>(label, cv::CC_STAT_LEFT),
+                             componentStats.at<int>(label, cv::CC_STAT_TOP),
+                             componentStats.at<int>(label, cv::CC_STAT_WIDTH),
+                             componentStats.at<int>(label, cv::CC_STAT_HEIGHT));
+        cv::Point2f center(static_cast<float>(componentCentroids.at<double>(label, 0)),
+                           static_cast<float>(componentCentroids.at<double>(label, 1)));
         
-        // Initialize coin-specific fields
-        obj.coinType = CoinType::UNKNOWN;
-        obj.diameter_pixels = calculateDiameter(contours[i]);
-        obj.estimated_diameter_mm = 0.0;
-        obj.confidence = 0.0;
+        size_t index = candidateObjects.add(label, area, center, boundingBox);
+        candidateObjects.aspectRatio[index] = calculateAspectRatio(boundingBox);
+    }
+    
+    LOG_DEBUG << "Found " << componentCount << " components, "
+              << candidateObjects.size() << " candidates";
+}
+
+// Compute the lazily evaluated features of the detections that aren't there
+// yet. Tracing and measuring run in parallel stripes on OpenCV's thread pool,
+// each writing its own slots, so the results don't depend on the thread count.
+void ObjectCounter::ensureFeatures(unsigned int features) const {
+    ObjectTable& objects = detectedObjects;
+    const bool fast = geometryMode == GeometryMode::FAST;
+    unsigned int missing = features & ~objects.computedFeatures;
+    if (!fast && (missing & (ObjectTable::FEATURE_CIRCULARITY | ObjectTable::FEATURE_DIAMETER))) {
+        missing |= ObjectTable::FEATURE_CONTOUR & ~objects.computedFeatures;
+    }
+    if (missing == 0) {
+        return;
+    }
+    
+    ScopedTimer timer("features");
+    const int count = static_cast<int>(objects.size());
+    const int stripes = featureStripes(count);
+    
+    if (missing & ObjectTable::FEATURE_CONTOUR) {
+        tracedContours.resize(count);
+        if (static_cast<int>(traceScratch.size()) < stripes) {
+            traceScratch.resize(stripes);
+        }
         
-        detectedObjects.push_back(obj);
+        cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range& range) {
+            for (int stripe = range.start; stripe < range.end; stripe++) {
+                int first = static_cast<int>(static_cast<long long>(count) * stripe / stripes);
+                int last = static_cast<int>(static_cast<long long>(count) * (stripe + 1) / stripes);
+                for (int i = first; i < last; i++) {
+                    traceComponent(objects.label[i], objects.boundingBox[i], traceScratch[stripe],
+                                   tracedContours[i]);
+                }
+            }
+        }, stripes);
+        
+        objects.setContours(tracedContours);
+    }
+    
+    const bool circularity = (missing & ObjectTable::FEATURE_CIRCULARITY) != 0;
+    const bool diameter = (missing & ObjectTable::FEATURE_DIAMETER) != 0;
+    if (circularity || diameter) {
+        cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; i++) {
+                if (fast) {
+                    double momentCircularity, momentDiameter;
+                    measureMoments(componentMoments(objects.label[i], objects.boundingBox[i]),
+                                   momentCircularity, momentDiameter);
+                    if (circularity) {
+                        objects.circularity[i] = momentCircularity;
+                    }
+                    if (diameter) {
+                        objects.diameterPixels[i] = momentDiameter;
+                    }
+                    continue;
+                }
+                
+                bool traced = objects.contourSize(i) > 0;
+                cv::Mat contour = objects.contourMat(i);
+                if (circularity) {
+                    objects.circularity[i] = traced ? calculateCircularity(contour, objects.area[i]) : 0.0;
+                }
+                if (diameter) {
+                    objects.diameterPixels[i] = traced ? calculateDiameter(contour) : 0.0;
+                }
+            }
+        }, stripes);
+    }
+    
+    objects.computedFeatures |= missing;
+    LOG_DEBUG << "Computed lazy features 0x" << std::hex << missing << std::dec
+              << " for " << count << " objects in " << stripes << " stripe(s)";
+}
+
+// Trace the outline of one component inside its bounding box. Called
+// concurrently: writes only the given scratch and contour.
+void ObjectCounter::traceComponent(int label, const cv::Rect& boundingBox, TraceScratch& scratch,
+                                   std::vector<cv::Point>& contour) const {
+    cv::Mat& maskBuffer = scratch.objectMask;
+    if (maskBuffer.rows < boundingBox.height || maskBuffer.cols < boundingBox.width) {
+        maskBuffer.create(std::max(maskBuffer.rows, boundingBox.height),
+                          std::max(maskBuffer.cols, boundingBox.width), CV_8UC1);
+    }
+    cv::Mat objectMask = maskBuffer(cv::Rect(0, 0, boundingBox.width, boundingBox.height));
+    if (runMask.empty()) {
+        cv::compare(componentLabels(boundingBox), label, objectMask, cv::CMP_EQ);
+    } else {
+        paintComponent(label, boundingBox, objectMask);
+    }
+    
+    std::vector<std::vector<cv::Point>>& contours = scratch.contours;
+    cv::findContours(objectMask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, boundingBox.tl());
+    
+    contour.clear();
+    if (contours.empty()) {
+        return;
     }
+    
+    size_t largest = 0;
+    for (size_t i = 1; i < contours.size(); i++) {
+        if (contours[i].size() > contours[largest].size()) {
+            largest = i;
+        }
+    }
+    contour.assign(contours[largest].begin(), contours[largest].end());
+}
+
+// Number of parallel stripes for a per-object loop. Follows OpenCV's thread
+// count, so a batch that pins OpenCV to one thread per worker stays serial here.
+int ObjectCounter::featureStripes(int objectCount) {
+    return std::max(1, std::min(cv::getNumThreads() * 4, objectCount / kMinObjectsPerStripe));
 }
 
 // Calculate diameter of a contour
-double ObjectCounter::calculateDiameter(const std::vector<cv::Point>& contour) {
+double ObjectCounter::calculateDiameter(cv::InputArray contour) {
     // Use minimum enclosing circle for diameter estimation
     cv::Point2f center;
     float radius;
@@ -364,59 +621,161 @@ double ObjectCounter::calculateDiameter(const std::vector<cv::Point>& contour) {
     return 2.0 * radius;
 }
 
-// Analyze objects and filter based on criteria
+// Spatial moments up to second order of one component's pixels (holes filled)
+cv::Moments ObjectCounter::componentMoments(int label, const cv::Rect& boundingBox) const {
+    double m00 = 0.0, m10 = 0.0, m01 = 0.0, m20 = 0.0, m11 = 0.0, m02 = 0.0;
+    
+    for (int y = boundingBox.y; y < boundingBox.y + boundingBox.height; y++) {
+        // Pixel count, sum of x and sum of x^2 of the component on this row
+        double count = 0.0, sumX = 0.0, sumXX = 0.0;
+        if (runMask.empty()) {
+            const int* row = componentLabels.ptr<int>(y);
+            for (int x = boundingBox.x; x < boundingBox.x + boundingBox.width; x++) {
+                if (row[x] == label) {
+                    count += 1.0;
+                    sumX += x;
+                    sumXX += static_cast<double>(x) * x;
+                }
+            }
+        } else {
+            // Closed form over each run [start, end)
+            for (int i = runMask.rowBegin(y); i < runMask.rowEnd(y); i++) {
+                if (runLabels[i] != label) {
+                    continue;
+                }
+                const MaskRun& run = runMask.run(i);
+                double first = run.start;
+                double last = run.end - 1;
+                double length = run.end - run.start;
+                count += length;
+                sumX += length * (first + last) / 2.0;
+                sumXX += (last * (last + 1) * (2 * last + 1) - (first - 1) * first * (2 * first - 1)) / 6.0;
+            }
+        }
+        
+        m00 += count;
+        m10 += sumX;
+        m01 += count * y;
+        m20 += sumXX;
+        m11 += sumX * y;
+        m02 += count * y * y;
+    }
+    
+    return cv::Moments(m00, m10, m01, m20, m11, m02, 0.0, 0.0, 0.0, 0.0);
+}
+
+// Circularity and diameter from second-order moments, for GeometryMode::FAST.
+// With l1 >= l2 the eigenvalues of the normalized central moment matrix:
+//  - diameter is the major axis of the ellipse with the same moments, 4 sqrt(l1);
+//    for a disk that is its diameter, and like minEnclosingCircle it follows the
+//    long side of an elongated blob
+//  - circularity is m00^2 / (2 pi (mu20 + mu02)): 1 for a disk, 2ab / (a^2 + b^2)
+//    for an ellipse with semi-axes a, b. It tracks elongation like the
+//    perimeter-based measure but is much less sensitive to ragged outlines
+//    (a square scores 0.95 instead of 0.79).
+void ObjectCounter::measureMoments(const cv::Moments& moments, double& circularity, double& diameter) {
+    circularity = 0.0;
+    diameter = 0.0;
+    if (moments.m00 <= 0.0) {
+        return;
+    }
+    
+    double spread = moments.mu20 + moments.mu02;
+    if (spread > 0.0) {
+        circularity = std::min(1.0, moments.m00 * moments.m00 / (2.0 * CV_PI * spread));
+    } else {
+        circularity = 1.0;  // A single pixel
+    }
+    
+    double a = moments.mu20 / moments.m00;
+    double b = moments.mu11 / moments.m00;
+    double c = moments.mu02 / moments.m00;
+    double l1 = (a + c) / 2.0 + std::sqrt(b * b + (a - c) * (a - c) / 4.0);
+    diameter = std::max(4.0 * std::sqrt(l1), 1.0);
+}
+
+// Analyze objects and filter based on criteria. The flags are computed in a
+// branch-free pass over the feature arrays, then the table is compacted in place.
 void ObjectCounter::analyzeObjects() {
-    std::vector<ObjectInfo> validObjects;
+    ScopedTimer timer("shapeFilter");
+    detectedObjects = candidateObjects;
+    
+    const bool checkArea = useAreaFiltering;
+    const bool checkShape = useShapeFiltering;
     
-    for (const auto& obj : detectedObjects) {
-        if (isValidObject(obj)) {
-            validObjects.push_back(obj);
+    // Cheap pass first: area and aspect ratio come from the component stats
+    {
+        const size_t count = detectedObjects.size();
+        const double* area = detectedObjects.area.data();
+        const double* aspectRatio = detectedObjects.aspectRatio.data();
+        
+        keepFlags.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            bool areaOk = (!checkArea) | ((area[i] >= minObjectArea) & (area[i] <= maxObjectArea));
+            bool aspectOk = (!checkShape) | (aspectRatio[i] <= maxAspectRatio);
+            keepFlags[i] = static_cast<unsigned char>(areaOk & aspectOk);
         }
+        detectedObjects.compact(keepFlags);
     }
     
-    // Update detected objects with only valid ones
-    detectedObjects = validObjects;
-    
-    // Reassign IDs
-    for (size_t i = 0; i < detectedObjects.size(); i++) {
-        detectedObjects[i].id = static_cast<int>(i);
+    // Circularity needs the contour, so only the survivors are traced
+    if (checkShape) {
+        ensureFeatures(ObjectTable::FEATURE_CIRCULARITY);
+        
+        const size_t count = detectedObjects.size();
+        const double* circularity = detectedObjects.circularity.data();
+        
+        keepFlags.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            keepFlags[i] = static_cast<unsigned char>(circularity[i] >= minCircularity);
+        }
+        detectedObjects.compact(keepFlags);
     }
     
-    std::cout << "After filtering: " << detectedObjects.size() << " valid objects" << std::endl;
+    LOG_DEBUG << "After filtering: " << detectedObjects.size() << " valid objects";
 }
 
 // Classify coins based on size
 void ObjectCounter::classifyCoins() {
+    ScopedTimer timer("classify");
+    
     if (pixelsPerMM <= 0.0) {
-        std::cout << "Warning: No calibration set. Cannot classify coins by size." << std::endl;
-        std::cout << "Use setPixelsPerMM() or calibrateWithKnownCoin() first." << std::endl;
+        std::cerr << "Warning: No calibration set. Cannot classify coins by size." << std::endl;
+        std::cerr << "Use setPixelsPerMM() or calibrateWithKnownCoin() first." << std::endl;
         return;
     }
     
-    std::cout << "Classifying coins using calibration: " << pixelsPerMM << " pixels per mm" << std::endl;
+    LOG_DEBUG << "Classifying coins using calibration: " << pixelsPerMM << " pixels per mm";
+    ensureFeatures(ObjectTable::FEATURE_DIAMETER);
     
-    for (auto& obj : detectedObjects) {
-        // Convert pixel diameter to millimeters
-        obj.estimated_diameter_mm = obj.diameter_pixels / pixelsPerMM;
-        
-        // Classify based on size
-        obj.coinType = classifyBySize(obj.estimated_diameter_mm, obj.confidence);
+    const size_t count = detectedObjects.size();
+    const double* diameterPixels = detectedObjects.diameterPixels.data();
+    double* diameterMM = detectedObjects.diameterMM.data();
+    
+    // Convert pixel diameters to millimeters
+    const double mmPerPixel = 1.0 / pixelsPerMM;
+    for (size_t i = 0; i < count; i++) {
+        diameterMM[i] = diameterPixels[i] * mmPerPixel;
     }
+    
+    // Classify based on size; every object writes only its own slots
+    CoinType* coinType = detectedObjects.coinType.data();
+    double* confidence = detectedObjects.confidence.data();
+    const int objects = static_cast<int>(count);
+    cv::parallel_for_(cv::Range(0, objects), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            coinType[i] = classifyBySize(diameterMM[i], confidence[i]);
+        }
+    }, featureStripes(objects));
 }
 
 // Classify coin by size with confidence score
 CoinType ObjectCounter::classifyBySize(double diameter_mm, double& confidence) {
-    CoinType bestMatch = CoinType::UNKNOWN;
-    double smallestDifference = std::numeric_limits<double>::max();
-    
-    for (const auto& pair : coinDatabase) {
-        const CoinInfo& coinInfo = pair.second;
-        double difference = std::abs(diameter_mm - coinInfo.diameter_mm);
-        
-        if (difference < smallestDifference) {
-            smallestDifference = difference;
-            bestMatch = coinInfo.type;
-        }
+    double smallestDifference;
+    CoinType bestMatch = coinRegistry->nearestByDiameter(diameter_mm, smallestDifference);
+    if (bestMatch == UNKNOWN_COIN) {
+        confidence = 0.0;
+        return UNKNOWN_COIN;
     }
     
     // Calculate confidence based on how close the size match is
@@ -426,14 +785,14 @@ CoinType ObjectCounter::classifyBySize(double diameter_mm, double& confidence) {
     
     // Only classify if confidence is above threshold
     if (confidence < 0.3) {
-        return CoinType::UNKNOWN;
+        return UNKNOWN_COIN;
     }
     
     return bestMatch;
 }
 
 // Calculate circularity (4π * area / perimeter²)
-double ObjectCounter::calculateCircularity(const std::vector<cv::Point>& contour, double area) {
+double ObjectCounter::calculateCircularity(cv::InputArray contour, double area) {
     double perimeter = cv::arcLength(contour, true);
     if (perimeter == 0) return 0.0;
     
@@ -446,68 +805,62 @@ double ObjectCounter::calculateAspectRatio(const cv::Rect& boundingBox) {
     return static_cast<double>(boundingBox.width) / static_cast<double>(boundingBox.height);
 }
 
-// Check if object meets filtering criteria
-bool ObjectCounter::isValidObject(const ObjectInfo& obj) {
-    // Area filtering
-    if (useAreaFiltering) {
-        if (obj.area < minObjectArea || obj.area > maxObjectArea) {
-            return false;
-        }
-    }
-    
-    // Shape filtering
-    if (useShapeFiltering) {
-        if (obj.circularity < minCircularity || obj.aspectRatio > maxAspectRatio) {
-            return false;
-        }
-    }
-    
-    return true;
-}
-
 // Draw annotations on the image
 void ObjectCounter::drawObjectAnnotations(cv::Mat& image) {
-    for (size_t i = 0; i < detectedObjects.size(); i++) {
-        const ObjectInfo& obj = detectedObjects[i];
+    ensureFeatures(ObjectTable::FEATURE_CONTOUR);
+    const ObjectTable& objects = detectedObjects;
+    std::vector<cv::Point> scaledContour;
+    
+    for (size_t i = 0; i < objects.size(); i++) {
+        CoinType coinType = objects.coinType[i];
+        const cv::Point2f center = objects.center[i] * static_cast<float>(reportScale);
         
         // Choose color based on coin type if coin classification is enabled
         cv::Scalar color = cv::Scalar(0, 255, 0); // Default green
-        if (enableCoinClassification && obj.coinType != CoinType::UNKNOWN) {
-            color = getCoinColor(obj.coinType);
+        if (enableCoinClassification && coinType != UNKNOWN_COIN) {
+            color = getCoinColor(coinType);
         }
         
-        // Draw contour
-        std::vector<std::vector<cv::Point>> contours = {obj.contour};
-        cv::drawContours(image, contours, -1, color, 2);
+        // Draw contour straight from the shared point buffer
+        const cv::Point* points = objects.contourData(i);
+        int pointCount = objects.contourSize(i);
+        if (reportScale > 1) {
+            scaledContour.assign(points, points + pointCount);
+            for (cv::Point& point : scaledContour) {
+                point *= reportScale;
+            }
+            points = scaledContour.data();
+        }
+        if (pointCount > 0) {
+            cv::polylines(image, &points, &pointCount, 1, true, color, 2);
+        }
         
         // Draw bounding box
-        cv::rectangle(image, obj.boundingBox, cv::Scalar(255, 0, 0), 1);
+        cv::rectangle(image, scaleRect(objects.boundingBox[i]), cv::Scalar(255, 0, 0), 1);
         
         // Draw center point
-        cv::circle(image, obj.center, 3, cv::Scalar(0, 0, 255), -1);
+        cv::circle(image, center, 3, cv::Scalar(0, 0, 255), -1);
         
         // Draw label
         std::string label;
-        if (enableCoinClassification && obj.coinType != CoinType::UNKNOWN) {
-            label = coinTypeToString(obj.coinType);
-            if (obj.confidence > 0) {
-                label += " (" + std::to_string(static_cast<int>(obj.confidence * 100)) + "%)";
+        if (enableCoinClassification && coinType != UNKNOWN_COIN) {
+            label = coinTypeToString(coinType);
+            if (objects.confidence[i] > 0) {
+                label += " (" + std::to_string(static_cast<int>(objects.confidence[i] * 100)) + "%)";
             }
         } else {
             label = std::to_string(i + 1);
         }
         
-        cv::putText(image, label, cv::Point(obj.center.x - 10, obj.center.y - 10),
+        cv::putText(image, label, cv::Point(center.x - 10, center.y - 10),
                    cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 0), 1);
     }
     
     // Draw summary text
     std::string summary;
     if (enableCoinClassification) {
-        auto coinCounts = getCoinCounts();
-        double totalValue = getTotalValue();
-        summary = "Coins: " + std::to_string(detectedObjects.size()) + 
-                 ", Value: $" + std::to_string(totalValue).substr(0, std::to_string(totalValue).find('.') + 3);
+        summary = "Coins: " + std::to_string(detectedObjects.size()) + ", Value: "
+                + CoinRegistry::formatTotals(getTotalValueByCurrency());
     } else {
         summary = "Objects detected: " + std::to_string(detectedObjects.size());
     }
@@ -518,31 +871,61 @@ void ObjectCounter::drawObjectAnnotations(cv::Mat& image) {
 
 // Convert coin type to string
 std::string ObjectCounter::coinTypeToString(CoinType type) const {
-    auto it = coinDatabase.find(type);
-    if (it != coinDatabase.end()) {
-        return it->second.name;
+    const CoinInfo* info = coinRegistry->find(type);
+    if (info) {
+        return info->name;
     }
     return "Unknown";
 }
 
+// Get display name for coin type
+std::string ObjectCounter::getCoinName(CoinType type) const {
+    return coinTypeToString(type);
+}
+
+// Resolve a coin key or name from the loaded catalogue (UNKNOWN_COIN if absent)
+CoinType ObjectCounter::findCoinType(const std::string& keyOrName) const {
+    return coinRegistry->findByKey(keyOrName);
+}
+
+// Get the loaded coin catalogue
+const CoinRegistry& ObjectCounter::getCoinRegistry() const {
+    return *coinRegistry;
+}
+
+// Smallest coin of the catalogue; with a database its latest snapshot, since
+// the counter only picks that up at the next image
+double ObjectCounter::getSmallestCoinDiameter() const {
+    if (coinDatabase) {
+        return coinDatabase->snapshot()->smallestDiameter();
+    }
+    return coinRegistry->smallestDiameter();
+}
+
 // Get color for coin type
 cv::Scalar ObjectCounter::getCoinColor(CoinType type) const {
-    auto it = coinDatabase.find(type);
-    if (it != coinDatabase.end()) {
-        return it->second.color;
+    const CoinInfo* info = coinRegistry->find(type);
+    if (info) {
+        return info->color;
     }
     return cv::Scalar(128, 128, 128); // Gray for unknown
 }
 
 // Enable/disable coin classification
 void ObjectCounter::setCoinClassification(bool enable) {
+    if (enable != enableCoinClassification) {
+        markDirty(DIRTY_CLASSIFICATION);
+    }
     this->enableCoinClassification = enable;
 }
 
 // Set pixels per millimeter for calibration
 void ObjectCounter::setPixelsPerMM(double pixelsPerMM) {
+    if (pixelsPerMM != this->pixelsPerMM) {
+        markDirty(DIRTY_CLASSIFICATION);
+    }
     this->pixelsPerMM = pixelsPerMM;
-    std::cout << "Calibration set: " << pixelsPerMM << " pixels per millimeter" << std::endl;
+    LOG_DEBUG << "Calibration set: " << pixelsPerMM << " pixels per millimeter";
 }
 
 // Calibrate using a known coin at specified position
@@ -552,37 +935,45 @@ void ObjectCounter::calibrateWithKnownCoin(const cv::Point& coinCenter, CoinType
         return;
     }
     
-    auto it = coinDatabase.find(knownType);
-    if (it == coinDatabase.end()) {
+    const CoinInfo* knownCoin = coinRegistry->find(knownType);
+    if (!knownCoin) {
         std::cerr << "Error: Unknown coin type for calibration" << std::endl;
         return;
     }
     
     // Find the closest object to the specified point
     double minDistance = std::numeric_limits<double>::max();
-    const ObjectInfo* closestObject = nullptr;
+    size_t closestObject = 0;
     
-    for (const auto& obj : detectedObjects) {
-        double distance = cv::norm(cv::Point2f(coinCenter) - obj.center);
+    for (size_t i = 0; i < detectedObjects.size(); i++) {
+        double distance = cv::norm(cv::Point2f(coinCenter) - detectedObjects.center[i]);
         if (distance < minDistance) {
             minDistance = distance;
-            closestObject = &obj;
+            closestObject = i;
         }
     }
     
-    if (closestObject == nullptr) {
-        std::cerr << "Error: No object found near calibration point" << std::endl;
+    // Calculate pixels per mm based on known coin
+    ensureFeatures(ObjectTable::FEATURE_DIAMETER);
+    double knownDiameterMM = knownCoin->diameter_mm;
+    double measuredDiameter = detectedObjects.diameterPixels[closestObject];
+    pixelsPerMM = measuredDiameter / knownDiameterMM;
+    markDirty(DIRTY_CLASSIFICATION);
+    
+    LOG_INFO << "Calibration completed using " << coinTypeToString(knownType) << "\n"
+             << "Measured diameter: " << measuredDiameter << " pixels\n"
+             << "Known diameter: " << knownDiameterMM << " mm\n"
+             << "Calibration: " << pixelsPerMM << " pixels per mm";
+}
+
+// Calibrate using a known coin given by config key or name
+void ObjectCounter::calibrateWithKnownCoin(const cv::Point& coinCenter, const std::string& knownCoin) {
+    CoinType knownType = findCoinType(knownCoin);
+    if (knownType == UNKNOWN_COIN) {
+        std::cerr << "Error: Unknown coin type for calibration: " << knownCoin << std::endl;
         return;
     }
-    
-    // Calculate pixels per mm based on known coin
-    double knownDiameterMM = it->second.diameter_mm;
-    pixelsPerMM = closestObject->diameter_pixels / knownDiameterMM;
-    
-    std::cout << "Calibration completed using " << coinTypeToString(knownType) << std::endl;
-    std::cout << "Measured diameter: " << closestObject->diameter_pixels << " pixels" << std::endl;
-    std::cout << "Known diameter: " << knownDiameterMM << " mm" << std::endl;
-    std::cout << "Calibration: " << pixelsPerMM << " pixels per mm" << std::endl;
+    calibrateWithKnownCoin(coinCenter, knownType);
 }
 
 // Get count of each coin type
@@ -590,110 +981,171 @@ std::map<CoinType, int> ObjectCounter::getCoinCounts() const {
     std::map<CoinType, int> counts;
     
     // Initialize all coin types to 0
-    for (const auto& pair : coinDatabase) {
-        counts[pair.first] = 0;
+    const std::vector<CoinInfo>& coins = coinRegistry->getCoins();
+    for (size_t i = 1; i < coins.size(); i++) {
+        counts[coins[i].type] = 0;
     }
-    counts[CoinType::UNKNOWN] = 0;
+    counts[UNKNOWN_COIN] = 0;
     
     // Count detected coins
-    for (const auto& obj : detectedObjects) {
-        counts[obj.coinType]++;
+    for (CoinType type : detectedObjects.coinType) {
+        counts[type]++;
     }
     
     return counts;
 }
 
-// Calculate total monetary value
-double ObjectCounter::getTotalValue() const {
-    double total = 0.0;
-    
-    for (const auto& obj : detectedObjects) {
-        switch (obj.coinType) {
-            case CoinType::PENNY: total += 0.01; break;
-            case CoinType::NICKEL: total += 0.05; break;
-            case CoinType::DIME: total += 0.10; break;
-            case CoinType::QUARTER: total += 0.25; break;
-            case CoinType::HALF_DOLLAR: total += 0.50; break;
-            case CoinType::DOLLAR: total += 1.00; break;
-            default: break; // Unknown coins don't add value
+// Calculate total monetary value per currency (unknown coins don't add value).
+// Amounts in different currencies are never added together.
+std::map<std::string, double> ObjectCounter::getTotalValueByCurrency() const {
+    std::map<std::string, double> totals;
+    
+    for (CoinType type : detectedObjects.coinType) {
+        const CoinInfo* info = coinRegistry->find(type);
+        if (info) {
+            totals[info->currency] += info->value;
         }
     }
     
-    return total;
+    return totals;
 }
 
 // Print coin summary
 void ObjectCounter::printCoinSummary() const {
-    std::cout << "\n=== Coin Detection Summary ===" << std::endl;
+    std::cout << "\n=== Coin Detection Summary ===" << '\n';
     
     auto coinCounts = getCoinCounts();
-    double totalValue = getTotalValue();
+    auto totals = getTotalValueByCurrency();
     
-    std::cout << "Coin breakdown:" << std::endl;
-    for (const auto& pair : coinDatabase) {
-        CoinType type = pair.first;
-        const CoinInfo& info = pair.second;
-        int count = coinCounts[type];
+    std::cout << "Coin breakdown:" << '\n';
+    const std::vector<CoinInfo>& coins = coinRegistry->getCoins();
+    for (size_t i = 1; i < coins.size(); i++) {
+        const CoinInfo& info = coins[i];
+        int count = coinCounts[info.type];
         
         if (count > 0) {
-            double value = 0.0;
-            switch (type) {
-                case CoinType::PENNY: value = count * 0.01; break;
-                case CoinType::NICKEL: value = count * 0.05; break;
-                case CoinType::DIME: value = count * 0.10; break;
-                case CoinType::QUARTER: value = count * 0.25; break;
-                case CoinType::HALF_DOLLAR: value = count * 0.50; break;
-                case CoinType::DOLLAR: value = count * 1.00; break;
-            }
-            
             std::cout << "  " << info.name << ": " << count 
-                      << " ($" << std::fixed << std::setprecision(2) << value << ")" << std::endl;
+                      << " (" << CoinRegistry::formatValue(count * info.value, info.currency) << ")" << '\n';
         }
     }
     
-    if (coinCounts[CoinType::UNKNOWN] > 0) {
-        std::cout << "  Unknown: " << coinCounts[CoinType::UNKNOWN] << " ($0.00)" << std::endl;
+    if (coinCounts[UNKNOWN_COIN] > 0) {
+        std::cout << "  Unknown: " << coinCounts[UNKNOWN_COIN] << '\n';
     }
     
-    std::cout << "Total coins: " << detectedObjects.size() << std::endl;
-    std::cout << "Total value: $" << std::fixed << std::setprecision(2) << totalValue << std::endl;
-    std::cout << "===============================" << std::endl;
+    std::cout << "Total coins: " << detectedObjects.size() << '\n';
+    if (totals.empty()) {
+        std::cout << "Total value: " << CoinRegistry::formatValue(0.0, "") << '\n';
+    }
+    for (const auto& total : totals) {
+        std::cout << "Total value: " << CoinRegistry::formatValue(total.second, total.first) << '\n';
+    }
+    std::cout << "===============================" << '\n';
 }
 
 // Set area filter parameters
 void ObjectCounter::setAreaFilter(double minArea, double maxArea) {
+    if (minArea != minObjectArea || maxArea != maxObjectArea) {
+        markDirty(DIRTY_AREA_FILTER);
+    }
     this->minObjectArea = minArea;
     this->maxObjectArea = maxArea;
 }
 
 // Set shape filter parameters
 void ObjectCounter::setShapeFilter(double minCircularity, double maxAspectRatio) {
+    if (minCircularity != this->minCircularity || maxAspectRatio != this->maxAspectRatio) {
+        markDirty(DIRTY_SHAPE_FILTER);
+    }
     this->minCircularity = minCircularity;
     this->maxAspectRatio = maxAspectRatio;
 }
 
 // Enable/disable area filtering
 void ObjectCounter::enableAreaFiltering(bool enable) {
+    if (enable != useAreaFiltering) {
+        markDirty(DIRTY_AREA_FILTER);
+    }
     this->useAreaFiltering = enable;
 }
 
 // Enable/disable shape filtering
 void ObjectCounter::enableShapeFiltering(bool enable) {
+    if (enable != useShapeFiltering) {
+        markDirty(DIRTY_SHAPE_FILTER);
+    }
     this->useShapeFiltering = enable;
 }
 
+// Select exact (contour) or fast (moment) geometry
+void ObjectCounter::setGeometryMode(GeometryMode mode) {
+    if (mode == geometryMode) {
+        return;
+    }
+    geometryMode = mode;
+    
+    // Features measured the other way are stale; circularity feeds the shape filter
+    detectedObjects.computedFeatures &= ~static_cast<unsigned int>(ObjectTable::FEATURE_CIRCULARITY |
+                                                                  ObjectTable::FEATURE_DIAMETER);
+    markDirty(DIRTY_SHAPE_FILTER);
+}
+
+GeometryMode ObjectCounter::getGeometryMode() const {
+    return geometryMode;
+}
+
+// Parse a geometry mode name from the command line
+bool ObjectCounter::parseGeometryMode(const std::string& name, GeometryMode& mode) {
+    if (name == "exact") {
+        mode = GeometryMode::EXACT;
+    } else if (name == "fast") {
+        mode = GeometryMode::FAST;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Command-line name of a geometry mode
+const char* ObjectCounter::geometryModeName(GeometryMode mode) {
+    return mode == GeometryMode::FAST ? "fast" : "exact";
+}
+
 // Get object information
 std::vector<ObjectInfo> ObjectCounter::getObjectInfo() const {
+    ensureFeatures(ObjectTable::FEATURE_ALL);
+    std::vector<ObjectInfo> objects;
+    objects.reserve(detectedObjects.size());
+    for (size_t i = 0; i < detectedObjects.size(); i++) {
+        objects.push_back(detectedObjects.toObjectInfo(i));
+        if (reportScale > 1) {
+            ObjectInfo& obj = objects.back();
+            obj.area *= reportScale * reportScale;
+            obj.center *= static_cast<float>(reportScale);
+            obj.boundingBox = scaleRect(obj.boundingBox);
+            for (cv::Point& point : obj.contour) {
+                point *= reportScale;
+            }
+            obj.diameter_pixels *= reportScale;
+        }
+    }
+    return objects;
+}
+
+// Get the object table without copying it, with every lazy feature filled in
+const ObjectTable& ObjectCounter::getObjectTable() const {
+    ensureFeatures(ObjectTable::FEATURE_ALL);
     return detectedObjects;
 }
 
 // Print object summary
 void ObjectCounter::printObjectSummary() const {
-    std::cout << "\n=== Object Detection Summary ===" << std::endl;
-    std::cout << "Total objects detected: " << detectedObjects.size() << std::endl;
+    std::cout << "\n=== Object Detection Summary ===" << '\n';
+    std::cout << "Total objects detected: " << detectedObjects.size() << '\n';
     
     if (!detectedObjects.empty()) {
-        std::cout << "\nObject Details:" << std::endl;
+        ensureFeatures(ObjectTable::FEATURE_CIRCULARITY);
+        std::cout << "\nObject Details:" << '\n';
         std::cout << std::setw(4) << "ID" << std::setw(10) << "Area" 
                   << std::setw(12) << "Center X" << std::setw(12) << "Center Y"
                   << std::setw(12) << "Circularity" << std::setw(12) << "Aspect Ratio";
@@ -701,49 +1153,52 @@ void ObjectCounter::printObjectSummary() const {
         if (enableCoinClassification) {
             std::cout << std::setw(12) << "Coin Type" << std::setw(12) << "Diameter(mm)" << std::setw(10) << "Confidence";
         }
-        std::cout << std::endl;
+        std::cout << '\n';
         
         int lineWidth = enableCoinClassification ? 104 : 70;
-        std::cout << std::string(lineWidth, '-') << std::endl;
+        std::cout << std::string(lineWidth, '-') << '\n';
         
-        for (const auto& obj : detectedObjects) {
-            std::cout << std::setw(4) << (obj.id + 1)
-                      << std::setw(10) << std::fixed << std::setprecision(1) << obj.area
-                      << std::setw(12) << std::fixed << std::setprecision(1) << obj.center.x
-                      << std::setw(12) << std::fixed << std::setprecision(1) << obj.center.y
-                      << std::setw(12) << std::fixed << std::setprecision(3) << obj.circularity
-                      << std::setw(12) << std::fixed << std::setprecision(2) << obj.aspectRatio;
+        // Pixel geometry is reported at the full image size
+        const ObjectTable& objects = detectedObjects;
+        const double areaScale = static_cast<double>(reportScale) * reportScale;
+        for (size_t i = 0; i < objects.size(); i++) {
+            std::cout << std::setw(4) << (i + 1)
+                      << std::setw(10) << std::fixed << std::setprecision(1) << objects.area[i] * areaScale
+                      << std::setw(12) << std::fixed << std::setprecision(1) << objects.center[i].x * reportScale
+                      << std::setw(12) << std::fixed << std::setprecision(1) << objects.center[i].y * reportScale
+                      << std::setw(12) << std::fixed << std::setprecision(3) << objects.circularity[i]
+                      << std::setw(12) << std::fixed << std::setprecision(2) << objects.aspectRatio[i];
             
             if (enableCoinClassification) {
-                std::cout << std::setw(12) << coinTypeToString(obj.coinType)
-                          << std::setw(12) << std::fixed << std::setprecision(2) << obj.estimated_diameter_mm
-                          << std::setw(10) << std::fixed << std::setprecision(1) << (obj.confidence * 100) << "%";
+                std::cout << std::setw(12) << coinTypeToString(objects.coinType[i])
+                          << std::setw(12) << std::fixed << std::setprecision(2) << objects.diameterMM[i]
+                          << std::setw(10) << std::fixed << std::setprecision(1) << (objects.confidence[i] * 100) << "%";
             }
-            std::cout << std::endl;
+            std::cout << '\n';
         }
         
         // Calculate statistics
         double totalArea = 0.0;
         double avgCircularity = 0.0;
-        for (const auto& obj : detectedObjects) {
-            totalArea += obj.area;
-            avgCircularity += obj.circularity;
+        for (size_t i = 0; i < objects.size(); i++) {
+            totalArea += objects.area[i] * areaScale;
+            avgCircularity += objects.circularity[i];
         }
         
-        std::cout << "\nStatistics:" << std::endl;
-        std::cout << "  Total area: " << std::fixed << std::setprecision(1) << totalArea << std::endl;
+        std::cout << "\nStatistics:" << '\n';
+        std::cout << "  Total area: " << std::fixed << std::setprecision(1) << totalArea << '\n';
         std::cout << "  Average area: " << std::fixed << std::setprecision(1) 
-                  << totalArea / detectedObjects.size() << std::endl;
+                  << totalArea / detectedObjects.size() << '\n';
         std::cout << "  Average circularity: " << std::fixed << std::setprecision(3) 
-                  << avgCircularity / detectedObjects.size() << std::endl;
+                  << avgCircularity / detectedObjects.size() << '\n';
         
         if (enableCoinClassification && pixelsPerMM > 0) {
             std::cout << "  Calibration: " << std::fixed << std::setprecision(2) 
-                      << pixelsPerMM << " pixels per mm" << std::endl;
+                      << pixelsPerMM * reportScale << " pixels per mm" << '\n';
         }
     }
     
-    std::cout << "=================================" << std::endl;
+    std::cout << "=================================" << '\n';
 }
 
 // Display results
@@ -755,10 +1210,10 @@ void ObjectCounter::displayResults(const std::string& windowName) {
     
     cv::Mat annotatedImage = getAnnotatedImage();
     
-    if (binaryMask.empty()) {
+    if (!hasMask()) {
         cv::imshow(windowName, annotatedImage);
     } else {
-        cv::Mat combined = combineImages(inputImage, binaryMask, annotatedImage);
+        cv::Mat combined = combineImages(inputImage, materializedMask(), annotatedImage);
         cv::imshow(windowName, combined);
     }
     
@@ -769,7 +1224,13 @@ void ObjectCounter::displayResults(const std::string& windowName) {
 
 // Get annotated image
 cv::Mat ObjectCounter::getAnnotatedImage() {
-    cv::Mat annotatedImage = inputImage.clone();
+    ScopedTimer timer("annotate");
+    cv::Mat annotatedImage;
+    if (reportScale > 1) {
+        cv::resize(inputImage, annotatedImage, cv::Size(), reportScale, reportScale, cv::INTER_LINEAR);
+    } else {
+        annotatedImage = inputImage.clone();
+    }
     drawObjectAnnotations(annotatedImage);
     return annotatedImage;
 }
@@ -780,7 +1241,7 @@ void ObjectCounter::saveAnnotatedImage(const std::string& outputPath) {
     
     bool success = cv::imwrite(outputPath, annotatedImage);
     if (success) {
-        std::cout << "Annotated image saved: " << outputPath << std::endl;
+        LOG_INFO << "Annotated image saved: " << outputPath;
     } else {
         std::cerr << "Error: Could not save annotated image to " << outputPath << std::endl;
     }
@@ -788,14 +1249,14 @@ void ObjectCounter::saveAnnotatedImage(const std::string& outputPath) {
 
 // Save binary mask
 void ObjectCounter::saveBinaryMask(const std::string& outputPath) {
-    if (binaryMask.empty()) {
+    if (!hasMask()) {
         std::cerr << "Error: No binary mask to save" << std::endl;
         return;
     }
     
-    bool success = cv::imwrite(outputPath, binaryMask);
+    bool success = cv::imwrite(outputPath, getReportMask());
     if (success) {
-        std::cout << "Binary mask saved: " << outputPath << std::endl;
+        LOG_INFO << "Binary mask saved: " << outputPath;
     } else {
         std::cerr << "Error: Could not save binary mask to " << outputPath << std::endl;
     }
@@ -803,11 +1264,20 @@ void ObjectCounter::saveBinaryMask(const std::string& outputPath) {
 
 // Save all results
 void ObjectCounter::saveResults(const std::string& basePath) {
+    std::string annotatedPath, maskPath;
+    resultPaths(basePath, annotatedPath, maskPath);
+    
+    saveAnnotatedImage(annotatedPath);
+    saveBinaryMask(maskPath);
+}
+
+// File names saveResults writes for a base path
+void ObjectCounter::resultPaths(const std::string& basePath, std::string& annotatedPath, std::string& maskPath) {
     size_t lastDot = basePath.find_last_of(".");
     std::string basePathNoExt = (lastDot != std::string::npos) ? basePath.substr(0, lastDot) : basePath;
     
-    saveAnnotatedImage(basePathNoExt + "_annotated.png");
-    saveBinaryMask(basePathNoExt + "_mask.png");
+    annotatedPath = basePathNoExt + "_annotated.png";
+    maskPath = basePathNoExt + "_mask.png";
 }
 
 // Getter methods
@@ -816,13 +1286,52 @@ cv::Mat ObjectCounter::getInputImage() const {
 }
 
 cv::Mat ObjectCounter::getBinaryMask() const {
-    return binaryMask.clone();
+    return runMask.empty() ? binaryMask.clone() : materializedMask();
+}
+
+// Non-copying getters; the returned buffers may be shared with other owners
+const cv::Mat& ObjectCounter::getInputImageRef() const {
+    return inputImage;
+}
+
+const cv::Mat& ObjectCounter::getBinaryMaskRef() const {
+    return binaryMask;
+}
+
+const RunLengthMask& ObjectCounter::getRunMaskRef() const {
+    return runMask;
 }
 
 int ObjectCounter::getObjectCount() const {
     return static_cast<int>(detectedObjects.size());
 }
 
+// Set the reduction the image was decoded at, so reported geometry is full size
+void ObjectCounter::setReportScale(int scale) {
+    reportScale = std::max(1, scale);
+}
+
+int ObjectCounter::getReportScale() const {
+    return reportScale;
+}
+
+// The mask at the reported size
+cv::Mat ObjectCounter::getReportMask() const {
+    cv::Mat mask = materializedMask();
+    if (reportScale > 1 && !mask.empty()) {
+        cv::Mat scaled;
+        cv::resize(mask, scaled, cv::Size(), reportScale, reportScale, cv::INTER_NEAREST);
+        return scaled;
+    }
+    return mask;
+}
+
+// A rectangle of the decoded image in reported coordinates
+cv::Rect ObjectCounter::scaleRect(const cv::Rect& rect) const {
+    return cv::Rect(rect.x * reportScale, rect.y * reportScale,
+                    rect.width * reportScale, rect.height * reportScale);
+}
+
 // Static method to combine three images
 cv::Mat ObjectCounter::combineImages(const cv::Mat& img1, const cv::Mat& img2, const cv::Mat& img3) {
     cv::Mat combined;
@@ -881,18 +1390,15 @@ std::string ObjectCounter::generateSummaryText(int objectCount, const std::strin
 }
 
 // Static method to generate coin summary text
-std::string ObjectCounter::generateCoinSummaryText(const std::map<CoinType, int>& coinCounts, double totalValue) {
-    std::string summary = "Found ";
+std::string ObjectCounter::generateCoinSummaryText(int coinCount, const std::map<std::string, double>& totals) {
+    std::string summary = "Found " + std::to_string(coinCount) + " coins";
     
-    int totalCoins = 0;
-    for (const auto& pair : coinCounts) {
-        totalCoins += pair.second;
+    bool anyValue = false;
+    for (const auto& total : totals) {
+        anyValue = anyValue || total.second > 0;
     }
-    
-    summary += std::to_string(totalCoins) + " coins";
-    
-    if (totalValue > 0) {
-        summary += " worth $" + std::to_string(totalValue).substr(0, std::to_string(totalValue).find('.') + 3);
+    if (anyValue) {
+        summary += " worth " + CoinRegistry::formatTotals(totals);
     }
     
     return summary;
@@ -900,8 +1406,8 @@ std::string ObjectCounter::generateCoinSummaryText(const std::map<CoinType, int>
 
 // Static method to show image information
 void ObjectCounter::showImageInfo(const cv::Mat& image, const std::string& imageName) {
-    std::cout << imageName << " Info:" << std::endl;
-    std::cout << "  Size: " << image.cols << "x" << image.rows << std::endl;
-    std::cout << "  Channels: " << image.channels() << std::endl;
-    std::cout << "  Type: " << image.type() << std::endl << std::endl;
+    LOG_DEBUG << imageName << " Info:\n"
+              << "  Size: " << image.cols << "x" << image.rows << "\n"
+              << "  Channels: " << image.channels() << "\n"
+              << "  Type: " << image.type() << "\n";
 }
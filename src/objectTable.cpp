@@ -0,0 +1,162 @@
+#include "objectTable.hh"
+#include <algorithm>
+
+// Constructor
+ObjectTable::ObjectTable()
+    : computedFeatures(0)
+{
+    contourOffset.push_back(0);
+}
+
+size_t ObjectTable::size() const {
+    return area.size();
+}
+
+bool ObjectTable::empty() const {
+    return area.empty();
+}
+
+// Remove all objects (capacity is kept)
+void ObjectTable::clear() {
+    label.clear();
+    area.clear();
+    center.clear();
+    boundingBox.clear();
+    circularity.clear();
+    aspectRatio.clear();
+    diameterPixels.clear();
+    diameterMM.clear();
+    confidence.clear();
+    coinType.clear();
+    contourOffset.assign(1, 0);
+    contourPoints.clear();
+    computedFeatures = 0;
+}
+
+// Reserve space for a number of objects and contour points
+void ObjectTable::reserve(size_t objects, size_t points) {
+    label.reserve(objects);
+    area.reserve(objects);
+    center.reserve(objects);
+    boundingBox.reserve(objects);
+    circularity.reserve(objects);
+    aspectRatio.reserve(objects);
+    diameterPixels.reserve(objects);
+    diameterMM.reserve(objects);
+    confidence.reserve(objects);
+    coinType.reserve(objects);
+    contourOffset.reserve(objects + 1);
+    contourPoints.reserve(points);
+}
+
+// Append an object
+size_t ObjectTable::add(int objectLabel, double objectArea, const cv::Point2f& objectCenter,
+                        const cv::Rect& objectBox) {
+    label.push_back(objectLabel);
+    area.push_back(objectArea);
+    center.push_back(objectCenter);
+    boundingBox.push_back(objectBox);
+    circularity.push_back(0.0);
+    aspectRatio.push_back(0.0);
+    diameterPixels.push_back(0.0);
+    diameterMM.push_back(0.0);
+    confidence.push_back(0.0);
+    coinType.push_back(UNKNOWN_COIN);
+    
+    contourOffset.push_back(static_cast<int>(contourPoints.size()));
+    
+    return area.size() - 1;
+}
+
+// Rebuild the shared point buffer from per-object contours
+void ObjectTable::setContours(const std::vector<std::vector<cv::Point>>& contours) {
+    size_t points = 0;
+    for (size_t i = 0; i < size(); i++) {
+        points += contours[i].size();
+    }
+    
+    contourPoints.clear();
+    contourPoints.reserve(points);
+    contourOffset.assign(1, 0);
+    for (size_t i = 0; i < size(); i++) {
+        contourPoints.insert(contourPoints.end(), contours[i].begin(), contours[i].end());
+        contourOffset.push_back(static_cast<int>(contourPoints.size()));
+    }
+}
+
+// Contour accessors
+const cv::Point* ObjectTable::contourData(size_t i) const {
+    return contourPoints.data() + contourOffset[i];
+}
+
+int ObjectTable::contourSize(size_t i) const {
+    return contourOffset[i + 1] - contourOffset[i];
+}
+
+cv::Mat ObjectTable::contourMat(size_t i) const {
+    return cv::Mat(contourSize(i), 1, CV_32SC2, const_cast<cv::Point*>(contourData(i)));
+}
+
+// Compact the table in place
+void ObjectTable::compact(const std::vector<unsigned char>& keep) {
+    size_t write = 0;
+    int pointWrite = 0;
+    int begin = contourOffset[0];
+    
+    for (size_t read = 0; read < size(); read++) {
+        int end = contourOffset[read + 1];
+        
+        if (keep[read]) {
+            label[write] = label[read];
+            area[write] = area[read];
+            center[write] = center[read];
+            boundingBox[write] = boundingBox[read];
+            circularity[write] = circularity[read];
+            aspectRatio[write] = aspectRatio[read];
+            diameterPixels[write] = diameterPixels[read];
+            diameterMM[write] = diameterMM[read];
+            confidence[write] = confidence[read];
+            coinType[write] = coinType[read];
+            
+            // Destination never runs ahead of the source, so a forward copy is safe
+            std::copy(contourPoints.begin() + begin, contourPoints.begin() + end,
+                      contourPoints.begin() + pointWrite);
+            contourOffset[write] = pointWrite;
+            pointWrite += end - begin;
+            write++;
+        }
+        
+        begin = end;
+    }
+    
+    label.resize(write);
+    area.resize(write);
+    center.resize(write);
+    boundingBox.resize(write);
+    circularity.resize(write);
+    aspectRatio.resize(write);
+    diameterPixels.resize(write);
+    diameterMM.resize(write);
+    confidence.resize(write);
+    coinType.resize(write);
+    contourOffset.resize(write + 1);
+    contourOffset[write] = pointWrite;
+    contourPoints.resize(pointWrite);
+}
+
+// Build the array-of-structs view of one object
+ObjectInfo ObjectTable::toObjectInfo(size_t i) const {
+    ObjectInfo obj;
+    obj.id = static_cast<int>(i);
+    obj.area = area[i];
+    obj.center = center[i];
+    obj.boundingBox = boundingBox[i];
+    obj.contour.assign(contourData(i), contourData(i) + contourSize(i));
+    obj.circularity = circularity[i];
+    obj.aspectRatio = aspectRatio[i];
+    obj.coinType = coinType[i];
+    obj.diameter_pixels = diameterPixels[i];
+    obj.estimated_diameter_mm = diameterMM[i];
+    obj.confidence = confidence[i];
+    return obj;
+}
@@ -0,0 +1,70 @@
+#include "processingContext.hh"
+
+// Buffers per ring: one for the image in flight, one still held by the
+// consumer, and one spare
+static const size_t kRingSize = 3;
+
+// Constructor
+ProcessingContext::ProcessingContext()
+    : kernelSize(0)
+{
+}
+
+// Get the shared CLAHE object
+cv::Ptr<cv::CLAHE>& ProcessingContext::clahe(const cv::Size& tileGrid) {
+    if (claheInstance.empty()) {
+        claheInstance = cv::createCLAHE(2.0, tileGrid);
+    } else if (claheInstance->getTilesGridSize() != tileGrid) {
+        claheInstance->setTilesGridSize(tileGrid);
+    }
+    return claheInstance;
+}
+
+// Get the elliptical structuring element for a kernel size
+const cv::Mat& ProcessingContext::structuringElement(int size) {
+    if (kernel.empty() || size != kernelSize) {
+        kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(size, size));
+        kernelSize = size;
+    }
+    return kernel;
+}
+
+// Get a CV_8UC1 buffer for the binary mask
+cv::Mat ProcessingContext::acquireMask(const cv::Size& size) {
+    return acquire(maskRing, size, CV_8UC1);
+}
+
+// Get a CV_32S buffer for component labels
+cv::Mat ProcessingContext::acquireLabels(const cv::Size& size) {
+    return acquire(labelRing, size, CV_32S);
+}
+
+// Check that only the ring still refers to a buffer. Other threads (the
+// writers of a pipelined batch) release their references concurrently, so
+// the count is read with the same atomic OpenCV uses to change it.
+bool ProcessingContext::isIdle(const cv::Mat& buffer) {
+    return buffer.u == nullptr || CV_XADD(&buffer.u->refcount, 0) == 1;
+}
+
+// Reuse an idle buffer of the right size and type, else allocate one
+cv::Mat ProcessingContext::acquire(std::vector<cv::Mat>& ring, const cv::Size& size, int type) {
+    for (const cv::Mat& buffer : ring) {
+        if (!buffer.empty() && isIdle(buffer) && buffer.size() == size && buffer.type() == type) {
+            return buffer;
+        }
+    }
+    
+    // Resolution changed or every buffer is in use: replace an idle entry
+    // (freeing the old size) or grow the ring
+    cv::Mat fresh(size, type);
+    for (cv::Mat& buffer : ring) {
+        if (isIdle(buffer)) {
+            buffer = fresh;
+            return fresh;
+        }
+    }
+    if (ring.size() < kRingSize) {
+        ring.push_back(fresh);
+    }
+    return fresh;
+}
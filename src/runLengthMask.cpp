@@ -0,0 +1,165 @@
+#include "runLengthMask.hh"
+#include <algorithm>
+
+static const int kWordBits = 64;
+
+// Index of the lowest set bit of a non-zero word
+static inline int lowestSetBit(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int index = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+// Constructor
+RunLengthMask::RunLengthMask()
+    : rowCount(0), colCount(0)
+{
+    rowOffsets.push_back(0);
+}
+
+// Start an empty mask, keeping the allocations
+void RunLengthMask::create(int rows, int cols) {
+    rowCount = rows;
+    colCount = cols;
+    runs.clear();
+    rowOffsets.clear();
+    rowOffsets.reserve(rows + 1);
+    rowOffsets.push_back(0);
+}
+
+void RunLengthMask::clear() {
+    create(0, 0);
+}
+
+int RunLengthMask::rows() const {
+    return rowCount;
+}
+
+int RunLengthMask::cols() const {
+    return colCount;
+}
+
+bool RunLengthMask::empty() const {
+    return rowCount == 0 || colCount == 0;
+}
+
+size_t RunLengthMask::runCount() const {
+    return runs.size();
+}
+
+int RunLengthMask::rowBegin(int y) const {
+    return rowOffsets[y];
+}
+
+int RunLengthMask::rowEnd(int y) const {
+    return rowOffsets[y + 1];
+}
+
+const MaskRun& RunLengthMask::run(int i) const {
+    return runs[i];
+}
+
+const MaskRun* RunLengthMask::runData() const {
+    return runs.data();
+}
+
+// Count the set pixels
+long long RunLengthMask::area() const {
+    long long total = 0;
+    for (const auto& r : runs) {
+        total += r.end - r.start;
+    }
+    return total;
+}
+
+void RunLengthMask::appendRun(int start, int end) {
+    runs.push_back({start, end});
+}
+
+void RunLengthMask::extendLastRun(int end) {
+    runs.back().end = end;
+}
+
+void RunLengthMask::endRow() {
+    rowOffsets.push_back(static_cast<int>(runs.size()));
+}
+
+// Encode a CV_8UC1 mask
+void RunLengthMask::encode(const cv::Mat& mask) {
+    CV_Assert(mask.type() == CV_8UC1);
+    create(mask.rows, mask.cols);
+    
+    for (int y = 0; y < rowCount; y++) {
+        const uchar* row = mask.ptr<uchar>(y);
+        int x = 0;
+        while (x < colCount) {
+            while (x < colCount && !row[x]) {
+                x++;
+            }
+            if (x == colCount) {
+                break;
+            }
+            int start = x;
+            while (x < colCount && row[x]) {
+                x++;
+            }
+            appendRun(start, x);
+        }
+        endRow();
+    }
+}
+
+// Encode a BitMask a word at a time: each run boundary costs one bit scan
+void RunLengthMask::encode(const BitMask& mask) {
+    create(mask.rows(), mask.cols());
+    const int words = mask.wordsPerRow();
+    
+    for (int y = 0; y < rowCount; y++) {
+        const uint64_t* row = mask.row(y);
+        bool inRun = false;
+        int start = 0;
+        
+        for (int j = 0; j < words; j++) {
+            // Bits still to scan, inverted inside a run so the next boundary is always a set bit
+            uint64_t word = inRun ? ~row[j] : row[j];
+            while (word != 0) {
+                int bit = lowestSetBit(word);
+                if (inRun) {
+                    appendRun(start, j * kWordBits + bit);
+                } else {
+                    start = j * kWordBits + bit;
+                }
+                inRun = !inRun;
+                
+                // Invert what's left above the boundary and drop everything below it
+                word = ~word & (~0ULL << bit);
+            }
+        }
+        
+        // Padding bits are zero, so a run still open here ends at the last column
+        if (inRun) {
+            appendRun(start, colCount);
+        }
+        endRow();
+    }
+}
+
+// Paint into a 0/255 CV_8UC1 plane
+void RunLengthMask::paint(cv::Mat& mask) const {
+    mask.create(rowCount, colCount, CV_8UC1);
+    
+    for (int y = 0; y < rowCount; y++) {
+        uchar* row = mask.ptr<uchar>(y);
+        std::fill(row, row + colCount, 0);
+        for (int i = rowOffsets[y]; i < rowOffsets[y + 1]; i++) {
+            std::fill(row + runs[i].start, row + runs[i].end, 255);
+        }
+    }
+}
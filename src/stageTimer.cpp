@@ -0,0 +1,160 @@
+#include "stageTimer.hh"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+// Get the process-wide collector
+StageTrace& StageTrace::instance() {
+    static StageTrace trace;
+    return trace;
+}
+
+// Constructor
+StageTrace::StageTrace()
+    : origin(std::chrono::steady_clock::now()), tracingEnabled(false)
+{
+}
+
+// Enable/disable keeping individual events
+void StageTrace::setTracingEnabled(bool enable) {
+    tracingEnabled.store(enable, std::memory_order_relaxed);
+}
+
+bool StageTrace::isTracingEnabled() const {
+    return tracingEnabled.load(std::memory_order_relaxed);
+}
+
+// The calling thread's buffer, registered on first use. Buffers are owned by
+// the collector so they outlive the threads that filled them.
+StageTrace::ThreadBuffer& StageTrace::threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.emplace_back(new ThreadBuffer());
+        buffer = buffers.back().get();
+        buffer->lane = static_cast<int>(buffers.size());
+        buffer->threadName = "thread " + std::to_string(buffer->lane);
+    }
+    return *buffer;
+}
+
+// Label the calling thread's lane
+void StageTrace::setThreadName(const std::string& name) {
+    threadBuffer().threadName = name;
+}
+
+// Add one timed stage to the calling thread's buffer
+void StageTrace::record(const char* name, std::chrono::steady_clock::time_point start,
+                        std::chrono::steady_clock::time_point end) {
+    ThreadBuffer& buffer = threadBuffer();
+    int64_t durationUs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    
+    // A pipeline has a handful of stages, so a linear scan on the literal's
+    // address beats hashing the name
+    StageTotal* total = nullptr;
+    for (auto& entry : buffer.totals) {
+        if (entry.name == name) {
+            total = &entry;
+            break;
+        }
+    }
+    if (!total) {
+        buffer.totals.emplace_back();
+        total = &buffer.totals.back();
+        total->name = name;
+    }
+    total->count++;
+    total->totalUs += durationUs;
+    total->maxUs = std::max(total->maxUs, durationUs);
+    
+    if (isTracingEnabled()) {
+        int64_t startUs = std::chrono::duration_cast<std::chrono::microseconds>(start - origin).count();
+        buffer.events.push_back({name, startUs, durationUs});
+    }
+}
+
+// Write all events as Chrome trace-event JSON, one lane (tid) per thread
+bool StageTrace::writeChromeTrace(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not write trace file: " << path << std::endl;
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& buffer : buffers) {
+        file << (first ? "" : ",\n")
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->lane
+             << ",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+        first = false;
+        
+        for (const Event& event : buffer->events) {
+            file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                 << buffer->lane << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs << "}";
+        }
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    
+    if (!file) {
+        std::cerr << "Error: Could not write trace file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Print count, total, mean and max per stage, merged over all threads
+void StageTrace::printSummary() const {
+    std::map<std::string, StageTotal> merged;
+    std::vector<std::string> order;  // First-seen order, which follows the pipeline
+    
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (const auto& buffer : buffers) {
+            for (const auto& total : buffer->totals) {
+                auto it = merged.find(total.name);
+                if (it == merged.end()) {
+                    order.push_back(total.name);
+                    it = merged.insert(std::make_pair(std::string(total.name), StageTotal())).first;
+                    it->second.name = total.name;
+                }
+                it->second.count += total.count;
+                it->second.totalUs += total.totalUs;
+                it->second.maxUs = std::max(it->second.maxUs, total.maxUs);
+            }
+        }
+    }
+    
+    if (order.empty()) {
+        return;
+    }
+    
+    std::cout << "\n=== Stage Timings ===" << '\n';
+    std::cout << std::left << std::setw(24) << "Stage" << std::right
+              << std::setw(8) << "Count" << std::setw(12) << "Total ms"
+              << std::setw(12) << "Mean ms" << std::setw(12) << "Max ms" << '\n';
+    std::cout << std::string(68, '-') << '\n';
+    
+    for (const auto& name : order) {
+        const StageTotal& total = merged[name];
+        std::cout << std::left << std::setw(24) << name << std::right << std::fixed
+                  << std::setw(8) << total.count
+                  << std::setw(12) << std::setprecision(2) << total.totalUs / 1000.0
+                  << std::setw(12) << std::setprecision(3) << total.totalUs / 1000.0 / total.count
+                  << std::setw(12) << std::setprecision(3) << total.maxUs / 1000.0 << '\n';
+    }
+}
+
+// Drop all recorded timings; thread lanes and names are kept
+void StageTrace::clear() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (auto& buffer : buffers) {
+        buffer->events.clear();
+        buffer->totals.clear();
+    }
+}